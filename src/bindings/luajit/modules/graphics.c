@@ -501,7 +501,13 @@ static int l_graphics_LockBuffer( lua_State *L ){
   }else{
    __buffer = 0;
   }
-  bbLockBuffer( __buffer );
+  bb_int_t __write_only;
+  if( lua_gettop( L ) > 1 ){
+    __write_only = luaL_checknumber( L,2 );
+  }else{
+   __write_only = 0;
+  }
+  bbLockBuffer( __buffer,__write_only );
   return 0;
 }
 
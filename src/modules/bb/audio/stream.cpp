@@ -1,6 +1,7 @@
 
 #include "../stdutil/stdutil.h"
 #include "stream.h"
+#include <bb/profile/profile.h>
 
 #include <cstdlib>
 #include <cstring>
@@ -36,6 +37,7 @@ AudioStream::Ref::~Ref(){
 }
 
 size_t AudioStream::Ref::decode( unsigned char **buf ){
+	BB_PROFILE( "AudioStream::decode" );
 #ifndef BB_MINGW
 	std::lock_guard<std::mutex> guard( stream->lock );
 #else
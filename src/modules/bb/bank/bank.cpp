@@ -51,7 +51,7 @@ void debugBank( bbBank *b,int offset ){
 	}
 }
 
-static void debugBankRange( bbBank *b,bb_int_t offset,bb_int_t count ){
+void debugBankRange( bbBank *b,bb_int_t offset,bb_int_t count ){
 	if( bb_env.debug ){
 		debugBank( b );
 		if( offset<0 || count<0 || offset+count>b->size ) RTEX( "Offset out of range" );
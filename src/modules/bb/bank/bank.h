@@ -13,6 +13,9 @@ struct bbBank{
 	void resize( int n );
 };
 
+//debug build checks that b exists and holds count bytes at offset
+void debugBankRange( bbBank *b,bb_int_t offset,bb_int_t count );
+
 #include "commands.h"
 
 #endif
@@ -8,7 +8,9 @@
 #include <math.h>
 #include <cstdlib>
 #include <cstring>
-#include <map>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
 
 //how many strings allocated
 static int stringCnt;
@@ -34,12 +36,30 @@ static BBData *dataPtr;
 //strings
 static BBStr usedStrs,freeStrs;
 
-//object handle number
-static int next_handle;
-
-//object<->handle maps
-static std::map<bb_int_t,BBObj*> handle_map;
-static std::map<BBObj*,bb_int_t> object_map;
+//string literals, by address
+static std::unordered_map<const char*,BBStr*> constStrs;
+
+//object handles
+//
+//A handle is a slot in handle_slots plus the slot's generation when it was handed
+//out. Deleting the object bumps the generation, so stale handles fail to match.
+//A slot whose generation runs out is retired rather than wrapped, so a stale
+//handle can never match again. Each object remembers its own handle in its
+//header, see objHandle().
+struct BBHandleSlot{
+	BBObj *obj;
+	bb_int_t gen;
+	int next_free;
+};
+
+//handles stay positive 32 bit ints, so they survive PokeInt and friends
+static const int HANDLE_SLOT_BITS=24;
+static const bb_int_t HANDLE_SLOT_MASK=((bb_int_t)1<<HANDLE_SLOT_BITS)-1;
+static const bb_int_t HANDLE_GEN_MASK=((bb_int_t)1<<(31-HANDLE_SLOT_BITS))-1;
+
+static std::vector<BBHandleSlot> handle_slots;
+//freed slots are reused oldest first, so a stale handle takes longest to come around again
+static int free_slots_head,free_slots_tail;
 
 BBType _bbIntType( BBTYPE_INT );
 BBType _bbFltType( BBTYPE_FLT );
@@ -93,23 +113,23 @@ void BBStr::operator delete( void *q ){
 	removeStr( t );insertStr( t,&freeStrs );
 }
 
-BBStr::BBStr(){
+BBStr::BBStr():ref_cnt(1){
 	++stringCnt;
 }
 
-BBStr::BBStr( const char *s ):std::string(s){
+BBStr::BBStr( const char *s ):std::string(s),ref_cnt(1){
 	++stringCnt;
 }
 
-BBStr::BBStr( const char *s,int n ):std::string(s,n){
+BBStr::BBStr( const char *s,int n ):std::string(s,n),ref_cnt(1){
 	++stringCnt;
 }
 
-BBStr::BBStr( const BBStr &s ):std::string(s){
+BBStr::BBStr( const BBStr &s ):std::string(s),ref_cnt(1){
 	++stringCnt;
 }
 
-BBStr::BBStr( const std::string &s ):std::string(s){
+BBStr::BBStr( const std::string &s ):std::string(s),ref_cnt(1){
 	++stringCnt;
 }
 
@@ -129,29 +149,39 @@ BBStr::~BBStr(){
 	--stringCnt;
 }
 
-BBStr * BBCALL _bbStrLoad( BBStr **var ){
-	return *var ? d_new BBStr( **var ) : d_new BBStr();
+//last reference gone; see _bbStrRelease
+void BBCALL _bbStrFree( BBStr *str ){
+	delete str;
 }
 
-BBStr * BBCALL _bbStrCopy( BBStr *var ){
-	return var ? d_new BBStr( *var ) : d_new BBStr();
+BBStr * BBCALL _bbStrUnique( BBStr *str ){
+	if( str->ref_cnt==1 ) return str;
+	--str->ref_cnt;
+	return d_new BBStr( *str );
 }
 
-void BBCALL _bbStrRelease( BBStr *str ){
-	delete str;
-}
-
-void BBCALL _bbStrStore( BBStr **var,BBStr *str ){
-	_bbStrRelease( *var );*var=str;
+//var$=var$+str: grows var's own buffer when nothing else shares it
+void BBCALL _bbStrAppend( BBStr **var,BBStr *str ){
+	BBStr *s=*var;
+	if( !s ){
+		*var=str;
+		return;
+	}
+	if( s->ref_cnt>1 ){
+		--s->ref_cnt;
+		*var=s=d_new BBStr( *s );
+	}
+	*s+=*str;_bbStrRelease( str );
 }
 
 BBStr * BBCALL _bbStrConcat( BBStr *s1,BBStr *s2 ){
-	*s1+=*s2;delete s2;return s1;
+	s1=_bbStrUnique( s1 );
+	*s1+=*s2;_bbStrRelease( s2 );return s1;
 }
 
 bb_int_t BBCALL _bbStrCompare( BBStr *lhs,BBStr *rhs ){
 	int n=lhs->compare( *rhs );
-	delete lhs;delete rhs;return n;
+	_bbStrRelease( lhs );_bbStrRelease( rhs );return n;
 }
 
 bb_int_t BBCALL _bbStrToInt( BBStr *s ){
@@ -160,7 +190,7 @@ bb_int_t BBCALL _bbStrToInt( BBStr *s ){
 #else
 	long n=atol( *s );
 #endif
-	delete s;return n;
+	_bbStrRelease( s );return n;
 }
 
 BBStr * BBCALL _bbStrFromInt( bb_int_t n ){
@@ -177,7 +207,7 @@ bb_float_t BBCALL _bbStrToFloat( BBStr *s ){
 #else
 	double n=atof( *s );
 #endif
-	delete s;return n;
+	_bbStrRelease( s );return n;
 }
 
 BBStr * BBCALL _bbStrFromFloat( bb_float_t n ){
@@ -185,7 +215,9 @@ BBStr * BBCALL _bbStrFromFloat( bb_float_t n ){
 }
 
 BBStr * BBCALL _bbStrConst( const char *s ){
-	return d_new BBStr( s );
+	BBStr *&t=constStrs[s];
+	if( !t ) t=d_new BBStr( s );
+	++t->ref_cnt;return t;
 }
 
 void * BBCALL _bbVecAlloc( BBVecType *type ){
@@ -248,6 +280,83 @@ void BBCALL _bbArrayBoundsEx(){
 	RTEX( "Array index out of bounds" );
 }
 
+//object pools
+//
+//A type's objects are carved OBJ_NEW_INC at a time into chunks, and New takes
+//the lowest free slot of the lowest chunk with one, so however much a type
+//churns its live objects stay packed at the front of its memory. They never
+//move - programs hold pointers to them - so For Each order is the type's used
+//list, threaded through the objects themselves, and Insert is just a relink.
+struct ObjChunk{
+	char *mem;
+	uint64_t free_bits[OBJ_NEW_INC/64];
+	int free_cnt;
+};
+
+struct ObjPool{
+	int obj_size;
+	std::vector<ObjChunk> chunks;
+	//no chunk before this one has a free slot
+	int first_free;
+};
+
+static BBObjHeader *objHeader( BBObj *obj ){
+	return (BBObjHeader*)obj-1;
+}
+
+static bb_int_t &objHandle( BBObj *obj ){
+	return objHeader( obj )->handle;
+}
+
+static ObjPool *objPool( BBObjType *type ){
+	ObjPool *pool=(ObjPool*)type->free.fields;
+	if( pool ) return pool;
+
+	pool=d_new ObjPool;
+	pool->obj_size=sizeof(BBObjHeader)+sizeof(BBObj)+type->fieldCnt*sizeof(BBField);
+	pool->first_free=0;
+	type->free.fields=(BBField*)pool;
+	return pool;
+}
+
+static int lowestBit( uint64_t bits ){
+	int n=0;
+	while( !(bits&0xff) ){ bits>>=8;n+=8; }
+	while( !(bits&1) ){ bits>>=1;++n; }
+	return n;
+}
+
+static BBObj *allocObj( ObjPool *pool ){
+	int n=pool->chunks.size();
+	while( pool->first_free<n && !pool->chunks[pool->first_free].free_cnt ) ++pool->first_free;
+	if( pool->first_free==n ){
+		ObjChunk c;
+		c.mem=(char*)bbMalloc( pool->obj_size*OBJ_NEW_INC );
+		for( int k=0;k<OBJ_NEW_INC/64;++k ) c.free_bits[k]=~(uint64_t)0;
+		c.free_cnt=OBJ_NEW_INC;
+		pool->chunks.push_back( c );
+	}
+	ObjChunk &c=pool->chunks[pool->first_free];
+	int w=0;
+	while( !c.free_bits[w] ) ++w;
+	int k=w*64+lowestBit( c.free_bits[w] );
+	c.free_bits[w]&=~((uint64_t)1<<(k&63));
+	--c.free_cnt;
+
+	BBObjHeader *h=(BBObjHeader*)( c.mem+k*pool->obj_size );
+	h->slot=pool->first_free*OBJ_NEW_INC+k;
+	return (BBObj*)(h+1);
+}
+
+static void freeObj( ObjPool *pool,BBObj *obj ){
+	int slot=objHeader( obj )->slot;
+	int n=slot/OBJ_NEW_INC,k=slot%OBJ_NEW_INC;
+	ObjChunk &c=pool->chunks[n];
+	c.free_bits[k/64]|=(uint64_t)1<<(k&63);
+	++c.free_cnt;
+	if( n<pool->first_free ) pool->first_free=n;
+}
+
 static void unlinkObj( BBObj *obj ){
 	obj->next->prev=obj->prev;
 	obj->prev->next=obj->next;
@@ -260,20 +369,28 @@ static void insertObj( BBObj *obj,BBObj *next ){
 	next->prev=obj;
 }
 
+static void freeHandle( BBObj *obj ){
+	bb_int_t &handle=objHandle( obj );
+	if( !handle ) return;
+	int slot=(handle&HANDLE_SLOT_MASK)-1;
+	BBHandleSlot &t=handle_slots[slot];
+	t.obj=0;
+	handle=0;
+	if( t.gen==HANDLE_GEN_MASK ) return;
+	++t.gen;
+	t.next_free=-1;
+	if( free_slots_tail>=0 ) handle_slots[free_slots_tail].next_free=slot;
+	else free_slots_head=slot;
+	free_slots_tail=slot;
+}
+
 BBObj * BBCALL _bbObjNew( BBObjType *type ){
-	if( type->free.next==&type->free ){
-		int obj_size=sizeof(BBObj)+type->fieldCnt*sizeof(BBField);
-		BBObj *o=(BBObj*)bbMalloc( obj_size*OBJ_NEW_INC );
-		for( int k=0;k<OBJ_NEW_INC;++k ){
-			insertObj( o,&type->free );
-			o=(BBObj*)( (char*)o+obj_size );
-		}
-	}
-	BBObj *o=type->free.next;
-	unlinkObj( o );
+	ObjPool *pool=objPool( type );
+	BBObj *o=allocObj( pool );
 	o->type=type;
 	o->ref_cnt=1;
 	o->fields=(BBField*)(o+1);
+	objHandle( o )=0;
 	for( int k=0;k<type->fieldCnt;++k ){
 		switch( type->fieldTypes[k]->type ){
 		case BBTYPE_VEC:
@@ -307,21 +424,21 @@ void BBCALL _bbObjDelete( BBObj *obj ){
 			break;
 		}
 	}
-	std::map<BBObj*,bb_int_t>::iterator it=object_map.find( obj );
-	if( it!=object_map.end() ){
-		handle_map.erase( it->second );
-		object_map.erase( it );
-	}
+	freeHandle( obj );
 	obj->fields=0;
 	_bbObjRelease( obj );
 	--objCnt;
 }
 
 void BBCALL _bbObjDeleteEach( BBObjType *type ){
+	//hold on to each object while it's deleted, so whatever its fields release
+	//can't unlink it from under us
 	BBObj *obj=type->used.next;
 	while( obj->type ){
+		++obj->ref_cnt;
+		_bbObjDelete( obj );
 		BBObj *next=obj->next;
-		if( obj->fields ) _bbObjDelete( obj );
+		_bbObjRelease( obj );
 		obj=next;
 	}
 }
@@ -329,79 +446,30 @@ void BBCALL _bbObjDeleteEach( BBObjType *type ){
 extern void BBCALL _bbDebugLog( BBStr *t );
 extern void BBCALL bbStop( );
 
-void BBCALL _bbObjRelease( BBObj *obj ){
-	if( !obj || --obj->ref_cnt ) return;
+//last reference gone; see _bbObjRelease
+void BBCALL _bbObjFree( BBObj *obj ){
 	unlinkObj( obj );
-	insertObj( obj,&obj->type->free );
+	obj->next=obj->prev=0;
+	freeObj( objPool( obj->type ),obj );
 	--unrelObjCnt;
 }
 
-void BBCALL _bbObjStore( BBObj **var,BBObj *obj ){
-	if( obj ) ++obj->ref_cnt;	//do this first incase of self-assignment
-	_bbObjRelease( *var );
-	*var=obj;
-}
-
-bb_int_t BBCALL _bbObjCompare( BBObj *o1,BBObj *o2 ){
-	return (o1 ? o1->fields : 0)!=(o2 ? o2->fields : 0);
-}
-
-BBObj * BBCALL _bbObjNext( BBObj *obj ){
-	do{
-		obj=obj->next;
-		if( !obj->type ) return 0;
-	}while( !obj->fields );
-	return obj;
-}
-
-BBObj * BBCALL _bbObjPrev( BBObj *obj ){
-	do{
-		obj=obj->prev;
-		if( !obj->type ) return 0;
-	}while( !obj->fields );
-	return obj;
-}
-
-BBObj * BBCALL _bbObjFirst( BBObjType *type ){
-	return _bbObjNext( &type->used );
-}
-
-BBObj * BBCALL _bbObjLast( BBObjType *type ){
-	return _bbObjPrev( &type->used );
-}
-
 void BBCALL _bbObjInsBefore( BBObj *o1,BBObj *o2 ){
 	if( o1==o2 ) return;
+	//either already freed, and so out of the list
+	if( !o1->next || !o2->next ) return;
 	unlinkObj( o1 );
 	insertObj( o1,o2 );
 }
 
 void BBCALL _bbObjInsAfter( BBObj *o1,BBObj *o2 ){
 	if( o1==o2 ) return;
+	//either already freed, and so out of the list
+	if( !o1->next || !o2->next ) return;
 	unlinkObj( o1 );
 	insertObj( o1,o2->next );
 }
 
-bb_int_t BBCALL _bbObjEachFirst( BBObj **var,BBObjType *type ){
-	_bbObjStore( var,_bbObjFirst( type ) );
-	return *var!=0;
-}
-
-bb_int_t BBCALL _bbObjEachNext( BBObj **var ){
-	_bbObjStore( var,_bbObjNext( *var ) );
-	return *var!=0;
-}
-
-bb_int_t BBCALL _bbObjEachFirst2( BBObj **var,BBObjType *type ){
-	*var=_bbObjFirst( type );
-	return *var!=0;
-}
-
-bb_int_t BBCALL _bbObjEachNext2( BBObj **var ){
-	*var=_bbObjNext( *var );
-	return *var!=0;
-}
-
 BBStr * BBCALL _bbObjToStr( BBObj *obj ){
 	if( !obj || !obj->fields ) return d_new BBStr( "[NULL]" );
 
@@ -446,19 +514,31 @@ BBStr * BBCALL _bbObjToStr( BBObj *obj ){
 
 bb_int_t BBCALL _bbObjToHandle( BBObj *obj ){
 	if( !obj || !obj->fields ) return 0;
-	std::map<BBObj*,bb_int_t>::const_iterator it=object_map.find( obj );
-	if( it!=object_map.end() ) return it->second;
-	++next_handle;
-	object_map[obj]=next_handle;
-	handle_map[next_handle]=obj;
-	return next_handle;
+	bb_int_t &handle=objHandle( obj );
+	if( handle ) return handle;
+	int slot;
+	if( free_slots_head>=0 ){
+		slot=free_slots_head;
+		free_slots_head=handle_slots[slot].next_free;
+		if( free_slots_head<0 ) free_slots_tail=-1;
+	}else{
+		if( (bb_int_t)handle_slots.size()>=HANDLE_SLOT_MASK ) RTEX( "Too many object handles" );
+		slot=handle_slots.size();
+		BBHandleSlot t={ 0,0,-1 };
+		handle_slots.push_back( t );
+	}
+	BBHandleSlot &t=handle_slots[slot];
+	t.obj=obj;
+	return handle=( t.gen<<HANDLE_SLOT_BITS )|( slot+1 );
 }
 
 BBObj * BBCALL _bbObjFromHandle( bb_int_t handle,BBObjType *type ){
-	std::map<bb_int_t,BBObj*>::const_iterator it=handle_map.find( handle );
-	if( it==handle_map.end() ) return 0;
-	BBObj *obj=it->second;
-	return obj->type==type ? obj : 0;
+	if( handle<=0 ) return 0;
+	bb_int_t slot=(handle&HANDLE_SLOT_MASK)-1;
+	if( slot<0 || slot>=(bb_int_t)handle_slots.size() ) return 0;
+	const BBHandleSlot &t=handle_slots[slot];
+	if( !t.obj || t.gen!=(handle>>HANDLE_SLOT_BITS) ) return 0;
+	return t.obj->type==type ? t.obj : 0;
 }
 
 void BBCALL _bbNullObjEx(){
@@ -499,26 +579,6 @@ BBStr * BBCALL _bbReadStr(){
 	}
 }
 
-bb_int_t BBCALL _bbAbs( bb_int_t n ){
-	return n>=0 ? n : -n;
-}
-
-bb_int_t BBCALL _bbSgn( bb_int_t n ){
-	return n>0 ? 1 : (n<0 ? -1 : 0);
-}
-
-bb_int_t BBCALL _bbMod( bb_int_t x,bb_int_t y ){
-	return x%y;
-}
-
-bb_float_t BBCALL _bbFAbs( bb_float_t n ){
-	return n>=0 ? n : -n;
-}
-
-bb_float_t BBCALL _bbFSgn( bb_float_t n ){
-	return n>0.0f ? 1.0f : (n<0.0f ? -1.0f : 0.0f);
-}
-
 bb_float_t BBCALL _bbFMod( bb_float_t x,bb_float_t y ){
 	return (float)fmod( x,y );
 }
@@ -555,20 +615,21 @@ void BBCALL bbRuntimeStats(){
 }
 
 BBMODULE_CREATE( blitz ){
-	next_handle=0;
 //	memBlks.clear();
-	handle_map.clear();
-	object_map.clear();
+	handle_slots.clear();
+	free_slots_head=free_slots_tail=-1;
 	stringCnt=objCnt=unrelObjCnt=0;
 	usedStrs.next=usedStrs.prev=&usedStrs;
 	freeStrs.next=freeStrs.prev=&freeStrs;
+	constStrs.clear();
 	return true;
 }
 
 BBMODULE_DESTROY( blitz ){
 	while( usedStrs.next!=&usedStrs ) delete usedStrs.next;
+	constStrs.clear();
 //	while( memBlks.size() ) bbFree( memBlks.back() );
-	handle_map.clear();
-	object_map.clear();
+	handle_slots.clear();
+	free_slots_head=free_slots_tail=-1;
 	return true;
 }
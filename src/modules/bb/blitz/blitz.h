@@ -54,6 +54,13 @@ typedef struct BBObj{
 #endif
 } BBObj;
 
+//Objects live in chunks owned by their type's pool, each just after a header
+//that generated code never sees, holding its chunk slot and handle.
+typedef struct BBObjHeader{
+	int slot;
+	bb_int_t handle;
+} BBObjHeader;
+
 struct BBType{
 	bb_int_t type;
 #ifdef __cplusplus
@@ -67,6 +74,8 @@ struct BBObjType : public BBType{
 struct BBObjType{
 	BBType base;
 #endif
+	//layout left as it was for codegen; free.fields holds the type's object
+	//pool, and only the used list is threaded
 	BBObj used,free;
 	bb_int_t fieldCnt;
 	BBType *fieldTypes[1];
@@ -107,8 +116,12 @@ struct BBArray{
 
 #include <string>
 
+//Strings are shared between variables and the temporaries loaded from them.
+//Runtime commands receive their own copy (see _bbStrUnique) and may modify or
+//delete it as before; the intrinsics below go through ref_cnt instead.
 struct BBStr : public std::string{
 	BBStr *next,*prev;
+	int ref_cnt;
 
 	BBStr();
 	BBStr( const char *s );
@@ -144,8 +157,11 @@ extern "C" {
 // basic
 BBStr *	 BBCALL _bbStrLoad( BBStr **var );
 BBStr * BBCALL _bbStrCopy( BBStr *var );
+BBStr * BBCALL _bbStrUnique( BBStr *str );
 void	 BBCALL _bbStrRelease( BBStr *str );
+void	 BBCALL _bbStrFree( BBStr *str );
 void	 BBCALL _bbStrStore( BBStr **var,BBStr *str );
+void	 BBCALL _bbStrAppend( BBStr **var,BBStr *str );
 bb_int_t BBCALL _bbStrCompare( BBStr *lhs,BBStr *rhs );
 
 BBStr *	 BBCALL _bbStrConcat( BBStr *s1,BBStr *s2 );
@@ -167,6 +183,7 @@ BBObj *	 BBCALL _bbObjNew( BBObjType *t );
 void	 BBCALL _bbObjDelete( BBObj *obj );
 void	 BBCALL _bbObjDeleteEach( BBObjType *type );
 void	 BBCALL _bbObjRelease( BBObj *obj );
+void	 BBCALL _bbObjFree( BBObj *obj );
 void	 BBCALL _bbObjStore( BBObj **var,BBObj *obj );
 BBObj *	 BBCALL _bbObjNext( BBObj *obj );
 BBObj *	 BBCALL _bbObjPrev( BBObj *obj );
@@ -0,0 +1,107 @@
+
+//Runtime primitives the LLVM backend inlines into generated code.
+//
+//These are built into the runtime with the rest of basic, and also compiled to
+//LLVM bitcode (see CMakeLists.txt) that Codegen_LLVM links into each program
+//before optimizing. Anything inlined must resolve against the runtime's symbol
+//table, so code here may only touch the structures in blitz.h and call
+//functions listed in commands.decls - slow paths live in basic.cpp.
+
+#include "blitz.h"
+
+BBStr * BBCALL _bbStrLoad( BBStr **var ){
+	return _bbStrCopy( *var );
+}
+
+BBStr * BBCALL _bbStrCopy( BBStr *var ){
+	if( !var ) return _bbStrConst( "" );
+	++var->ref_cnt;return var;
+}
+
+void BBCALL _bbStrRelease( BBStr *str ){
+	if( str && !--str->ref_cnt ) _bbStrFree( str );
+}
+
+void BBCALL _bbStrStore( BBStr **var,BBStr *str ){
+	_bbStrRelease( *var );*var=str;
+}
+
+void BBCALL _bbObjRelease( BBObj *obj ){
+	if( !obj || --obj->ref_cnt ) return;
+	_bbObjFree( obj );
+}
+
+void BBCALL _bbObjStore( BBObj **var,BBObj *obj ){
+	if( obj ) ++obj->ref_cnt;	//do this first incase of self-assignment
+	_bbObjRelease( *var );
+	*var=obj;
+}
+
+bb_int_t BBCALL _bbObjCompare( BBObj *o1,BBObj *o2 ){
+	return (o1 ? o1->fields : 0)!=(o2 ? o2->fields : 0);
+}
+
+//an object already freed has nothing after or before it
+BBObj * BBCALL _bbObjNext( BBObj *obj ){
+	do{
+		obj=obj->next;
+		if( !obj || !obj->type ) return 0;
+	}while( !obj->fields );
+	return obj;
+}
+
+BBObj * BBCALL _bbObjPrev( BBObj *obj ){
+	do{
+		obj=obj->prev;
+		if( !obj || !obj->type ) return 0;
+	}while( !obj->fields );
+	return obj;
+}
+
+BBObj * BBCALL _bbObjFirst( BBObjType *type ){
+	return _bbObjNext( &type->used );
+}
+
+BBObj * BBCALL _bbObjLast( BBObjType *type ){
+	return _bbObjPrev( &type->used );
+}
+
+bb_int_t BBCALL _bbObjEachFirst( BBObj **var,BBObjType *type ){
+	_bbObjStore( var,_bbObjFirst( type ) );
+	return *var!=0;
+}
+
+bb_int_t BBCALL _bbObjEachNext( BBObj **var ){
+	_bbObjStore( var,_bbObjNext( *var ) );
+	return *var!=0;
+}
+
+bb_int_t BBCALL _bbObjEachFirst2( BBObj **var,BBObjType *type ){
+	*var=_bbObjFirst( type );
+	return *var!=0;
+}
+
+bb_int_t BBCALL _bbObjEachNext2( BBObj **var ){
+	*var=_bbObjNext( *var );
+	return *var!=0;
+}
+
+bb_int_t BBCALL _bbAbs( bb_int_t n ){
+	return n>=0 ? n : -n;
+}
+
+bb_int_t BBCALL _bbSgn( bb_int_t n ){
+	return n>0 ? 1 : (n<0 ? -1 : 0);
+}
+
+bb_int_t BBCALL _bbMod( bb_int_t x,bb_int_t y ){
+	return x%y;
+}
+
+bb_float_t BBCALL _bbFAbs( bb_float_t n ){
+	return n>=0 ? n : -n;
+}
+
+bb_float_t BBCALL _bbFSgn( bb_float_t n ){
+	return n>0.0f ? 1.0f : (n<0.0f ? -1.0f : 0.0f);
+}
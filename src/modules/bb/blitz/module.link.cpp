@@ -17,7 +17,10 @@ BBMODULE_LINK( blitz ){
 	rtSym( "_bbCStrType","&_bbCStrType",&_bbCStrType );
 	rtSym( "_bbStrLoad","_bbStrLoad",_bbStrLoad );
 	rtSym( "_bbStrRelease","_bbStrRelease",_bbStrRelease );
+	rtSym( "_bbStrFree","_bbStrFree",_bbStrFree );
 	rtSym( "_bbStrStore","_bbStrStore",_bbStrStore );
+	rtSym( "_bbStrUnique","_bbStrUnique",_bbStrUnique );
+	rtSym( "_bbStrAppend","_bbStrAppend",_bbStrAppend );
 	rtSym( "_bbStrCompare","_bbStrCompare",_bbStrCompare );
 	rtSym( "_bbStrConcat","_bbStrConcat",_bbStrConcat );
 	rtSym( "_bbStrToInt","_bbStrToInt",_bbStrToInt );
@@ -35,6 +38,7 @@ BBMODULE_LINK( blitz ){
 	rtSym( "_bbObjDelete","_bbObjDelete",_bbObjDelete );
 	rtSym( "_bbObjDeleteEach","_bbObjDeleteEach",_bbObjDeleteEach );
 	rtSym( "_bbObjRelease","_bbObjRelease",_bbObjRelease );
+	rtSym( "_bbObjFree","_bbObjFree",_bbObjFree );
 	rtSym( "_bbObjStore","_bbObjStore",_bbObjStore );
 	rtSym( "_bbObjCompare","_bbObjCompare",_bbObjCompare );
 	rtSym( "_bbObjNext","_bbObjNext",_bbObjNext );
@@ -3,6 +3,7 @@
 #include <bb/graphics.gl/graphics.gl.h>
 #include <bb/graphics.gl/graphics_util.h>
 #include <bb/system/system.h>
+#include <bb/profile/profile.h>
 #include "blitz3d.gl.h"
 #include "default.glsl.h"
 
@@ -151,6 +152,7 @@ public:
 
 	void upload(){
 		if( !(verts_dirty || tris_dirty || skin_dirty) || !verts ) return;
+		BB_PROFILE( "GLMesh::upload" );
 		// re-uploaded buffers are dynamic by nature (sprites, skinning);
 		// full glBufferData orphans the old store, so a rewrite never
 		// stalls on draws still reading the previous contents
@@ -210,6 +212,20 @@ public:
 		verts[n].color[0]=((argb>>16)&255)/255.0;verts[n].color[1]=((argb>>8)&255)/255.0;verts[n].color[2]=(argb&255)/255.0;verts[n].color[3]=((argb>>24)&255)/255.0;
 	}
 
+	void setVertices( int first,int cnt,const float *coords,const float *normals,const void *_v ){
+		const Surface::Vertex *v=(const Surface::Vertex*)_v;
+		verts_dirty=true;
+		GLVertex *out=verts+first;
+		for( int k=0;k<cnt;++k,++out,++v,coords+=3,normals+=3 ){
+			out->coords[0]=coords[0];out->coords[1]=coords[1];out->coords[2]=coords[2];
+			out->normal[0]=normals[0];out->normal[1]=normals[1];out->normal[2]=normals[2];
+			out->tex_coord0[0]=v->tex_coords[0][0];out->tex_coord0[1]=v->tex_coords[0][1];
+			out->tex_coord1[0]=v->tex_coords[1][0];out->tex_coord1[1]=v->tex_coords[1][1];
+			unsigned argb=v->color;
+			out->color[0]=((argb>>16)&255)/255.0;out->color[1]=((argb>>8)&255)/255.0;out->color[2]=(argb&255)/255.0;out->color[3]=((argb>>24)&255)/255.0;
+		}
+	}
+
 	void setTriangle( int n,int v0,int v1,int v2 ){
 		tris_dirty=true;
 		tris[n*3+0]=v2;
@@ -825,6 +841,9 @@ public:
 
 	//rendering
 	bool begin( const std::vector<BBLightRep*> &l ){
+		// 2D queued before RenderWorld is drawn before it
+		bbGLFlush2D();
+
 		if( !glIsProgram( defaultProgram ) ){
 			GL( glUseProgram( 0 ) );
 
@@ -0,0 +1,450 @@
+#include "../stdutil/stdutil.h"
+#include "blitz3d.null.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+NullStats bbNullFrame,bbNullTotal;
+
+void NullStats::add( const NullStats &s ){
+	draws+=s.draws;tris+=s.tris;verts+=s.verts;
+	states+=s.states;state_changes+=s.state_changes;
+	texture_binds+=s.texture_binds;
+	matrices+=s.matrices;
+	uploads+=s.uploads;upload_bytes+=s.upload_bytes;
+	download_bytes+=s.download_bytes;
+	clears+=s.clears;ops2d+=s.ops2d;
+}
+
+// per frame stats dump
+static FILE *stats_out=0;
+static int64_t stats_frame=0;
+static std::chrono::steady_clock::time_point stats_time;
+
+static void beginStats(){
+	bbNullFrame=NullStats();
+	bbNullTotal=NullStats();
+	stats_frame=0;
+	stats_time=std::chrono::steady_clock::now();
+
+	const char *path=getenv( "BB_RENDER_STATS" );
+	if( !path || !*path || stats_out ) return;
+	stats_out=strcmp( path,"-" ) ? fopen( path,"w" ) : stdout;
+	if( !stats_out ) return;
+	fprintf( stats_out,"frame\tdraws\ttris\tverts\tstates\tchanges\ttexbinds\tmatrices\tuploads\tup_bytes\tdown_bytes\tclears\tops2d\tus\n" );
+}
+
+static void endStats(){
+	if( stats_out && stats_out!=stdout ) fclose( stats_out );
+	else if( stats_out ) fflush( stats_out );
+	stats_out=0;
+}
+
+static void endFrame(){
+	std::chrono::steady_clock::time_point now=std::chrono::steady_clock::now();
+	int64_t us=std::chrono::duration_cast<std::chrono::microseconds>( now-stats_time ).count();
+	stats_time=now;
+
+	const NullStats &f=bbNullFrame;
+	if( stats_out ){
+		fprintf( stats_out,"%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\n",
+			(long long)stats_frame,(long long)f.draws,(long long)f.tris,(long long)f.verts,
+			(long long)f.states,(long long)f.state_changes,(long long)f.texture_binds,(long long)f.matrices,
+			(long long)f.uploads,(long long)f.upload_bytes,(long long)f.download_bytes,
+			(long long)f.clears,(long long)f.ops2d,(long long)us );
+	}
+
+	bbNullTotal.add( f );
+	bbNullFrame=NullStats();
+	++stats_frame;
+}
+
+//GRAPHICS
+NullGraphics::NullGraphics( int w,int h ):width(w),height(h),def_font(0){
+	for( int k=0;k<256;++k ) gamma[0][k]=gamma[1][k]=gamma[2][k]=k;
+
+	NullCanvas *fb=d_new NullCanvas( w,h,BBCanvas::CANVAS_TEX_VIDMEM );
+	fb->display=true;
+	front_canvas=fb;
+
+	NullCanvas *bb=d_new NullCanvas( w,h,BBCanvas::CANVAS_TEX_VIDMEM );
+	bb->display=true;
+	back_canvas=bb;
+
+	beginStats();
+}
+
+NullGraphics::~NullGraphics(){
+	while( canvas_set.size() ) freeCanvas( *canvas_set.begin() );
+	delete front_canvas;
+	delete back_canvas;
+
+	endStats();
+}
+
+bool NullGraphics::init(){
+	// headless machines often have no fonts installed; Text is only counted,
+	// so carry on without a default font rather than failing Graphics
+	def_font=loadFont( "courier",12,0 );
+	if( def_font==0 ){
+		def_font=loadFont( "courier new",12,0 );
+	}
+
+	return true;
+}
+
+BBFont *NullGraphics::getDefaultFont()const{
+	return def_font;
+}
+
+void NullGraphics::copy( BBCanvas *dest,int dx,int dy,int dw,int dh,BBCanvas *src,int sx,int sy,int sw,int sh ){
+	dest->blit( dx,dy,src,sx,sy,sw,sh,false );
+}
+
+void NullGraphics::setGamma( int r,int g,int b,float dr,float dg,float db ){
+	gamma[0][r&255]=dr;gamma[1][g&255]=dg;gamma[2][b&255]=db;
+}
+
+void NullGraphics::getGamma( int r,int g,int b,float *dr,float *dg,float *db ){
+	*dr=gamma[0][r&255];*dg=gamma[1][g&255];*db=gamma[2][b&255];
+}
+
+//OBJECTS
+BBCanvas *NullGraphics::createCanvas( int width,int height,int flags ){
+	NullCanvas *canvas=d_new NullCanvas( width,height,flags );
+	canvas_set.insert( canvas );
+	return canvas;
+}
+
+BBCanvas *NullGraphics::loadCanvas( const std::string &file,int flags ){
+	BBPixmap *pixmap=bbLoadPixmap( file );
+	if( !pixmap ) return 0;
+
+	NullCanvas *canvas=d_new NullCanvas( 0,0,flags );
+	canvas->setPixmap( pixmap );
+	canvas_set.insert( canvas );
+	return canvas;
+}
+
+BBCanvas *NullGraphics::loadCanvas( const void *data,size_t size,int flags ){
+	BBPixmap *pixmap=bbLoadPixmap( data,size );
+	if( !pixmap ) return 0;
+
+	NullCanvas *canvas=d_new NullCanvas( 0,0,flags );
+	canvas->setPixmap( pixmap );
+	canvas_set.insert( canvas );
+	return canvas;
+}
+
+//SCENE
+class NullLight : public BBLightRep{
+public:
+	void update( Light *light ){}
+};
+
+// same layouts as blitz3d.gl, so the vertex writes cost what they do there
+// and the byte counts match what it would upload
+struct NullVertex{
+	float coords[3];
+	float normal[3];
+	float color[4];
+	float tex_coord0[2];
+	float tex_coord1[2];
+};
+
+struct NullSkinVertex{
+	float weights[4];
+	float bones[4];
+};
+
+class NullMesh : public BBMesh{
+protected:
+	bool dirty()const{ return false; }
+
+public:
+	int max_verts,max_tris,flags;
+	NullVertex *verts=0;
+	unsigned int *tris=0;
+	NullSkinVertex *skin=0;
+
+	bool verts_dirty=false,tris_dirty=false,skin_dirty=false;
+
+	NullMesh( int mv,int mt,int f ):max_verts(mv),max_tris(mt),flags(f){
+	}
+
+	~NullMesh(){
+		delete[] verts;
+		delete[] tris;
+		delete[] skin;
+	}
+
+	bool lock( bool all ){
+		if( !verts ) verts=new NullVertex[max_verts];
+		if( !tris ) tris=new unsigned int[max_tris*3];
+		if( (flags&BBScene::MESH_SKINNED) && !skin ) skin=new NullSkinVertex[max_verts]();
+		return true;
+	}
+
+	void unlock(){
+	}
+
+	// blitz3d.gl uploads whole buffers at the first draw after a change
+	void upload(){
+		if( verts_dirty ){
+			++bbNullFrame.uploads;
+			bbNullFrame.upload_bytes+=(int64_t)max_verts*sizeof(NullVertex);
+			verts_dirty=false;
+		}
+		if( tris_dirty ){
+			++bbNullFrame.uploads;
+			bbNullFrame.upload_bytes+=(int64_t)max_tris*3*sizeof(unsigned int);
+			tris_dirty=false;
+		}
+		if( skin_dirty ){
+			++bbNullFrame.uploads;
+			bbNullFrame.upload_bytes+=(int64_t)max_verts*sizeof(NullSkinVertex);
+			skin_dirty=false;
+		}
+	}
+
+	void setVertex( int n,const void *_v ){
+		const Surface::Vertex *v=(const Surface::Vertex*)_v;
+		float coords[3]={ v->coords.x,v->coords.y,v->coords.z };
+		float normal[3]={ v->normal.x,v->normal.y,v->normal.z };
+		setVertex( n,coords,normal,v->color,v->tex_coords );
+	}
+
+	void setVertex( int n,const float coords[3],const float normal[3],const float tex_coords[2][2] ){
+		setVertex( n,coords,normal,0xffffff,tex_coords );
+	}
+
+	void setVertex( int n,const float coords[3],const float normal[3],unsigned argb,const float tex_coords[2][2] ){
+		verts_dirty=true;
+		NullVertex &out=verts[n];
+		memcpy( out.coords,coords,sizeof(out.coords) );
+		memcpy( out.normal,normal,sizeof(out.normal) );
+		memcpy( out.tex_coord0,tex_coords[0],sizeof(out.tex_coord0) );
+		memcpy( out.tex_coord1,tex_coords[1],sizeof(out.tex_coord1) );
+		out.color[0]=((argb>>16)&255)/255.0f;out.color[1]=((argb>>8)&255)/255.0f;out.color[2]=(argb&255)/255.0f;out.color[3]=((argb>>24)&255)/255.0f;
+	}
+
+	void setVertices( int first,int cnt,const float *coords,const float *normals,const void *_v ){
+		const Surface::Vertex *v=(const Surface::Vertex*)_v;
+		for( int k=0;k<cnt;++k,++v,coords+=3,normals+=3 ){
+			setVertex( first+k,coords,normals,v->color,v->tex_coords );
+		}
+	}
+
+	void setTriangle( int n,int v0,int v1,int v2 ){
+		tris_dirty=true;
+		tris[n*3+0]=v2;
+		tris[n*3+1]=v1;
+		tris[n*3+2]=v0;
+	}
+
+	void setVertexWeights( int n,const float weights[4],const float bones[4] ){
+		if( !skin ) return;
+		skin_dirty=true;
+		memcpy( skin[n].weights,weights,sizeof(skin[n].weights) );
+		memcpy( skin[n].bones,bones,sizeof(skin[n].bones) );
+	}
+};
+
+class NullScene : public BBScene{
+private:
+	// last state applied, to count the changes a real renderer would make
+	RenderState last;
+	bool last_valid=false;
+	BBCanvas *bound[MAX_TEXTURES];
+	int skin_count=0;
+
+public:
+	NullScene(){
+		memset( bound,0,sizeof(bound) );
+	}
+
+	int  hwTexUnits(){ return MAX_TEXTURES; }
+	int  gfxDriverCaps3D(){ return 110; }
+
+	void setWBuffer( bool enable ){}
+	void setHWMultiTex( bool enable ){}
+	void setDither( bool enable ){}
+	void setAntialias( bool enable ){}
+	void setWireframe( bool enable ){}
+	void setFlippedTris( bool enable ){}
+	void setAmbient( const float rgb[3] ){}
+	void setAmbient2( const float rgb[3] ){}
+	void setFogColor( const float rgb[3] ){}
+	void setFogRange( float nr,float fr ){}
+	void setFogMode( int mode ){}
+	void setZMode( int mode ){}
+	void setCanvas( int w,int h ){}
+	void setViewport( int x,int y,int w,int h ){}
+	void setOrthoProj( float nr,float fr,float nr_l,float nr_r,float nr_t,float nr_b ){}
+	void setPerspProj( float nr,float fr,float nr_l,float nr_r,float nr_t,float nr_b ){}
+	void setViewMatrix( const Matrix *matrix ){}
+
+	void setWorldMatrix( const Matrix *matrix ){
+		++bbNullFrame.matrices;
+	}
+
+	int maxBones()const{ return 64; }
+
+	void setRenderBones( const float *matrices,int count ){
+		if( count ){
+			++bbNullFrame.uploads;
+			bbNullFrame.upload_bytes+=count*16*sizeof(float);
+		}
+		skin_count=count;
+	}
+
+	void setRenderState( const RenderState &rs ){
+		++bbNullFrame.states;
+
+		bool changed=!last_valid || rs.blend!=last.blend || rs.fx!=last.fx ||
+			memcmp( rs.color,last.color,sizeof(rs.color) ) || rs.alpha!=last.alpha || rs.shininess!=last.shininess;
+
+		for( int i=0;i<MAX_TEXTURES;i++ ){
+			const RenderState::TexState &ts=rs.tex_states[i];
+
+			if( last_valid && (ts.blend!=last.tex_states[i].blend || ts.flags!=last.tex_states[i].flags) ) changed=true;
+
+			NullCanvas *canvas=(NullCanvas*)ts.canvas;
+			if( canvas && canvas->dirty ){
+				++bbNullFrame.uploads;
+				bbNullFrame.upload_bytes+=canvas->bytes()*(canvas->getFlags()&BBCanvas::CANVAS_TEX_CUBE ? 6 : 1);
+				canvas->dirty=false;
+			}
+			if( ts.canvas!=bound[i] ){
+				if( ts.canvas ) ++bbNullFrame.texture_binds;
+				bound[i]=ts.canvas;
+				changed=true;
+			}
+		}
+
+		if( changed ) ++bbNullFrame.state_changes;
+		last=rs;
+		last_valid=true;
+	}
+
+	//rendering
+	bool begin( const std::vector<BBLightRep*> &lights ){
+		// 2D drawing between renders disturbs the same state
+		last_valid=false;
+		memset( bound,0,sizeof(bound) );
+		return true;
+	}
+
+	void clear( const float rgb[3],float alpha,float z,bool clear_argb,bool clear_z ){
+		if( clear_argb || clear_z ) ++bbNullFrame.clears;
+	}
+
+	void render( BBMesh *m,int first_vert,int vert_cnt,int first_tri,int tri_cnt ){
+		NullMesh *mesh=(NullMesh*)m;
+		mesh->upload();
+
+		++bbNullFrame.draws;
+		bbNullFrame.tris+=tri_cnt;
+		bbNullFrame.verts+=vert_cnt;
+	}
+
+	void end(){}
+
+	//lighting
+	BBLightRep *createLight( int flags ){
+		return d_new NullLight();
+	}
+	void freeLight( BBLightRep *l ){}
+
+	//meshes
+	BBMesh *createMesh( int max_verts,int max_tris,int flags ){
+		BBMesh *mesh=d_new NullMesh( max_verts,max_tris,flags );
+		mesh_set.insert( mesh );
+		return mesh;
+	}
+
+	//info
+	int getTrianglesDrawn()const{ return (int)(bbNullTotal.tris+bbNullFrame.tris); }
+};
+
+//CONTEXT
+static const int null_modes[][2]={
+	{ 640,480 },{ 800,600 },{ 1024,768 },{ 1280,720 },{ 1920,1080 }
+};
+
+NullContextDriver::NullContextDriver(){
+	bbSceneDriver=this;
+}
+
+int NullContextDriver::numGraphicsDrivers(){
+	return 1;
+}
+
+void NullContextDriver::graphicsDriverInfo( int driver,std::string *name,int *c ){
+	*name="Null";
+	*c=GFXMODECAPS_3D;
+}
+
+int NullContextDriver::numGraphicsModes( int driver ){
+	return sizeof(null_modes)/sizeof(null_modes[0]);
+}
+
+void NullContextDriver::graphicsModeInfo( int driver,int mode,int *w,int *h,int *d,int *c ){
+	*w=null_modes[mode][0];
+	*h=null_modes[mode][1];
+	*d=32;
+	*c=GFXMODECAPS_3D;
+}
+
+void NullContextDriver::windowedModeInfo( int *c ){
+	*c=GFXMODECAPS_3D;
+}
+
+BBGraphics *NullContextDriver::openGraphics( int w,int h,int d,int driver,int flags ){
+	if( graphics ) return 0;
+
+	graphics=d_new NullGraphics( w,h );
+	if( graphics->init() ) return graphics;
+
+	delete graphics;graphics=0;
+	return 0;
+}
+
+void NullContextDriver::closeGraphics( BBGraphics *g ){
+	if( graphics!=g || !g ) return;
+	delete graphics;graphics=0;
+}
+
+bool NullContextDriver::graphicsLost(){
+	return false;
+}
+
+void NullContextDriver::flip( bool vwait ){
+	endFrame();
+}
+
+BBScene *NullContextDriver::createScene( int w,int h,float d,int flags ){
+	if( scene_set.size() ) return 0;
+
+	NullScene *scene=d_new NullScene();
+	scene_set.insert( scene );
+	return scene;
+}
+
+static BBContextDriver *createNullContext( const std::string &name ){
+	if( name!="null" && name!="headless" ) return 0;
+
+	return d_new NullContextDriver();
+}
+
+BBMODULE_CREATE( blitz3d_null ){
+	bbContextDrivers.push_back( createNullContext );
+
+	return true;
+}
+
+BBMODULE_DESTROY( blitz3d_null ){
+	return true;
+}
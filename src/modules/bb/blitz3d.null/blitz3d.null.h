@@ -0,0 +1,101 @@
+#ifndef BB_BLITZ3D_NULL_H
+#define BB_BLITZ3D_NULL_H
+
+#include <bb/blitz3d/blitz3d.h>
+#include <bb/blitz3d/graphics.h>
+#include <bb/graphics/graphics.h>
+#include "canvas.h"
+
+#include <cstdint>
+
+// A renderer that draws nothing and counts everything. The whole CPU side
+// of RenderWorld (culling, queueing, sorting, skinning) runs as usual, and
+// the work handed to the scene is tallied as if it went to the GL renderer:
+// meshes upload on first draw after a change, canvases when they are next
+// bound as a texture, with the same buffer layouts blitz3d.gl uses.
+//
+// Chosen with SetRenderer "null"; the headless runtime does that itself.
+// With BB_RENDER_STATS set to a file name, or "-" for stdout, every Flip
+// writes one tab separated line of the counts for the frame just ended.
+struct NullStats{
+	int64_t draws=0,tris=0,verts=0;
+	int64_t states=0,state_changes=0;
+	int64_t texture_binds=0;
+	int64_t matrices=0;
+	int64_t uploads=0,upload_bytes=0;
+	int64_t download_bytes=0;
+	int64_t clears=0,ops2d=0;
+
+	void add( const NullStats &s );
+};
+
+// the frame in progress, and everything since graphics were opened
+extern NullStats bbNullFrame,bbNullTotal;
+
+class NullGraphics : public BBGraphics{
+protected:
+	int width,height;
+	BBFont *def_font;
+	float gamma[3][256];
+
+public:
+	NullGraphics( int w,int h );
+	~NullGraphics();
+
+	bool init();
+
+	void backup(){}
+	bool restore(){ return true; }
+
+	//MANIPULATORS
+	void vwait(){}
+
+	//SPECIAL!
+	void copy( BBCanvas *dest,int dx,int dy,int dw,int dh,BBCanvas *src,int sx,int sy,int sw,int sh );
+
+	//NEW! Gamma control!
+	void setGamma( int r,int g,int b,float dr,float dg,float db );
+	void getGamma( int r,int g,int b,float *dr,float *dg,float *db );
+	void updateGamma( bool calibrate ){}
+
+	//ACCESSORS
+	int getWidth()const{ return width; }
+	int getHeight()const{ return height; }
+	int getLogicalWidth()const{ return width; }
+	int getLogicalHeight()const{ return height; }
+	int getDepth()const{ return 32; }
+	float getDensity()const{ return 1.0f; }
+	int getScanLine()const{ return 0; }
+	int getAvailVidmem()const{ return 0; }
+	int getTotalVidmem()const{ return 0; }
+
+	BBFont *getDefaultFont()const;
+
+	//OBJECTS
+	BBCanvas *createCanvas( int width,int height,int flags );
+	BBCanvas *loadCanvas( const std::string &file,int flags );
+	BBCanvas *loadCanvas( const void *data,size_t size,int flags );
+
+	BBMovie *openMovie( const std::string &file,int flags ){ return 0; }
+};
+
+class NullContextDriver : public B3DGraphics,public BBContextDriver{
+public:
+	NullContextDriver();
+
+	int numGraphicsDrivers();
+	void graphicsDriverInfo( int driver,std::string *name,int *c );
+	int numGraphicsModes( int driver );
+	void graphicsModeInfo( int driver,int mode,int *w,int *h,int *d,int *c );
+	void windowedModeInfo( int *c );
+
+	BBGraphics *openGraphics( int w,int h,int d,int driver,int flags );
+	void closeGraphics( BBGraphics *graphics );
+	bool graphicsLost();
+
+	void flip( bool vwait );
+
+	BBScene *createScene( int w,int h,float d,int flags );
+};
+
+#endif
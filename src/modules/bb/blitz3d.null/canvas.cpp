@@ -0,0 +1,359 @@
+#include "../stdutil/stdutil.h"
+#include "blitz3d.null.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+NullCanvas::NullCanvas( int w,int h,int f ):width(0),height(0),pixels(0),font(0),mask(0),color(0xffffffff),cls_color(0xff000000),cube_mode(0),cube_face(0),locked(false),write_only(false),written_count(0),dirty(true),display(false){
+	flags=f;
+
+	setOrigin( 0,0 );
+	setHandle( 0,0 );
+	setScale( 1.0,1.0 );
+
+	resize( w,h );
+}
+
+NullCanvas::~NullCanvas(){
+	delete[] pixels;
+}
+
+void NullCanvas::resize( int w,int h ){
+	delete[] pixels;
+	width=w;height=h;
+	pixels=width>0 && height>0 ? new unsigned[width*height]() : 0;
+	vx=vy=0;vw=w;vh=h;
+	written_x0=width;written_y0=height;
+	written_x1=written_y1=0;
+	written.clear();
+	dirty=true;
+}
+
+void NullCanvas::setPixmap( BBPixmap *pm ){
+	// loaded bits are bottom up BGR(A), as blitz3d.gl gets them
+	pm->flipVertically();
+	resize( pm->width,pm->height );
+
+	for( int y=0;y<height;++y ){
+		const unsigned char *p=pm->bits+y*width*pm->bpp;
+		unsigned *q=pixels+y*width;
+		for( int x=0;x<width;++x,p+=pm->bpp ){
+			unsigned r,g,b,a=255;
+			if( pm->bpp>=3 ){
+				b=p[0];g=p[1];r=p[2];
+				if( pm->bpp==4 ) a=p[3];
+			}else{
+				r=g=b=p[0];
+			}
+			*q++=(a<<24)|(r<<16)|(g<<8)|b;
+		}
+	}
+
+	delete pm;
+}
+
+void NullCanvas::put( int x,int y,unsigned argb ){
+	if( x<vx || x>=vx+vw || y<vy || y>=vy+vh ) return;
+	if( x<0 || x>=width || y<0 || y>=height ) return;
+	pixels[y*width+x]=argb;
+}
+
+void NullCanvas::span( int x,int y,int w,unsigned argb ){
+	if( y<vy || y>=vy+vh || y<0 || y>=height ) return;
+	int x0=std::max( std::max( x,vx ),0 );
+	int x1=std::min( std::min( x+w,vx+vw ),width );
+	unsigned *p=pixels+y*width;
+	for( int k=x0;k<x1;++k ) p[k]=argb;
+}
+
+void NullCanvas::setFont( BBFont *f ){
+	font=f;
+}
+
+void NullCanvas::setMask( unsigned argb ){
+	mask=argb;
+}
+
+void NullCanvas::setColor( unsigned argb ){
+	color=argb|0xff000000;
+}
+
+void NullCanvas::setClsColor( unsigned argb ){
+	cls_color=argb|0xff000000;
+}
+
+void NullCanvas::setOrigin( int x,int y ){
+	origin_x=x;
+	origin_y=y;
+}
+
+void NullCanvas::setScale( float x,float y ){
+	scale_x=x;
+	scale_y=y;
+}
+
+void NullCanvas::setHandle( int x,int y ){
+	handle_x=x;
+	handle_y=y;
+}
+
+void NullCanvas::setViewport( int x,int y,int w,int h ){
+	vx=x;vy=y;vw=w;vh=h;
+}
+
+void NullCanvas::cls(){
+	++bbNullFrame.clears;
+	for( int y=vy;y<vy+vh;++y ) span( vx,y,vw,cls_color );
+	dirty=true;
+}
+
+void NullCanvas::plot( int x,int y ){
+	++bbNullFrame.ops2d;
+	put( x,y,color );
+	dirty=true;
+}
+
+void NullCanvas::line( int x,int y,int x2,int y2 ){
+	++bbNullFrame.ops2d;
+	int dx=abs( x2-x ),sx=x<x2 ? 1 : -1;
+	int dy=-abs( y2-y ),sy=y<y2 ? 1 : -1;
+	int err=dx+dy;
+	for(;;){
+		put( x,y,color );
+		if( x==x2 && y==y2 ) break;
+		int e2=err*2;
+		if( e2>=dy ){ err+=dy;x+=sx; }
+		if( e2<=dx ){ err+=dx;y+=sy; }
+	}
+	dirty=true;
+}
+
+void NullCanvas::rect( int x,int y,int w,int h,bool solid ){
+	++bbNullFrame.ops2d;
+	if( w<=0 || h<=0 ) return;
+	if( solid ){
+		for( int k=0;k<h;++k ) span( x,y+k,w,color );
+	}else{
+		span( x,y,w,color );
+		span( x,y+h-1,w,color );
+		for( int k=1;k<h-1;++k ){
+			put( x,y+k,color );
+			put( x+w-1,y+k,color );
+		}
+	}
+	dirty=true;
+}
+
+void NullCanvas::oval( int x,int y,int w,int h,bool solid ){
+	++bbNullFrame.ops2d;
+	if( !solid || w<=0 || h<=0 ) return;
+	float rx=w*.5f,ry=h*.5f;
+	for( int k=0;k<h;++k ){
+		float t=(k+.5f-ry)/ry;
+		int hw=(int)(rx*sqrtf( std::max( 1-t*t,0.0f ) )+.5f);
+		span( x+(int)rx-hw,y+k,hw*2,color );
+	}
+	dirty=true;
+}
+
+void NullCanvas::text( int x,int y,const std::string &t ){
+	++bbNullFrame.ops2d;
+	dirty=true;
+}
+
+void NullCanvas::blit( int x,int y,BBCanvas *s,int src_x,int src_y,int src_w,int src_h,bool solid ){
+	++bbNullFrame.ops2d;
+	NullCanvas *src=(NullCanvas*)s;
+	unsigned m=src->mask&0xffffff;
+	for( int j=0;j<src_h;++j ){
+		int sy=src_y+j;
+		if( sy<0 || sy>=src->height ) continue;
+		for( int i=0;i<src_w;++i ){
+			int sx=src_x+i;
+			if( sx<0 || sx>=src->width ) continue;
+			unsigned p=src->pixels[sy*src->width+sx];
+			if( !solid && (p&0xffffff)==m ) continue;
+			put( x+i,y+j,p );
+		}
+	}
+	dirty=true;
+}
+
+void NullCanvas::image( BBCanvas *c,int x,int y,bool solid ){
+	NullCanvas *src=(NullCanvas*)c;
+	blit( x-src->handle_x,y-src->handle_y,src,0,0,src->width,src->height,solid );
+}
+
+bool NullCanvas::collide( int x,int y,const BBCanvas *s,int src_x,int src_y,bool solid ){
+	const NullCanvas *src=(const NullCanvas*)s;
+
+	int x1=x-handle_x,y1=y-handle_y;
+	int x2=src_x-src->handle_x,y2=src_y-src->handle_y;
+
+	int l=std::max( x1,x2 ),r=std::min( x1+width,x2+src->width );
+	int t=std::max( y1,y2 ),b=std::min( y1+height,y2+src->height );
+	if( l>=r || t>=b ) return false;
+	if( solid ) return true;
+
+	unsigned m1=mask&0xffffff,m2=src->mask&0xffffff;
+	for( int py=t;py<b;++py ){
+		for( int px=l;px<r;++px ){
+			if( (pixels[(py-y1)*width+px-x1]&0xffffff)==m1 ) continue;
+			if( (src->pixels[(py-y2)*src->width+px-x2]&0xffffff)==m2 ) continue;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool NullCanvas::rect_collide( int x,int y,int rect_x,int rect_y,int rect_w,int rect_h,bool solid ){
+	int x1=x-handle_x,y1=y-handle_y;
+
+	int l=std::max( x1,rect_x ),r=std::min( x1+width,rect_x+rect_w );
+	int t=std::max( y1,rect_y ),b=std::min( y1+height,rect_y+rect_h );
+	if( l>=r || t>=b ) return false;
+	if( solid ) return true;
+
+	unsigned m=mask&0xffffff;
+	for( int py=t;py<b;++py ){
+		for( int px=l;px<r;++px ){
+			if( (pixels[(py-y1)*width+px-x1]&0xffffff)!=m ) return true;
+		}
+	}
+	return false;
+}
+
+bool NullCanvas::lock( bool write_only ){
+	if( locked ) return false;
+	written_x0=width;written_y0=height;
+	written_x1=written_y1=0;
+	// blitz3d.gl reads the whole canvas back unless told it won't be read,
+	// and only sends back the written rect of textures that are up to date
+	this->write_only=write_only && ( display || !dirty );
+	if( this->write_only ){
+		if( written.empty() ) written.assign( width*height,0 );
+		written_count=0;
+	}else{
+		bbNullFrame.download_bytes+=bytes();
+	}
+	return locked=true;
+}
+
+void NullCanvas::setPixel( int x,int y,unsigned argb ){
+	bool l=lock( true );
+	setPixelFast( x,y,argb );
+	if( l ) unlock();
+}
+
+void NullCanvas::setPixelFast( int x,int y,unsigned argb ){
+	if( x<0 || x>=width || y<0 || y>=height ) return;
+	pixels[y*width+x]=argb;
+
+	if( write_only ){
+		unsigned char &m=written[y*width+x];
+		if( !m ){ m=1;++written_count; }
+	}
+	if( x<written_x0 ) written_x0=x;
+	if( x>=written_x1 ) written_x1=x+1;
+	if( y<written_y0 ) written_y0=y;
+	if( y>=written_y1 ) written_y1=y+1;
+}
+
+void NullCanvas::copyPixel( int x,int y,BBCanvas *src,int src_x,int src_y ){
+	bool l=lock();
+	copyPixelFast( x,y,src,src_x,src_y );
+	if( l ) unlock();
+}
+
+void NullCanvas::copyPixelFast( int x,int y,BBCanvas *src,int src_x,int src_y ){
+	setPixelFast( x,y,((NullCanvas*)src)->getPixelFast( src_x,src_y ) );
+}
+
+unsigned NullCanvas::getPixel( int x,int y ){
+	// blitz3d.gl reads back just the one pixel when not locked
+	if( !locked ) bbNullFrame.download_bytes+=4;
+	return getPixelFast( x,y );
+}
+
+unsigned NullCanvas::getPixelFast( int x,int y ){
+	if( x<0 || x>=width || y<0 || y>=height ) return 0;
+	return pixels[y*width+x];
+}
+
+void NullCanvas::unlock(){
+	if( !locked ) return;
+	locked=false;
+
+	bool wo=write_only;
+	write_only=false;
+	if( written_x0>=written_x1 || written_y0>=written_y1 ) return;
+
+	int w=written_x1-written_x0,h=written_y1-written_y0;
+	if( wo ){
+		// blitz3d.gl reads back the pixels of the rect that weren't written
+		if( written_count<w*h ) bbNullFrame.download_bytes+=w*h*4;
+		for( int y=written_y0;y<written_y1;++y ) memset( written.data()+y*width+written_x0,0,w );
+	}
+
+	// blitz3d.gl sends just the written rect, unless a texture is due a
+	// whole upload at its next bind anyway
+	if( display || !dirty ){
+		++bbNullFrame.uploads;
+		bbNullFrame.upload_bytes+=w*h*4;
+	}
+}
+
+void NullCanvas::setCubeMode( int mode ){
+	cube_mode=mode;
+}
+
+void NullCanvas::setCubeFace( int face ){
+	cube_face=face;
+}
+
+//ACCESSORS
+int NullCanvas::getWidth()const{
+	return width;
+}
+
+int NullCanvas::getHeight()const{
+	return height;
+}
+
+int NullCanvas::getDepth()const{
+	return 32;
+}
+
+int NullCanvas::cubeMode()const{
+	return cube_mode;
+}
+
+void NullCanvas::getOrigin( int *x,int *y )const{
+	*x=origin_x;*y=origin_y;
+}
+
+void NullCanvas::getScale( float *x,float *y )const{
+	*x=scale_x;*y=scale_y;
+}
+
+void NullCanvas::getHandle( int *x,int *y )const{
+	*x=handle_x;*y=handle_y;
+}
+
+void NullCanvas::getViewport( int *x,int *y,int *w,int *h )const{
+	*x=vx;*y=vy;*w=vw;*h=vh;
+}
+
+unsigned NullCanvas::getMask()const{
+	return mask;
+}
+
+unsigned NullCanvas::getColor()const{
+	return color;
+}
+
+unsigned NullCanvas::getClsColor()const{
+	return cls_color;
+}
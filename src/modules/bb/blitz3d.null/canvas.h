@@ -0,0 +1,101 @@
+#ifndef BB_BLITZ3D_NULL_CANVAS_H
+#define BB_BLITZ3D_NULL_CANVAS_H
+
+#include <bb/graphics/graphics.h>
+#include <bb/pixmap/pixmap.h>
+
+// a canvas kept entirely in memory as 0xAARRGGBB pixels. 2D drawing
+// writes the pixels it can without a rasterizer (cls, plot, line, rect,
+// blit, image) so pixel reads and collisions still see the right thing;
+// text and non-solid ovals are only counted
+class NullCanvas : public BBCanvas{
+protected:
+	void backup()const{}
+
+	int width,height;
+	unsigned *pixels;
+	BBFont *font;
+
+	int vx,vy,vw,vh;
+	float scale_x,scale_y;
+	int origin_x,origin_y;
+	int handle_x,handle_y;
+	unsigned mask,color,cls_color;
+	int cube_mode,cube_face;
+	bool locked;
+	int written_x0,written_y0,written_x1,written_y1;	//rect set since lock()
+	bool write_only;
+	std::vector<unsigned char> written;	//pixels set under a write only lock
+	int written_count;
+
+	void put( int x,int y,unsigned argb );
+	void span( int x,int y,int w,unsigned argb );
+public:
+	NullCanvas( int w,int h,int f );
+	~NullCanvas();
+
+	// contents changed since the last upload; the scene counts an upload
+	// of the whole canvas the next time it is bound as a texture
+	bool dirty;
+
+	// front or back buffer: unlock always writes straight back, as it would
+	// to a framebuffer
+	bool display;
+
+	int bytes()const{ return width*height*4; }
+
+	void setPixmap( BBPixmap *pm );
+	void resize( int w,int h );
+
+	void set(){}
+	void unset(){}
+
+	//MANIPULATORS
+	void setFont( BBFont *f );
+	void setMask( unsigned argb );
+	void setColor( unsigned argb );
+	void setClsColor( unsigned argb );
+	void setOrigin( int x,int y );
+	void setScale( float x,float y );
+	void setHandle( int x,int y );
+	void setViewport( int x,int y,int w,int h );
+
+	void cls();
+	void plot( int x,int y );
+	void line( int x,int y,int x2,int y2 );
+	void rect( int x,int y,int w,int h,bool solid );
+	void oval( int x,int y,int w,int h,bool solid );
+	void text( int x,int y,const std::string &t );
+	void blit( int x,int y,BBCanvas *s,int src_x,int src_y,int src_w,int src_h,bool solid );
+	void image( BBCanvas *c,int x,int y,bool solid );
+
+	bool collide( int x,int y,const BBCanvas *src,int src_x,int src_y,bool solid );
+	bool rect_collide( int x,int y,int rect_x,int rect_y,int rect_w,int rect_h,bool solid );
+
+	bool lock( bool write_only=false );
+	void setPixel( int x,int y,unsigned argb );
+	void setPixelFast( int x,int y,unsigned argb );
+	void copyPixel( int x,int y,BBCanvas *src,int src_x,int src_y );
+	void copyPixelFast( int x,int y,BBCanvas *src,int src_x,int src_y );
+	unsigned getPixel( int x,int y );
+	unsigned getPixelFast( int x,int y );
+	void unlock();
+
+	void setCubeMode( int mode );
+	void setCubeFace( int face );
+
+	//ACCESSORS
+	int getWidth()const;
+	int getHeight()const;
+	int getDepth()const;
+	int cubeMode()const;
+	void getOrigin( int *x,int *y )const;
+	void getScale( float *x,float *y )const;
+	void getHandle( int *x,int *y )const;
+	void getViewport( int *x,int *y,int *w,int *h )const;
+	unsigned getMask()const;
+	unsigned getColor()const;
+	unsigned getClsColor()const;
+};
+
+#endif
@@ -2,13 +2,65 @@
 #include "std.h"
 #include "animation.h"
 
+//Keys are kept sorted by frame in contiguous arrays, with the frames apart from
+//the values so a lookup only touches the ints it searches and the two keys it blends.
+template<class T>
+struct AnimTrack{
+	std::vector<int> times;
+	std::vector<T> values;
+	//index of the key last interpolated from; animations are mostly played forwards
+	mutable int cursor;
+
+	AnimTrack():cursor(0){
+	}
+
+	int size()const{
+		return times.size();
+	}
+
+	//index of the first key after frame, as map::upper_bound
+	int next( int frame )const{
+		int n=times.size();
+		int c=cursor;
+		if( c<n && times[c]<=frame ){
+			if( c+1==n || frame<times[c+1] ) return c+1;
+			if( c+2==n || frame<times[c+2] ){ cursor=c+1;return c+2; }
+		}
+		int k=std::upper_bound( times.begin(),times.end(),frame )-times.begin();
+		if( k ) cursor=k-1;
+		return k;
+	}
+
+	void setKey( int time,const T &value ){
+		if( !times.size() || time>times.back() ){
+			times.push_back( time );
+			values.push_back( value );
+			return;
+		}
+		int k=std::lower_bound( times.begin(),times.end(),time )-times.begin();
+		if( times[k]!=time ){
+			times.insert( times.begin()+k,time );
+			values.insert( values.begin()+k,value );
+			return;
+		}
+		values[k]=value;
+	}
+
+	void copyRange( const AnimTrack &t,int first,int last ){
+		int k=std::lower_bound( t.times.begin(),t.times.end(),first )-t.times.begin();
+		for( ;k<t.size() && t.times[k]<=last;++k ){
+			times.push_back( t.times[k]-first );
+			values.push_back( t.values[k] );
+		}
+	}
+};
+
 struct Animation::Rep{
 
 	int ref_cnt;
 
-	typedef std::map<int,Quat> KeyList;
-
-	KeyList scale_anim,rot_anim,pos_anim;
+	AnimTrack<Vector> scale_anim,pos_anim;
+	AnimTrack<Quat> rot_anim;
 
 	Rep():
 	ref_cnt(1){
@@ -16,39 +68,29 @@ struct Animation::Rep{
 
 	Rep( const Rep &t ):
 	ref_cnt(1),
-	scale_anim(t.scale_anim),rot_anim(t.rot_anim),pos_anim(t.pos_anim){
+	scale_anim(t.scale_anim),pos_anim(t.pos_anim),rot_anim(t.rot_anim){
 	}
 
-	Vector getLinearValue( const KeyList &keys,float time )const{
-		KeyList::const_iterator next,curr;
-
-		//for( next=keys.begin();next!=keys.end() && time>=next->first;++next ){}
-		next=keys.upper_bound( (int)time );
+	Vector getLinearValue( const AnimTrack<Vector> &keys,float time )const{
+		int next=keys.next( (int)time );
 
-		if( next==keys.begin() ) return next->second.v;
-		curr=next;--curr;
-		if( next==keys.end() ) return curr->second.v;
+		if( next==0 ) return keys.values[0];
+		int curr=next-1;
+		if( next==keys.size() ) return keys.values[curr];
 
-		float delta=( time-curr->first )/( next->first-curr->first );
-		return ( next->second.v-curr->second.v )*delta+curr->second.v;
+		float delta=( time-keys.times[curr] )/( keys.times[next]-keys.times[curr] );
+		return ( keys.values[next]-keys.values[curr] )*delta+keys.values[curr];
 	}
 
-	Quat getSlerpValue( const KeyList &keys,float time )const{
-		KeyList::const_iterator next,curr;
+	Quat getSlerpValue( const AnimTrack<Quat> &keys,float time )const{
+		int next=keys.next( (int)time );
 
-		//for( next=keys.begin();next!=keys.end() && time>=next->first;++next ){}
-		next=keys.upper_bound( (int)time );
+		if( next==0 ) return keys.values[0];
+		int curr=next-1;
+		if( next==keys.size() ) return keys.values[curr];
 
-		if( next==keys.begin() ) return next->second;
-		curr=next;--curr;
-		if( next==keys.end() ) return curr->second;
-
-		float delta=( time-curr->first )/( next->first-curr->first );
-		return curr->second.slerpTo( next->second,delta );
-	}
-
-	void setKey( KeyList &keys,int time,const Quat &value ){
-		keys[time]=value;
+		float delta=( time-keys.times[curr] )/( keys.times[next]-keys.times[curr] );
+		return keys.values[curr].slerpTo( keys.values[next],delta );
 	}
 };
 
@@ -63,19 +105,9 @@ rep( t.rep ){
 
 Animation::Animation( const Animation &t,int first,int last ):
 rep( new Rep() ){
-	Rep::KeyList::const_iterator it;
-	for( it=t.rep->pos_anim.begin();it!=t.rep->pos_anim.end();++it ){
-		if( it->first<first || it->first>last ) continue;
-		rep->setKey( rep->pos_anim,it->first-first,it->second );
-	}
-	for( it=t.rep->scale_anim.begin();it!=t.rep->scale_anim.end();++it ){
-		if( it->first<first || it->first>last ) continue;
-		rep->setKey( rep->scale_anim,it->first-first,it->second );
-	}
-	for( it=t.rep->rot_anim.begin();it!=t.rep->rot_anim.end();++it ){
-		if( it->first<first || it->first>last ) continue;
-		rep->setKey( rep->rot_anim,it->first-first,it->second );
-	}
+	rep->pos_anim.copyRange( t.rep->pos_anim,first,last );
+	rep->scale_anim.copyRange( t.rep->scale_anim,first,last );
+	rep->rot_anim.copyRange( t.rep->rot_anim,first,last );
 }
 
 Animation::~Animation(){
@@ -99,17 +131,17 @@ Animation::Rep *Animation::write(){
 
 void Animation::setScaleKey( int time,const Vector &q ){
 	write();
-	rep->setKey( rep->scale_anim,time,Quat( 0,q ) );
+	rep->scale_anim.setKey( time,q );
 }
 
 void Animation::setPositionKey( int time,const Vector &q ){
 	write();
-	rep->setKey( rep->pos_anim,time,Quat( 0,q ) );
+	rep->pos_anim.setKey( time,q );
 }
 
 void Animation::setRotationKey( int time,const Quat &q ){
 	write();
-	rep->setKey( rep->rot_anim,time,q );
+	rep->rot_anim.setKey( time,q );
 }
 
 int Animation::numScaleKeys()const{
@@ -2,7 +2,7 @@
 #ifndef ANIMATION_H
 #define ANIMATION_H
 
-#include <list>
+#include <vector>
 
 #include "geom.h"
 
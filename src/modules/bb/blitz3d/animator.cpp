@@ -2,6 +2,7 @@
 #include "std.h"
 #include "animator.h"
 #include "object.h"
+#include <bb/profile/profile.h>
 
 Animator::Animator( Animator *t ):_seqs( t->_seqs ){
 
@@ -181,6 +182,8 @@ void Animator::update( float elapsed ){
 
 	if( !_mode ) return;
 
+	BB_PROFILE( "Animator::update" );
+
 	if( _mode&0x8000 ){
 		_trans_time+=_trans_speed*elapsed;
 		if( _trans_time<1 ){
@@ -14,6 +14,7 @@
 #include "loader_assimp.h"
 #include "std.h"
 #include "graphics.h"
+#include "skinning.h"
 
 B3DGraphics *bbSceneDriver;
 BBScene *bbScene;
@@ -302,6 +303,18 @@ BBLIB void BBCALL bbCollisions( bb_int_t src_type,bb_int_t dest_type,bb_int_t me
 	world->addCollision( src_type,dest_type,method,response );
 }
 
+//threads: 0 or 1 resolves collisions on the main thread only, -1 uses every core
+BBLIB void BBCALL bbCollisionThreads( bb_int_t threads ){
+	debug3d();
+	world->setThreads( threads );
+}
+
+//threads: 0 or 1 skins large CPU skinned meshes on the main thread only, -1 uses every core
+BBLIB void BBCALL bbSkinThreads( bb_int_t threads ){
+	debug3d();
+	SkinCache::setThreads( threads );
+}
+
 static int update_ms;
 
 BBLIB void BBCALL bbUpdateWorld( bb_float_t elapsed ){
@@ -2051,6 +2064,7 @@ void blitz3d_close(){
 	bbClearWorld( 1,1,1 );
 	Texture::clearFilters();
 	loader_mat_map.clear();
+	SkinCache::setThreads( 0 );
 	delete world;
 	bbScene=0;
 }
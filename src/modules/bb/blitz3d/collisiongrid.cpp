@@ -0,0 +1,305 @@
+
+#include "std.h"
+#include "collisiongrid.h"
+#include "meshmodel.h"
+#include "world.h"
+
+//below this many objects all of them are tested, just as with no broad phase
+static const int GRID_MIN=16;
+static const int GRID_MAX_DIM=256;
+//objects spanning more cells than this are kept on a separate, always tested list
+static const int GRID_MAX_SPAN=4;
+
+static bool finiteBox( const Box &b ){
+	return
+	std::isfinite( b.a.x ) && std::isfinite( b.a.z ) &&
+	std::isfinite( b.b.x ) && std::isfinite( b.b.z ) && !b.empty();
+}
+
+CollisionGrid::CollisionGrid():
+objs(0),methods(0),org_x(0),org_z(0),inv_cx(0),inv_cz(0),nx(0),nz(0),max_sphere_r(0),max_box_r(0){
+}
+
+void CollisionGrid::clear(){
+	objs=0;
+	entries.clear();
+	large.clear();
+	for( unsigned int k=0;k<cells.size();++k ) cells[k].clear();
+	nx=nz=0;
+	max_sphere_r=max_box_r=0;
+}
+
+void CollisionGrid::build( const std::vector<Object*> &o,int m ){
+	clear();
+
+	objs=&o;
+	methods=m;
+
+	int n=o.size();
+	entries.resize( n );
+
+	Box region;
+	float size=0;
+	int cnt=0;
+	for( int k=0;k<n;++k ){
+		bound( k );
+		const Box &xz=entries[k].xz;
+		if( !finiteBox( xz ) ) continue;
+		region.update( xz );
+		size+=std::max( xz.width(),xz.depth() );
+		++cnt;
+	}
+
+	if( n>=GRID_MIN && cnt ){
+		//aim for cells about the size of an average object...
+		float cell=size/cnt;
+		float w=region.width(),d=region.depth();
+		nx=cell>0 ? (int)std::min( ceilf( w/cell ),(float)GRID_MAX_DIM ) : GRID_MAX_DIM;
+		nz=cell>0 ? (int)std::min( ceilf( d/cell ),(float)GRID_MAX_DIM ) : GRID_MAX_DIM;
+		if( nx<1 ) nx=1;
+		if( nz<1 ) nz=1;
+
+		//...but don't allocate many more cells than there are objects
+		float limit=n*4;
+		if( nx*nz>limit ){
+			float f=sqrtf( limit/(nx*nz) );
+			nx=std::max( (int)(nx*f),1 );
+			nz=std::max( (int)(nz*f),1 );
+		}
+
+		org_x=region.a.x;
+		org_z=region.a.z;
+		inv_cx=w>0 ? nx/w : 0;
+		inv_cz=d>0 ? nz/d : 0;
+
+		if( (int)cells.size()<nx*nz ) cells.resize( nx*nz );
+	}
+
+	for( int k=0;k<n;++k ){
+		insert( k );
+	}
+}
+
+void CollisionGrid::update( int index ){
+	remove( index );
+	bound( index );
+	insert( index );
+}
+
+//back.d is a unit vector pointing behind the origin, if there's a move at all
+static Line backLine( const Line &line,int method ){
+	Line back( line.o,Vector() );
+	if( method==World::COLLISION_METHOD_SPHERE || method==World::COLLISION_METHOD_BOX ){
+		float len=line.d.length();
+		if( len>0 ) back.d=line.d*(-1/len);
+	}
+	return back;
+}
+
+Box CollisionGrid::reach( const Line &line,int method,float radius )const{
+	Box box( line );
+	box.expand( radius+COLLISION_EPSILON );
+	if( method==World::COLLISION_METHOD_SPHERE || method==World::COLLISION_METHOD_BOX ){
+		float r=(method==World::COLLISION_METHOD_SPHERE ? max_sphere_r : max_box_r)+radius;
+		Box t( backLine( line,method )*(r+COLLISION_EPSILON) );
+		t.expand( radius+COLLISION_EPSILON );
+		box.update( t );
+	}
+	return box;
+}
+
+void CollisionGrid::query( const Line &line,float y_scale,int method,float radius,std::vector<int> &out )const{
+
+	out.clear();
+
+	int n=entries.size();
+	if( !n ) return;
+
+	//swept sphere, padded for rounding in the narrow phase
+	Box box( line );
+	box.expand( radius+COLLISION_EPSILON );
+
+	Line back=backLine( line,method );
+
+	if( nx ){
+		//cells are walked for the furthest any candidate reaches back
+		Box walk=reach( line,method,radius );
+
+		int x0=cellX( walk.a.x ),x1=cellX( walk.b.x );
+		int z0=cellZ( walk.a.z ),z1=cellZ( walk.b.z );
+
+		if( (x1-x0+1)*(z1-z0+1)<n ){
+			for( int z=z0;z<=z1;++z ){
+				for( int x=x0;x<=x1;++x ){
+					const std::vector<int> &cell=cells[z*nx+x];
+					for( unsigned int k=0;k<cell.size();++k ){
+						if( overlaps( entries[cell[k]],box,back,y_scale,method,radius ) ) out.push_back( cell[k] );
+					}
+				}
+			}
+			for( unsigned int k=0;k<large.size();++k ){
+				if( overlaps( entries[large[k]],box,back,y_scale,method,radius ) ) out.push_back( large[k] );
+			}
+			//World::collide keeps the last of equally near hits, so order matters
+			std::sort( out.begin(),out.end() );
+			out.erase( std::unique( out.begin(),out.end() ),out.end() );
+			return;
+		}
+	}
+
+	for( int k=0;k<n;++k ){
+		const Entry &e=entries[k];
+		if( e.bin!=BIN_NONE && ( !nx || overlaps( e,box,back,y_scale,method,radius ) ) ) out.push_back( k );
+	}
+}
+
+void CollisionGrid::bound( int index ){
+	Object *obj=(*objs)[index];
+	Entry &e=entries[index];
+
+	const Transform &tf=obj->getPrevWorldTform();
+
+	e.centre=tf.v;
+	e.sphere_r=fabs( obj->getCollisionRadii().x );
+
+	//World::hitTest normalizes the box axes, so a local point moves at most its L1 length
+	const Box &b=obj->getCollisionBox();
+	e.box_r=0;
+	for( int k=0;k<8;++k ){
+		const Vector &c=b.corner( k );
+		float r=fabs( c.x )+fabs( c.y )+fabs( c.z );
+		if( r>e.box_r ) e.box_r=r;
+	}
+
+	//only ever grows between builds, which keeps it an upper bound
+	if( e.sphere_r>max_sphere_r ) max_sphere_r=e.sphere_r;
+	if( e.box_r>max_box_r ) max_box_r=e.box_r;
+
+	//only these models implement Object::collide
+	e.poly_mode=POLY_NONE;
+	if( Model *model=obj->getModel() ){
+		if( MeshModel *mesh=model->getMeshModel() ){
+			const Box &mb=mesh->getBox();
+			if( !mb.empty() ){
+				e.poly=tf * mb;
+				e.poly_mode=POLY_BOUNDED;
+			}
+		}else if( model->getTerrain() || model->getPlaneModel() || model->getBSPModel() ){
+			e.poly_mode=POLY_UNBOUNDED;
+		}
+	}
+
+	Box &xz=e.xz;
+	xz.clear();
+	if( methods & (1<<World::COLLISION_METHOD_SPHERE) ){
+		Box t( e.centre );
+		t.expand( e.sphere_r );
+		xz.update( t );
+	}
+	if( methods & (1<<World::COLLISION_METHOD_BOX) ){
+		Box t( e.centre );
+		t.expand( e.box_r );
+		xz.update( t );
+	}
+	if( methods & (1<<World::COLLISION_METHOD_POLYGON) ){
+		if( e.poly_mode==POLY_BOUNDED ){
+			xz.update( e.poly );
+		}else if( e.poly_mode==POLY_UNBOUNDED ){
+			xz=Box( Vector( -INFINITY,-INFINITY,-INFINITY ),Vector( INFINITY,INFINITY,INFINITY ) );
+		}
+	}
+}
+
+void CollisionGrid::insert( int index ){
+	Entry &e=entries[index];
+	const Box &xz=e.xz;
+
+	if( xz.empty() ){
+		e.bin=BIN_NONE;
+		return;
+	}
+
+	e.bin=BIN_LARGE;
+	if( !nx ) return;
+
+	e.x0=cellX( xz.a.x );e.x1=cellX( xz.b.x );
+	e.z0=cellZ( xz.a.z );e.z1=cellZ( xz.b.z );
+
+	if( e.x1-e.x0>=GRID_MAX_SPAN || e.z1-e.z0>=GRID_MAX_SPAN ){
+		large.push_back( index );
+		return;
+	}
+
+	e.bin=BIN_CELLS;
+	for( int z=e.z0;z<=e.z1;++z ){
+		for( int x=e.x0;x<=e.x1;++x ){
+			cells[z*nx+x].push_back( index );
+		}
+	}
+}
+
+void CollisionGrid::remove( int index ){
+	Entry &e=entries[index];
+
+	if( e.bin==BIN_CELLS ){
+		for( int z=e.z0;z<=e.z1;++z ){
+			for( int x=e.x0;x<=e.x1;++x ){
+				std::vector<int> &cell=cells[z*nx+x];
+				cell.erase( std::find( cell.begin(),cell.end(),index ) );
+			}
+		}
+	}else if( e.bin==BIN_LARGE && nx ){
+		large.erase( std::find( large.begin(),large.end(),index ) );
+	}
+	e.bin=BIN_NONE;
+}
+
+int CollisionGrid::cellX( float x )const{
+	float t=(x-org_x)*inv_cx;
+	if( !(t>0) ) return 0;
+	return t<nx ? (int)t : nx-1;
+}
+
+int CollisionGrid::cellZ( float z )const{
+	float t=(z-org_z)*inv_cz;
+	if( !(t>0) ) return 0;
+	return t<nz ? (int)t : nz-1;
+}
+
+bool CollisionGrid::overlaps( const Entry &e,const Box &box,const Line &back,float y_scale,int method,float radius )const{
+	float r,reach;
+	switch( method ){
+	case World::COLLISION_METHOD_SPHERE:
+		r=e.sphere_r;
+		reach=e.sphere_r+radius;
+		break;
+	case World::COLLISION_METHOD_BOX:
+		//the normalized axes needn't be orthogonal, so the source sphere may stretch
+		r=e.box_r+radius;
+		reach=r;
+		break;
+	case World::COLLISION_METHOD_POLYGON:
+		if( e.poly_mode!=POLY_BOUNDED ) return e.poly_mode==POLY_UNBOUNDED;
+		{
+			float ay=e.poly.a.y*y_scale,by=e.poly.b.y*y_scale;
+			if( ay>by ) std::swap( ay,by );
+			return
+			box.a.x<=e.poly.b.x && box.b.x>=e.poly.a.x &&
+			box.a.y<=by && box.b.y>=ay &&
+			box.a.z<=e.poly.b.z && box.b.z>=e.poly.a.z;
+		}
+	default:
+		return false;
+	}
+	//a grazing contact may be reported behind the origin, as far back as the
+	//candidate's own reach
+	Box b( back*(reach+COLLISION_EPSILON) );
+	b.expand( radius+COLLISION_EPSILON );
+	b.update( box );
+
+	float cy=e.centre.y*y_scale;
+	return
+	b.a.x<=e.centre.x+r && b.b.x>=e.centre.x-r &&
+	b.a.y<=cy+r && b.b.y>=cy-r &&
+	b.a.z<=e.centre.z+r && b.b.z>=e.centre.z-r;
+}
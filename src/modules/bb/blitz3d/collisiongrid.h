@@ -0,0 +1,69 @@
+
+#ifndef COLLISIONGRID_H
+#define COLLISIONGRID_H
+
+#include "object.h"
+
+//Broad phase for World::collide.
+//
+//Bins the collidable objects of one collision type on a uniform XZ grid, built
+//from their previous world transforms. A query with the swept box of a
+//collision line returns, in their original order, only the objects whose
+//bounds for the requested collision method overlap it.
+class CollisionGrid{
+public:
+	CollisionGrid();
+
+	//methods: bitmask of (1<<World::COLLISION_METHOD_*) used against these objects
+	void build( const std::vector<Object*> &objs,int methods );
+	void clear();
+
+	//objs[index]'s previous world transform has changed
+	void update( int index );
+
+	//line: the collision line in y-scaled collision space, swept by radius.
+	//Sphere and box tests also accept grazing contacts a little behind the
+	//line's origin, so those candidates are kept out to their own bound behind it.
+	//safe to call from several threads as long as nothing is being updated
+	void query( const Line &line,float y_scale,int method,float radius,std::vector<int> &out )const;
+
+	//the region query() may take candidates from, for the same arguments
+	Box reach( const Line &line,int method,float radius )const;
+
+	//XZ extent of objs[index] as binned
+	const Box &bounds( int index )const{ return entries[index].xz; }
+
+private:
+	enum{
+		BIN_NONE=0,BIN_CELLS,BIN_LARGE
+	};
+	enum{
+		POLY_NONE=0,POLY_BOUNDED,POLY_UNBOUNDED
+	};
+
+	struct Entry{
+		Vector centre;
+		float sphere_r,box_r;
+		Box poly,xz;
+		int poly_mode;
+		int bin,x0,z0,x1,z1;
+	};
+
+	const std::vector<Object*> *objs;
+	int methods;
+	std::vector<Entry> entries;
+	std::vector<int> large;
+	std::vector<std::vector<int> > cells;
+	float org_x,org_z,inv_cx,inv_cz;
+	int nx,nz;
+	float max_sphere_r,max_box_r;
+
+	void bound( int index );
+	void insert( int index );
+	void remove( int index );
+	int cellX( float x )const;
+	int cellZ( float z )const;
+	bool overlaps( const Entry &e,const Box &box,const Line &back,float y_scale,int method,float radius )const;
+};
+
+#endif
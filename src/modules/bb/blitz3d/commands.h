@@ -21,6 +21,8 @@ void BBCALL bbWireFrame( bb_int_t enable );
 void BBCALL bbAmbientLight( bb_float_t red,bb_float_t green,bb_float_t blue );
 void BBCALL bbClearCollisions(  );
 void BBCALL bbCollisions( bb_int_t source_type,bb_int_t destination_type,bb_int_t method,bb_int_t response );
+void BBCALL bbCollisionThreads( bb_int_t threads );
+void BBCALL bbSkinThreads( bb_int_t threads );
 void BBCALL bbUpdateWorld( bb_float_t elapsed_time );
 void BBCALL bbCaptureWorld(  );
 void BBCALL bbRenderWorld( bb_float_t tween );
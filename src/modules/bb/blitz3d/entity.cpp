@@ -3,6 +3,9 @@
 #include "entity.h"
 
 Entity *Entity::_orphans,*Entity::_last_orphan;
+int Entity::_tree_changes;
+
+static std::vector<Object*> enabled_objs,visible_objs;
 
 enum{
 	INVALID_LOCALTFORM=1,
@@ -10,6 +13,8 @@ enum{
 };
 
 void Entity::remove(){
+	unlistObjects( &Entity::_enabled,enabled_objs );
+	unlistObjects( &Entity::_visible,visible_objs );
 	if( _parent ){
 		if( _parent->_children==this ) _parent->_children=_succ;
 		if( _parent->_last_child==this ) _parent->_last_child=_pred;
@@ -19,6 +24,7 @@ void Entity::remove(){
 	}
 	if( _succ ) _succ->_pred=_pred;
 	if( _pred ) _pred->_succ=_succ;
+	treeChanged();
 }
 
 void Entity::insert(){
@@ -32,6 +38,9 @@ void Entity::insert(){
 		else _orphans=this;
 		_last_orphan=this;
 	}
+	listObjects( &Entity::_enabled,enabled_objs );
+	listObjects( &Entity::_visible,visible_objs );
+	treeChanged();
 }
 
 Entity::Entity():
@@ -60,6 +69,7 @@ Entity::~Entity(){
 void Entity::invalidateWorld(){
 	if( invalid & INVALID_WORLDTFORM ) return;
 	invalid|=INVALID_WORLDTFORM;
+	worldChanged();
 	for( Entity *e=_children;e;e=e->_succ ){
 		e->invalidateWorld();
 	}
@@ -107,29 +117,107 @@ void Entity::setName( const std::string &t ){
 }
 
 void Entity::setVisible( bool visible ){
+	if( _visible==visible ) return;
+	if( !visible ) unlistObjects( &Entity::_visible,visible_objs );
 	_visible=visible;
+	if( visible ) listObjects( &Entity::_visible,visible_objs );
 }
 
 void Entity::setEnabled( bool enabled ){
+	if( _enabled==enabled ) return;
+	if( !enabled ) unlistObjects( &Entity::_enabled,enabled_objs );
 	_enabled=enabled;
+	if( enabled ) listObjects( &Entity::_enabled,enabled_objs );
+	treeChanged();
+}
+
+const std::vector<Object*> &Entity::enabledObjects(){
+	return enabled_objs;
+}
+
+const std::vector<Object*> &Entity::visibleObjects(){
+	return visible_objs;
 }
 
 void Entity::enumVisible( std::vector<Object*> &out ){
-	if( !_visible ) return;
-	if( Object *o=getObject() ) out.push_back(o);
-	for( Entity *e=_children;e;e=e->_succ ){
-		e->enumVisible( out );
-	}
+	enumObjects( &Entity::_visible,out );
 }
 
 void Entity::enumEnabled( std::vector<Object*> &out ){
-	if( !_enabled ) return;
+	enumObjects( &Entity::_enabled,out );
+}
+
+void Entity::enumObjects( bool Entity::*flag,std::vector<Object*> &out ){
+	if( !(this->*flag) ) return;
 	if( Object *o=getObject() ) out.push_back(o);
 	for( Entity *e=_children;e;e=e->_succ ){
-		e->enumEnabled( out );
+		e->enumObjects( flag,out );
 	}
 }
 
+//true if the walk for flag reaches this entity
+bool Entity::listed( bool Entity::*flag )const{
+	for( const Entity *e=this;e;e=e->_parent ){
+		if( !(e->*flag) ) return false;
+	}
+	return true;
+}
+
+//the last object the walk reaches in this subtree
+Object *Entity::lastObject( bool Entity::*flag ){
+	if( !(this->*flag) ) return 0;
+	for( Entity *e=_last_child;e;e=e->_pred ){
+		if( Object *o=e->lastObject( flag ) ) return o;
+	}
+	return getObject();
+}
+
+//the last object the walk reaches before this subtree
+Object *Entity::prevObject( bool Entity::*flag ){
+	for( Entity *e=this;e;e=e->_parent ){
+		for( Entity *t=e->_pred;t;t=t->_pred ){
+			if( Object *o=t->lastObject( flag ) ) return o;
+		}
+		if( e->_parent ){
+			if( Object *o=e->_parent->getObject() ) return o;
+		}
+	}
+	return 0;
+}
+
+//the walk visits a subtree's objects one after another, so it can be spliced
+//into or out of a list in one piece, after the object the walk visits before it
+void Entity::listObjects( bool Entity::*flag,std::vector<Object*> &objs ){
+	if( !listed( flag ) ) return;
+	std::vector<Object*> sub;
+	enumObjects( flag,sub );
+	if( !sub.size() ) return;
+	std::vector<Object*>::iterator it=objs.begin();
+	if( Object *prev=prevObject( flag ) ) it=std::find( objs.begin(),objs.end(),prev )+1;
+	objs.insert( it,sub.begin(),sub.end() );
+}
+
+void Entity::unlistObjects( bool Entity::*flag,std::vector<Object*> &objs ){
+	if( !listed( flag ) ) return;
+	std::vector<Object*> sub;
+	enumObjects( flag,sub );
+	if( !sub.size() ) return;
+	std::vector<Object*>::iterator it=std::find( objs.begin(),objs.end(),sub[0] );
+	objs.erase( it,it+sub.size() );
+}
+
+void Entity::listObject(){
+	listObjects( &Entity::_enabled,enabled_objs );
+	listObjects( &Entity::_visible,visible_objs );
+}
+
+//children keep their own places; they unlist themselves as they're destroyed
+void Entity::unlistObject(){
+	Object *o=getObject();
+	if( listed( &Entity::_enabled ) ) enabled_objs.erase( std::find( enabled_objs.begin(),enabled_objs.end(),o ) );
+	if( listed( &Entity::_visible ) ) visible_objs.erase( std::find( visible_objs.begin(),visible_objs.end(),o ) );
+}
+
 void Entity::setLocalPosition( const Vector &v ){
 	local_pos=v;
 	invalidateLocal();
@@ -74,10 +74,30 @@ public:
 
 	static Entity *orphans(){ return _orphans; }
 
+	//every enabled/visible object, in the order enumEnabled/enumVisible visit them;
+	//kept up to date as entities are created, destroyed, reparented and toggled
+	static const std::vector<Object*> &enabledObjects();
+	static const std::vector<Object*> &visibleObjects();
+
+	//bumped whenever an entity is created, destroyed, reparented, enabled or disabled
+	static int treeChanges(){ return _tree_changes; }
+
+protected:
+	static void treeChanged(){ ++_tree_changes; }
+
+	//adds/removes this entity's own object to/from the lists; called by Object,
+	//since getObject() can't see it from Entity's constructor and destructor
+	void listObject();
+	void unlistObject();
+
+	//the world transform is about to be recalculated
+	virtual void worldChanged(){}
+
 private:
 	Entity *_succ,*_pred,*_parent,*_children,*_last_child;
 
 	static Entity *_orphans,*_last_orphan;
+	static int _tree_changes;
 
 	bool _visible,_enabled;
 
@@ -95,6 +115,13 @@ private:
 
 	void insert();
 	void remove();
+
+	bool listed( bool Entity::*flag )const;
+	void enumObjects( bool Entity::*flag,std::vector<Object*> &out );
+	Object *lastObject( bool Entity::*flag );
+	Object *prevObject( bool Entity::*flag );
+	void listObjects( bool Entity::*flag,std::vector<Object*> &objs );
+	void unlistObjects( bool Entity::*flag,std::vector<Object*> &objs );
 	void invalidateLocal();
 	void invalidateWorld();
 };
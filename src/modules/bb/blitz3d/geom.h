@@ -256,9 +256,6 @@ struct Quat{
 };
 
 class Matrix{
-	static Matrix tmps[64];
-	static Matrix &alloc_tmp(){ static int tmp=0;return tmps[tmp++&63];	}
-	friend class Transform;
 public:
 	Vector i,j,k;
 
@@ -288,8 +285,8 @@ public:
 	const Vector &operator[]( int n )const{
 		return (&i)[n];
 	}
-	Matrix &operator~()const{
-		Matrix &m=alloc_tmp();
+	Matrix operator~()const{
+		Matrix m;
 		m.i.x=i.x;m.i.y=j.x;m.i.z=k.x;
 		m.j.x=i.y;m.j.y=j.y;m.j.z=k.y;
 		m.k.x=i.z;m.k.y=j.z;m.k.z=k.z;
@@ -298,16 +295,16 @@ public:
 	float determinant()const{
 		return i.x*(j.y*k.z-j.z*k.y )-i.y*(j.x*k.z-j.z*k.x )+i.z*(j.x*k.y-j.y*k.x );
 	}
-	Matrix &operator-()const{
-		Matrix &m=alloc_tmp();
+	Matrix operator-()const{
+		Matrix m;
 		float t=1.0f/determinant();
 		m.i.x= t*(j.y*k.z-j.z*k.y);m.i.y=-t*(i.y*k.z-i.z*k.y);m.i.z= t*(i.y*j.z-i.z*j.y);
 		m.j.x=-t*(j.x*k.z-j.z*k.x);m.j.y= t*(i.x*k.z-i.z*k.x);m.j.z=-t*(i.x*j.z-i.z*j.x);
 		m.k.x= t*(j.x*k.y-j.y*k.x);m.k.y=-t*(i.x*k.y-i.y*k.x);m.k.z= t*(i.x*j.y-i.y*j.x);
 		return m;
 	}
-	Matrix &cofactor()const{
-		Matrix &m=alloc_tmp();
+	Matrix cofactor()const{
+		Matrix m;
 		m.i.x= (j.y*k.z-j.z*k.y);m.i.y=-(j.x*k.z-j.z*k.x);m.i.z= (j.x*k.y-j.y*k.x);
 		m.j.x=-(i.y*k.z-i.z*k.y);m.j.y= (i.x*k.z-i.z*k.x);m.j.z=-(i.x*k.y-i.y*k.x);
 		m.k.x= (i.y*j.z-i.z*j.y);m.k.y=-(i.x*j.z-i.z*j.x);m.k.z= (i.x*j.y-i.y*j.x);
@@ -322,8 +319,8 @@ public:
 	Vector operator*( const Vector &q )const{
 		return Vector( i.x*q.x+j.x*q.y+k.x*q.z,i.y*q.x+j.y*q.y+k.y*q.z,i.z*q.x+j.z*q.y+k.z*q.z );
 	}
-	Matrix &operator*( const Matrix &q )const{
-		Matrix &m=alloc_tmp();
+	Matrix operator*( const Matrix &q )const{
+		Matrix m;
 		m.i.x=i.x*q.i.x+j.x*q.i.y+k.x*q.i.z;m.i.y=i.y*q.i.x+j.y*q.i.y+k.y*q.i.z;m.i.z=i.z*q.i.x+j.z*q.i.y+k.z*q.i.z;
 		m.j.x=i.x*q.j.x+j.x*q.j.y+k.x*q.j.z;m.j.y=i.y*q.j.x+j.y*q.j.y+k.y*q.j.z;m.j.z=i.z*q.j.x+j.z*q.j.y+k.z*q.j.z;
 		m.k.x=i.x*q.k.x+j.x*q.k.y+k.x*q.k.z;m.k.y=i.y*q.k.x+j.y*q.k.y+k.y*q.k.z;m.k.z=i.z*q.k.x+j.z*q.k.y+k.z*q.k.z;
@@ -335,8 +332,8 @@ public:
 		i=j.cross( k ).normalized();
 		j=k.cross( i );
 	}
-	Matrix &orthogonalized()const{
-		Matrix &m=alloc_tmp();
+	Matrix orthogonalized()const{
+		Matrix m;
 		m=*this;m.orthogonalize();
 		return m;
 	}
@@ -399,8 +396,6 @@ public:
 };
 
 class Transform{
-	static Transform tmps[64];
-	static Transform &alloc_tmp(){ static int tmp=0;return tmps[tmp++&63]; }
 public:
 	Matrix m;
 	Vector v;
@@ -413,13 +408,13 @@ public:
 	}
 	Transform( const Matrix &m,const Vector &v ):m(m),v(v){
 	}
-	Transform &operator-()const{
-		Transform &t=alloc_tmp();
+	Transform operator-()const{
+		Transform t;
 		t.m=-m;t.v=t.m*-v;
 		return t;
 	}
-	Transform &operator~()const{
-		Transform &t=alloc_tmp();
+	Transform operator~()const{
+		Transform t;
 		t.m=~m;t.v=t.m*-v;
 		return t;
 	}
@@ -435,8 +430,8 @@ public:
 		for( int k=1;k<8;++k ) t.update( *this*q.corner(k) );
 		return t;
 	}
-	Transform &operator*( const Transform &q )const{
-		Transform &t=alloc_tmp();
+	Transform operator*( const Transform &q )const{
+		Transform t;
 		t.m=m*q.m;t.v=m*q.v+v;
 		return t;
 	}
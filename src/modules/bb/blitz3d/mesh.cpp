@@ -1,5 +1,14 @@
 
+#include "std.h"
 #include "mesh.h"
+#include "surface.h"
 
 BBMesh::~BBMesh(){
 }
+
+void BBMesh::setVertices( int first,int cnt,const float *coords,const float *normals,const void *verts ){
+	const Surface::Vertex *v=(const Surface::Vertex*)verts;
+	for( int k=0;k<cnt;++k ){
+		setVertex( first+k,coords+k*3,normals+k*3,v[k].color,v[k].tex_coords );
+	}
+}
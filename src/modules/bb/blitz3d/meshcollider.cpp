@@ -2,11 +2,21 @@
 #include "std.h"
 #include "meshcollider.h"
 
-static const int MAX_COLL_TRIS=16;
-static std::vector<Vector> tri_centres;
+//leaves may hold fewer triangles when the SAH says so, but never more
+static const int MAX_COLL_TRIS=8;
+static const int SAH_BINS=12;
+//cost of visiting a node, relative to testing one triangle
+static const float SAH_TRAVERSAL=1;
+//past this depth nodes are split at the median, which bounds the tree depth...
+static const int MAX_SAH_DEPTH=40;
+//...so a traversal never needs more stack than this
+static const int MAX_COLL_DEPTH=80;
 
 extern float stats3d[10];
 
+//where tested triangles are counted; World points it elsewhere on worker threads
+thread_local float *tris_stat=&stats3d[0];
+
 static bool triTest( const Vector a[3],const Vector b[3] ){
 	bool pb0=false,pb1=false,pb2=false;
 	Plane p( a[0],a[1],a[2] ),p0,p1,p2;
@@ -30,168 +40,238 @@ static bool trisIntersect( const Vector a[3],const Vector b[3] ){
 	return triTest( a,b ) || triTest( b,a );
 }
 
+static int sahBin( float c,float lo,float scale ){
+	float f=(c-lo)*scale;
+	if( !(f>0) ) return 0;
+	return f<SAH_BINS ? (int)f : SAH_BINS-1;
+}
+
+static float boxArea( const Box &b ){
+	float w=b.width(),h=b.height(),d=b.depth();
+	return w*h+h*d+d*w;
+}
+
 MeshCollider::MeshCollider( const std::vector<Vertex> &verts,const std::vector<Triangle> &tris ):
 vertices(verts),triangles(tris){
-	std::vector<int> ts;
-	tri_centres.clear();
-	for( unsigned int k=0;k<triangles.size();++k ){
-		const MeshCollider::Triangle &t=triangles[k];
-		const Vector &v0=vertices[t.verts[0]].coords;
-		const Vector &v1=vertices[t.verts[1]].coords;
-		const Vector &v2=vertices[t.verts[2]].coords;
-		tri_centres.push_back( (v0+v1+v2)/3 );
-		ts.push_back( k );
-	}
-	tree=createNode( ts );
+	build();
 }
 
 MeshCollider::~MeshCollider(){
-	delete tree;
 }
 
-bool MeshCollider::collide( const Line &line,float radius,Collision *curr_coll,const Transform &t ){
-
-	if( !tree ) return false;
-
-	//create local box
-	Box box( line );
-	box.expand( radius );
-	Box local_box=-t * box;
-
-	return collide( local_box,line,radius,t,curr_coll,tree );
-}
+void MeshCollider::build(){
+	int n=triangles.size();
+	if( !n ) return;
 
-bool MeshCollider::collide( const Box &line_box,const Line &line,float radius,const Transform &tform,Collision *curr_coll,MeshCollider::Node *node ){
-	if( !line_box.overlaps( node->box ) ){
-		return false;
+	std::vector<Box> boxes( n );
+	std::vector<Vector> centres( n );
+	std::vector<int> order( n );
+	for( int k=0;k<n;++k ){
+		const Triangle &t=triangles[k];
+		const Vector &v0=vertices[t.verts[0]].coords;
+		const Vector &v1=vertices[t.verts[1]].coords;
+		const Vector &v2=vertices[t.verts[2]].coords;
+		boxes[k]=Box( v0 );
+		boxes[k].update( v1 );
+		boxes[k].update( v2 );
+		centres[k]=(v0+v1+v2)/3;
+		order[k]=k;
 	}
 
-	bool hit=false;
-	if( !node->triangles.size() ){
-		if( node->left ) hit|=collide( line_box,line,radius,tform,curr_coll,node->left );
-		if( node->right ) hit|=collide( line_box,line,radius,tform,curr_coll,node->right );
-		return hit;
-	}
+	//order[first,first+count) still to be turned into a subtree; the left
+	//child is always built next, the right one patches its parent
+	struct Task{
+		int first,count,parent,depth;
+	};
+	std::vector<Task> tasks;
+	tasks.push_back( Task{ 0,n,-1,0 } );
+
+	nodes.reserve( n/MAX_COLL_TRIS*4+1 );
 
-	stats3d[0]+=node->triangles.size();
+	while( tasks.size() ){
+		Task t=tasks.back();
+		tasks.pop_back();
 
-	for( unsigned int k=0;k<node->triangles.size();++k ){
+		int index=nodes.size();
+		if( t.parent>=0 ) nodes[t.parent].first=index;
 
-		const Triangle &tri=triangles[node->triangles[k]];
-		const Vector &t_v0=vertices[ tri.verts[0] ].coords;
-		const Vector &t_v1=vertices[ tri.verts[1] ].coords;
-		const Vector &t_v2=vertices[ tri.verts[2] ].coords;
+		Box box,cbox;
+		for( int k=t.first;k<t.first+t.count;++k ){
+			box.update( boxes[order[k]] );
+			cbox.update( centres[order[k]] );
+		}
+		nodes.push_back( Node() );
+		nodes[index].box=box;
+
+		//binned SAH over the triangle centres
+		int best_axis=-1,best_bin=0;
+		float best_cost=INFINITY;
+		if( t.count>1 && t.depth<MAX_SAH_DEPTH ){
+			for( int axis=0;axis<3;++axis ){
+				float lo=cbox.a[axis],ext=cbox.b[axis]-lo;
+				if( !(ext>0) ) continue;
+				float scale=SAH_BINS/ext;
+
+				Box bin_boxes[SAH_BINS];
+				int bin_cnts[SAH_BINS]={ 0 };
+				for( int k=t.first;k<t.first+t.count;++k ){
+					int b=sahBin( centres[order[k]][axis],lo,scale );
+					++bin_cnts[b];
+					bin_boxes[b].update( boxes[order[k]] );
+				}
 
-		//tri box
-		Box tri_box( t_v0 );
-		tri_box.update( t_v1 );
-		tri_box.update( t_v2 );
-		if( !tri_box.overlaps( line_box ) ) continue;
+				float right_area[SAH_BINS];
+				int right_cnt[SAH_BINS];
+				Box acc;
+				int cnt=0;
+				for( int b=SAH_BINS-1;b>0;--b ){
+					acc.update( bin_boxes[b] );
+					cnt+=bin_cnts[b];
+					right_area[b]=cnt ? boxArea( acc ) : 0;
+					right_cnt[b]=cnt;
+				}
 
-		if( !curr_coll->triangleCollide( line,radius,tform*t_v0,tform*t_v1,tform*t_v2 ) ) continue;
+				acc.clear();
+				cnt=0;
+				for( int b=1;b<SAH_BINS;++b ){
+					acc.update( bin_boxes[b-1] );
+					cnt+=bin_cnts[b-1];
+					if( !cnt || !right_cnt[b] ) continue;
+					float cost=cnt*boxArea( acc )+right_cnt[b]*right_area[b];
+					if( cost<best_cost ){
+						best_cost=cost;
+						best_axis=axis;
+						best_bin=b;
+					}
+				}
+			}
+		}
 
-		curr_coll->surface=tri.surface;
-		curr_coll->index=tri.index;
+		float area=boxArea( box );
+		int mid;
+		if( best_axis>=0 && ( t.count>MAX_COLL_TRIS || best_cost+area*SAH_TRAVERSAL<t.count*area ) ){
+			float lo=cbox.a[best_axis],scale=SAH_BINS/( cbox.b[best_axis]-lo );
+			int axis=best_axis,bin=best_bin;
+			mid=std::partition( order.begin()+t.first,order.begin()+t.first+t.count,[&]( int k ){
+				return sahBin( centres[k][axis],lo,scale )<bin;
+			} )-order.begin();
+		}else if( t.count>MAX_COLL_TRIS ){
+			//centres all coincide or the tree got too deep: halve along the longest axis
+			float w=cbox.width(),h=cbox.height(),d=cbox.depth();
+			int axis=w>=h && w>=d ? 0 : ( h>=d ? 1 : 2 );
+			mid=t.first+t.count/2;
+			std::nth_element( order.begin()+t.first,order.begin()+mid,order.begin()+t.first+t.count,[&]( int p,int q ){
+				return centres[p][axis]<centres[q][axis];
+			} );
+		}else{
+			nodes[index].first=t.first;
+			nodes[index].count=t.count;
+			continue;
+		}
 
-		hit=true;
+		nodes[index].count=0;
+		tasks.push_back( Task{ mid,t.first+t.count-mid,index,t.depth+1 } );
+		tasks.push_back( Task{ t.first,mid-t.first,-1,t.depth+1 } );
 	}
-	return hit;
+
+	std::vector<Triangle> sorted( n );
+	for( int k=0;k<n;++k ) sorted[k]=triangles[order[k]];
+	triangles.swap( sorted );
 }
 
-Box MeshCollider::nodeBox( const std::vector<int> &tris ){
-	Box box;
-	for( unsigned int k=0;k<tris.size();++k ){
-		const Triangle &t=triangles[ tris[k] ];
-		for( int j=0;j<3;++j ) box.update( vertices[t.verts[j]].coords );
+template<class F>
+bool MeshCollider::query( const Box &box,F f )const{
+	if( !nodes.size() ) return false;
+
+	int stack[MAX_COLL_DEPTH],sp=0;
+	int index=0;
+	for(;;){
+		const Node &node=nodes[index];
+		if( box.overlaps( node.box ) ){
+			if( !node.count ){
+				stack[sp++]=node.first;
+				++index;
+				continue;
+			}
+			if( f( node.first,node.count ) ) return true;
+		}
+		if( !sp ) return false;
+		index=stack[--sp];
 	}
-	return box;
 }
 
-MeshCollider::Node *MeshCollider::createLeaf( const std::vector<int> &tris ){
+bool MeshCollider::collide( const Line &line,float radius,Collision *curr_coll,const Transform &tform ){
 
-	Node *c=d_new Node;
-	c->box=nodeBox( tris );
-	c->triangles=tris;
-	leaves.push_back( c );
-	return c;
-}
+	if( !nodes.size() ) return false;
 
-MeshCollider::Node *MeshCollider::createNode( const std::vector<int> &tris ){
-
-	if( tris.size()<=MAX_COLL_TRIS ) return createLeaf( tris );
-
-	Node *c=d_new Node;
-	c->box=nodeBox( tris );
-
-	//find longest axis
-	//
-	float max=c->box.width();
-	if( c->box.height()>max ) max=c->box.height();
-	if( c->box.depth()>max ) max=c->box.depth();
-	int axis=0;
-	if( max==c->box.height() ) axis=1;
-	else if( max==c->box.depth() ) axis=2;
-
-	//sort by axis
-	//
-	unsigned int k;
-	std::multimap<float,int> axis_map;
-	for( k=0;k<tris.size();++k ){
-		std::pair<float,int> p( tri_centres[tris[k]][axis],tris[k] );
-		axis_map.insert( p );
-	}
+	//create local box
+	Box box( line );
+	box.expand( radius );
+	Box line_box=-tform * box;
 
-	//generate left node
-	//
-	std::vector<int> new_tris;
-	std::multimap<float,int>::iterator it=axis_map.begin();
-	for( k=axis_map.size()/2;k--;++it ){
-		new_tris.push_back( it->second );
-	}
-	c->left=createNode( new_tris );
+	bool hit=false;
+	query( line_box,[&]( int first,int count ){
+		*tris_stat+=count;
 
-	//generate right node
-	//
-	new_tris.clear();
-	for( ;it!=axis_map.end();++it ){
-		new_tris.push_back( it->second );
-	}
-	c->right=createNode( new_tris );
+		for( int k=first;k<first+count;++k ){
+
+			const Triangle &tri=triangles[k];
+			const Vector &t_v0=vertices[ tri.verts[0] ].coords;
+			const Vector &t_v1=vertices[ tri.verts[1] ].coords;
+			const Vector &t_v2=vertices[ tri.verts[2] ].coords;
+
+			//tri box
+			Box tri_box( t_v0 );
+			tri_box.update( t_v1 );
+			tri_box.update( t_v2 );
+			if( !tri_box.overlaps( line_box ) ) continue;
+
+			if( !curr_coll->triangleCollide( line,radius,tform*t_v0,tform*t_v1,tform*t_v2 ) ) continue;
+
+			curr_coll->surface=tri.surface;
+			curr_coll->index=tri.index;
 
-	return c;
+			hit=true;
+		}
+		return false;
+	} );
+	return hit;
 }
 
 bool MeshCollider::intersects( const MeshCollider &c,const Transform &t )const{
 
-	static Vector a[MAX_COLL_TRIS][3],b[3];
+	if( !nodes.size() || !c.nodes.size() ) return false;
+	if( !(t * nodes[0].box).overlaps( c.nodes[0].box ) ) return false;
+
+	Vector a[MAX_COLL_TRIS][3],b[3];
+
+	for( unsigned int k=0;k<nodes.size();++k ){
+		const Node &p=nodes[k];
+		if( !p.count ) continue;
 
-	if( !(t * tree->box).overlaps( c.tree->box ) ) return false;
-	for( unsigned int k=0;k<leaves.size();++k ){
-		Node *p=leaves[k];
-		Box box=t*p->box;
 		bool tformed=false;
-		for( unsigned int j=0;j<c.leaves.size();++j ){
-			Node *q=c.leaves[j];
-			if( !box.overlaps( q->box ) ) continue;
+		bool hit=c.query( t*p.box,[&]( int first,int count ){
 			if( !tformed ){
-				for( unsigned int n=0;n<p->triangles.size();++n ){
-					const Triangle &tri=triangles[p->triangles[n]];
+				for( int n=0;n<p.count;++n ){
+					const Triangle &tri=triangles[p.first+n];
 					a[n][0]=t * vertices[tri.verts[0]].coords;
 					a[n][1]=t * vertices[tri.verts[1]].coords;
 					a[n][2]=t * vertices[tri.verts[2]].coords;
 				}
 				tformed=true;
 			}
-			for( unsigned int n=0;n<q->triangles.size();++n ){
-				const Triangle &tri=c.triangles[q->triangles[n]];
+			for( int n=first;n<first+count;++n ){
+				const Triangle &tri=c.triangles[n];
 				b[0]=c.vertices[tri.verts[0]].coords;
 				b[1]=c.vertices[tri.verts[1]].coords;
 				b[2]=c.vertices[tri.verts[2]].coords;
-				for( unsigned int t=0;t<p->triangles.size();++t ){
-					if( trisIntersect( a[t],b ) ) return true;
+				for( int j=0;j<p.count;++j ){
+					if( trisIntersect( a[j],b ) ) return true;
 				}
 			}
-		}
+			return false;
+		} );
+		if( hit ) return true;
 	}
 	return false;
 }
@@ -22,24 +22,25 @@ public:
 	bool intersects( const MeshCollider &c,const Transform &t )const;
 
 private:
+	//sorted so every leaf's triangles are contiguous
 	std::vector<Vertex> vertices;
 	std::vector<Triangle> triangles;
 
-	struct Node{
+	//Flattened BVH in depth first order: an interior node's left child is the
+	//next node, its right child is nodes[first]. A leaf holds the triangles
+	//[first,first+count).
+	struct alignas(32) Node{
 		Box box;
-		Node *left,*right;
-		std::vector<int> triangles;
-		Node():left(0),right(0){}
-		~Node(){ delete left;delete right; }
+		int first,count;
 	};
 
-	Node *tree;
-	std::vector<Node*> leaves;
+	std::vector<Node> nodes;
 
-	Box nodeBox( const std::vector<int> &tris );
-	Node *createLeaf( const std::vector<int> &tris );
-	Node *createNode( const std::vector<int> &tris );
-	bool collide( const Box &box,const Line &line,float radius,const Transform &tform,Collision *curr_coll,Node *node );
+	void build();
+
+	//calls f( first,count ) for each leaf overlapping box until f returns true
+	template<class F>
+	bool query( const Box &box,F f )const;
 };
 
 #endif
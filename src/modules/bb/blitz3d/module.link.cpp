@@ -16,6 +16,8 @@ BBMODULE_LINK( blitz3d ){
 	rtSym( "AmbientLight#red#green#blue","bbAmbientLight",bbAmbientLight );
 	rtSym( "ClearCollisions","bbClearCollisions",bbClearCollisions );
 	rtSym( "Collisions%source_type%destination_type%method%response","bbCollisions",bbCollisions );
+	rtSym( "CollisionThreads%threads","bbCollisionThreads",bbCollisionThreads );
+	rtSym( "SkinThreads%threads","bbSkinThreads",bbSkinThreads );
 	rtSym( "UpdateWorld#elapsed_time=1","bbUpdateWorld",bbUpdateWorld );
 	rtSym( "CaptureWorld","bbCaptureWorld",bbCaptureWorld );
 	rtSym( "RenderWorld#tween=1","bbRenderWorld",bbRenderWorld );
@@ -1,23 +1,27 @@
 
 #include "std.h"
 #include "object.h"
+#include "pickindex.h"
 
 Object::Object():
-order(0),animator(0),last_copy(0),
+order(0),animator(0),last_copy(0),update_index(-1),pick_slot(-1),
 coll_type(0),coll_radii(Vector(1,1,1)),coll_box(Box(Vector(-1,-1,-1),Vector(1,1,1))),
 pick_geom(0),obscurer(false),captured(false){
 	reset();
+	listObject();
 }
 
 Object::Object( const Object &o ):
 Entity(o),
-order(o.order),animator(0),last_copy(0),
+order(o.order),animator(0),last_copy(0),update_index(-1),pick_slot(-1),
 coll_type(o.coll_type),coll_radii(o.coll_radii),coll_box(o.coll_box),
 pick_geom(o.pick_geom),obscurer(o.obscurer),captured(false){
 	reset();
+	listObject();
 }
 
 Object::~Object(){
+	unlistObject();
 	delete animator;
 	velocity=Vector();
 	updateSounds();
@@ -45,10 +49,22 @@ void Object::setCollisionType( int type ){
 
 void Object::setCollisionRadii( const Vector &radii ){
 	coll_radii=radii;
+	if( pick_slot>=0 ) PickIndex::moved( this );
 }
 
 void Object::setCollisionBox( const Box &box ){
 	coll_box=box;
+	if( pick_slot>=0 ) PickIndex::moved( this );
+}
+
+void Object::setPickGeometry( int n ){
+	if( pick_geom==n ) return;
+	pick_geom=n;
+	treeChanged();
+}
+
+void Object::worldChanged(){
+	if( pick_slot>=0 ) PickIndex::moved( this );
 }
 
 void Object::setAnimator( Animator *t ){
@@ -38,7 +38,7 @@ public:
 	void setCollisionRadii( const Vector &radii );
 	void setCollisionBox( const Box &box );
 	void setOrder( int n ){ order=n; }
-	void setPickGeometry( int n ){ pick_geom=n; }
+	void setPickGeometry( int n );
 	void setObscurer( bool t ){ obscurer=t; }
 	void setAnimation( const Animation &t ){ anim=t; }
 	void setAnimator( Animator *t );
@@ -56,6 +56,12 @@ public:
 	void beginUpdate( float elapsed );
 	void addCollision( const ObjCollision *c );
 	void endUpdate();
+	void setUpdateIndex( int n ){ update_index=n; }
+	int getUpdateIndex()const{ return update_index; }
+
+	//for use by PickIndex
+	void setPickSlot( int n ){ pick_slot=n; }
+	int getPickSlot()const{ return pick_slot; }
 
 	//accessors
 	int getCollisionType()const;
@@ -87,6 +93,8 @@ private:
 	Vector capt_pos,capt_scl;
 	Quat capt_rot;
 	mutable Object *last_copy;
+	int update_index;
+	int pick_slot;
 
 	Transform prev_tform;
 	Transform captured_tform,tween_tform;
@@ -97,6 +105,7 @@ private:
 	Animator *animator;
 
 	void updateSounds();
+	void worldChanged();
 };
 
 #endif
@@ -0,0 +1,298 @@
+
+#include "std.h"
+#include "pickindex.h"
+#include "meshmodel.h"
+#include "world.h"
+
+static const int PICK_LEAF=4;
+//bounds are padded by this much per unit of coordinate magnitude, so that
+//rounding in the exact tests can't put a hit outside them
+static const float PICK_EPSILON=1e-4f;
+//median splits keep the tree within this depth
+static const int MAX_PICK_DEPTH=64;
+
+//objects that reported a move since the last validate(); when there are more
+//than the index holds, every bound is refreshed instead
+static std::vector<Object*> pick_moved;
+static bool pick_moved_all;
+static unsigned int pick_moved_max;
+
+static bool pickable( Object *obj ){
+	switch( obj->getPickGeometry() ){
+	case World::COLLISION_METHOD_SPHERE:
+	case World::COLLISION_METHOD_BOX:
+		return true;
+	case World::COLLISION_METHOD_POLYGON:
+		//only these models implement Object::collide
+		if( Model *model=obj->getModel() ){
+			return model->getMeshModel() || model->getTerrain() || model->getPlaneModel() || model->getBSPModel();
+		}
+	}
+	return false;
+}
+
+//Collision::update accepts hits behind the line's origin as long as the origin
+//is within COLLISION_EPSILON of the hit plane, so the line is unbounded backwards
+static bool lineEnters( const Line &line,const Box &box,float grow,float time ){
+	float t0=-INFINITY,t1=time;
+	for( int k=0;k<3;++k ){
+		float o=line.o[k],d=line.d[k];
+		float lo=box.a[k]-grow,hi=box.b[k]+grow;
+		if( d==0 ){
+			if( o<lo || o>hi ) return false;
+			continue;
+		}
+		float inv=1/d;
+		float ta=(lo-o)*inv,tb=(hi-o)*inv;
+		if( ta>tb ) std::swap( ta,tb );
+		if( ta>t0 ) t0=ta;
+		if( tb<t1 ) t1=tb;
+		if( !(t0<=t1) ) return false;
+	}
+	return true;
+}
+
+PickIndex::PickIndex():
+tree_changes( Entity::treeChanges()-1 ),geom_epoch(0),refits(0){
+}
+
+PickIndex::~PickIndex(){
+	pick_moved.clear();
+	pick_moved_all=false;
+	pick_moved_max=0;
+}
+
+void PickIndex::moved( Object *obj ){
+	if( pick_moved_all ) return;
+	if( pick_moved.size()>=pick_moved_max ){
+		pick_moved.clear();
+		pick_moved_all=true;
+		return;
+	}
+	pick_moved.push_back( obj );
+}
+
+void PickIndex::validate(){
+	if( tree_changes!=Entity::treeChanges() ){
+		tree_changes=Entity::treeChanges();
+		geom_epoch=Surface::geomEpoch();
+		pick_moved.clear();
+		pick_moved_all=false;
+		enumerate();
+		build();
+		return;
+	}
+
+	bool all=pick_moved_all;
+	bool changed=all,rebuild=all;
+
+	if( all || geom_epoch!=Surface::geomEpoch() ){
+		for( unsigned int k=0;k<entries.size();++k ){
+			if( all || entries[k].obj->getPickGeometry()==World::COLLISION_METHOD_POLYGON ){
+				rebuild|=bound( k );
+				changed=true;
+			}
+		}
+		geom_epoch=Surface::geomEpoch();
+	}
+
+	if( !all ){
+		for( unsigned int k=0;k<pick_moved.size();++k ){
+			//no entity has been destroyed since the index was built, so this is safe
+			Object *obj=pick_moved[k];
+			int index=obj->getPickSlot();
+			if( index<0 || index>=(int)entries.size() || entries[index].obj!=obj ) continue;
+			rebuild|=bound( index );
+			++refits;
+			changed=true;
+		}
+	}
+	pick_moved.clear();
+	pick_moved_all=false;
+
+	if( !changed ) return;
+
+	//refitting loosens the tree; rebuild once it has been refit about as many times as it has objects
+	if( rebuild || refits>(int)entries.size() ) build();
+	else refit();
+}
+
+void PickIndex::enumerate(){
+	const std::vector<Object*> &enabled=Entity::enabledObjects();
+
+	entries.clear();
+	for( unsigned int k=0;k<enabled.size();++k ){
+		Object *obj=enabled[k];
+		if( !pickable( obj ) ){
+			obj->setPickSlot( -1 );
+			continue;
+		}
+		obj->setPickSlot( entries.size() );
+		Entry e;
+		e.obj=obj;
+		e.box.clear();
+		entries.push_back( e );
+		bound( entries.size()-1 );
+	}
+	pick_moved_max=entries.size();
+}
+
+bool PickIndex::bound( int index ){
+	Entry &e=entries[index];
+	Object *obj=e.obj;
+
+	bool was_empty=e.box.empty();
+
+	const Transform &tf=obj->getWorldTform();
+
+	e.radius_scale=1;
+	e.unbounded=false;
+	e.box.clear();
+
+	switch( obj->getPickGeometry() ){
+	case World::COLLISION_METHOD_SPHERE:
+		e.box=Box( tf.v );
+		e.box.expand( fabs( obj->getCollisionRadii().x ) );
+		break;
+	case World::COLLISION_METHOD_BOX:{
+		//World::hitTest normalizes the box axes, so a local point moves at most its L1 length...
+		const Box &b=obj->getCollisionBox();
+		float r=0;
+		for( int k=0;k<8;++k ){
+			const Vector &c=b.corner( k );
+			r=std::max( r,fabsf( c.x )+fabsf( c.y )+fabsf( c.z ) );
+		}
+		e.box=Box( tf.v );
+		e.box.expand( r );
+		//...and so does the line radius, by up to sqrt(3)
+		e.radius_scale=1.7320508f;
+		break;
+	}
+	case World::COLLISION_METHOD_POLYGON:
+		if( MeshModel *mesh=obj->getModel()->getMeshModel() ){
+			//an empty mesh stays empty, and is never hit
+			const Box &mb=mesh->getBox();
+			if( !mb.empty() ) e.box=tf * mb;
+		}else{
+			e.unbounded=true;
+		}
+		break;
+	}
+
+	if( !e.box.empty() ){
+		float m=0;
+		for( int k=0;k<3;++k ) m=std::max( m,std::max( fabsf( e.box.a[k] ),fabsf( e.box.b[k] ) ) );
+		e.box.expand( PICK_EPSILON*(1+m) );
+	}
+
+	//empty boxes are left out of the tree
+	return e.box.empty()!=was_empty;
+}
+
+void PickIndex::build(){
+	refits=0;
+	nodes.clear();
+	items.clear();
+	unbounded.clear();
+
+	for( unsigned int k=0;k<entries.size();++k ){
+		const Entry &e=entries[k];
+		if( e.unbounded ) unbounded.push_back( k );
+		else if( !e.box.empty() ) items.push_back( k );
+	}
+	if( !items.size() ) return;
+
+	//same layout as MeshCollider: depth first, left child follows its parent
+	struct Task{
+		int first,count,parent;
+	};
+	std::vector<Task> tasks;
+	tasks.push_back( Task{ 0,(int)items.size(),-1 } );
+
+	while( tasks.size() ){
+		Task t=tasks.back();
+		tasks.pop_back();
+
+		int index=nodes.size();
+		if( t.parent>=0 ) nodes[t.parent].first=index;
+
+		Box box,cbox;
+		for( int k=t.first;k<t.first+t.count;++k ){
+			const Box &b=entries[items[k]].box;
+			box.update( b );
+			cbox.update( b.centre() );
+		}
+		nodes.push_back( Node() );
+		nodes[index].box=box;
+
+		if( t.count<=PICK_LEAF ){
+			nodes[index].first=t.first;
+			nodes[index].count=t.count;
+			continue;
+		}
+
+		float w=cbox.width(),h=cbox.height(),d=cbox.depth();
+		int axis=w>=h && w>=d ? 0 : ( h>=d ? 1 : 2 );
+		int mid=t.first+t.count/2;
+		std::nth_element( items.begin()+t.first,items.begin()+mid,items.begin()+t.first+t.count,[&]( int p,int q ){
+			return entries[p].box.centre()[axis]<entries[q].box.centre()[axis];
+		} );
+
+		nodes[index].count=0;
+		tasks.push_back( Task{ mid,t.first+t.count-mid,index } );
+		tasks.push_back( Task{ t.first,mid-t.first,-1 } );
+	}
+}
+
+void PickIndex::refit(){
+	//children always follow their parents
+	for( int k=nodes.size()-1;k>=0;--k ){
+		Node &node=nodes[k];
+		if( node.count ){
+			node.box.clear();
+			for( int j=node.first;j<node.first+node.count;++j ) node.box.update( entries[items[j]].box );
+		}else{
+			node.box=nodes[k+1].box;
+			node.box.update( nodes[node.first].box );
+		}
+	}
+}
+
+bool PickIndex::mayHit( int index,const Line &line,float radius,float time )const{
+	const Entry &e=entries[index];
+	if( e.unbounded ) return true;
+	if( e.box.empty() ) return false;
+	return lineEnters( line,e.box,fabsf( radius )*e.radius_scale,time );
+}
+
+void PickIndex::query( const Line &line,float radius,float time,std::vector<int> &out )const{
+	out.clear();
+
+	if( nodes.size() ){
+		//nodes don't know which of their objects is a box, so assume the worst
+		float grow=fabsf( radius )*1.7320508f;
+
+		int stack[MAX_PICK_DEPTH],sp=0;
+		int index=0;
+		for(;;){
+			const Node &node=nodes[index];
+			if( lineEnters( line,node.box,grow,time ) ){
+				if( !node.count ){
+					stack[sp++]=node.first;
+					++index;
+					continue;
+				}
+				for( int k=node.first;k<node.first+node.count;++k ){
+					if( mayHit( items[k],line,radius,time ) ) out.push_back( items[k] );
+				}
+			}
+			if( !sp ) break;
+			index=stack[--sp];
+		}
+	}
+
+	out.insert( out.end(),unbounded.begin(),unbounded.end() );
+
+	//World::traceRay keeps the last of equally near hits, so order matters
+	std::sort( out.begin(),out.end() );
+}
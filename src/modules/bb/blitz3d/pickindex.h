@@ -0,0 +1,59 @@
+
+#ifndef PICKINDEX_H
+#define PICKINDEX_H
+
+#include "object.h"
+
+//Broad phase for World::traceRay and World::checkLOS.
+//
+//Holds the enabled objects with pick geometry in enumeration order, with
+//conservative world bounds for their pick method in a flat BVH. The index is
+//rebuilt when the entity tree or a pick mode changes; moved objects report
+//themselves and only their bounds are refreshed.
+class PickIndex{
+public:
+	PickIndex();
+	~PickIndex();
+
+	//obj's pick bounds may have changed
+	static void moved( Object *obj );
+
+	//bring the index up to date; must be called before query()
+	void validate();
+
+	//indices of the objects the line, grown by radius, may hit at or before time, in enumeration order
+	void query( const Line &line,float radius,float time,std::vector<int> &out )const;
+
+	//false if the line, grown by radius, can't hit objects[index] at or before time
+	bool mayHit( int index,const Line &line,float radius,float time )const;
+
+	Object *object( int index )const{ return entries[index].obj; }
+
+private:
+	struct Entry{
+		Object *obj;
+		Box box;
+		//multiplies the line radius before growing box
+		float radius_scale;
+		bool unbounded;
+	};
+
+	struct alignas(32) Node{
+		Box box;
+		//interior: right child, left child is the next node; leaf: first item
+		int first,count;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<int> unbounded;
+	std::vector<Node> nodes;
+	std::vector<int> items;
+	int tree_changes,geom_epoch,refits;
+
+	void enumerate();
+	bool bound( int index );
+	void build();
+	void refit();
+};
+
+#endif
@@ -0,0 +1,183 @@
+
+#include "std.h"
+#include "skinning.h"
+#include "../../../stdutil/workers.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define SKIN_SSE
+#include <emmintrin.h>
+#endif
+
+//vertices per job when splitting a mesh across workers
+static const int SKIN_CHUNK=4096;
+
+//Vec4s per palette entry: coord i,j,k,v then normal i,j,k
+static const int SKIN_PALETTE=7;
+
+static WorkerPool *skin_workers;
+
+void SkinCache::setThreads( int threads ){
+	if( threads<0 ) threads=WorkerPool::hardwareThreads();
+
+	delete skin_workers;
+	skin_workers=threads>1 ? d_new WorkerPool( threads ) : 0;
+}
+
+void SkinCache::update( const std::vector<Surface::Vertex> &verts,int valid ){
+	int n=verts.size();
+	if( valid>(int)coords.size() ) valid=coords.size();
+
+	coords.resize( n );
+	normals.resize( n );
+	weights.resize( n );
+
+	for( ;valid<n;++valid ){
+		const Surface::Vertex &v=verts[valid];
+
+		Vec4 &c=coords[valid];
+		c.x=v.coords.x;c.y=v.coords.y;c.z=v.coords.z;c.w=0;
+		Vec4 &nm=normals[valid];
+		nm.x=v.normal.x;nm.y=v.normal.y;nm.z=v.normal.z;nm.w=0;
+
+		Weights &w=weights[valid];
+		if( v.bone_bones[0]==255 ){
+			//no bone!
+			w.count=1;
+			w.bone[0]=0;
+		}else if( v.bone_bones[1]==255 ){
+			//one bone only
+			w.count=1;
+			w.bone[0]=v.bone_bones[0];
+		}else{
+			w.count=0;
+			for( int k=0;k<MAX_SURFACE_BONES;++k ){
+				if( v.bone_bones[k]==255 ) break;
+				w.bone[k]=v.bone_bones[k];
+				w.weight[k]=v.bone_weights[k];
+				++w.count;
+			}
+		}
+	}
+}
+
+void SkinCache::skin( const std::vector<Surface::Bone> &bones,const std::vector<Surface::Vertex> &verts,int valid,BBMesh *mesh ){
+	update( verts,valid );
+
+	int n=verts.size();
+	if( !n ) return;
+
+	palette.resize( bones.size()*SKIN_PALETTE );
+	for( unsigned int k=0;k<bones.size();++k ){
+		const Transform &t=bones[k].coord_tform;
+		const Matrix &m=bones[k].normal_tform;
+		const Vector *cols[SKIN_PALETTE]={ &t.m.i,&t.m.j,&t.m.k,&t.v,&m.i,&m.j,&m.k };
+		Vec4 *p=&palette[k*SKIN_PALETTE];
+		for( int c=0;c<SKIN_PALETTE;++c ){
+			p[c].x=cols[c]->x;p[c].y=cols[c]->y;p[c].z=cols[c]->z;p[c].w=0;
+		}
+	}
+
+	skinned_coords.resize( n*3 );
+	skinned_normals.resize( n*3 );
+
+	const Vec4 *pal=palette.size() ? &palette[0] : 0;
+	float *out_c=&skinned_coords[0],*out_n=&skinned_normals[0];
+
+	int chunks=(n+SKIN_CHUNK-1)/SKIN_CHUNK;
+	if( skin_workers && chunks>1 ){
+		skin_workers->run( chunks,[this,pal,n,out_c,out_n]( int chunk,int worker ){
+			int first=chunk*SKIN_CHUNK;
+			skinRange( pal,first,std::min( first+SKIN_CHUNK,n ),out_c,out_n );
+		} );
+	}else{
+		skinRange( pal,0,n,out_c,out_n );
+	}
+
+	mesh->setVertices( 0,n,out_c,out_n,&verts[0] );
+}
+
+#ifdef SKIN_SSE
+
+//same operation order as Matrix::operator*( const Vector & )
+static inline __m128 skinMul( const float *m,__m128 v ){
+	__m128 x=_mm_shuffle_ps( v,v,_MM_SHUFFLE(0,0,0,0) );
+	__m128 y=_mm_shuffle_ps( v,v,_MM_SHUFFLE(1,1,1,1) );
+	__m128 z=_mm_shuffle_ps( v,v,_MM_SHUFFLE(2,2,2,2) );
+	__m128 r=_mm_add_ps( _mm_mul_ps( _mm_load_ps( m ),x ),_mm_mul_ps( _mm_load_ps( m+4 ),y ) );
+	return _mm_add_ps( r,_mm_mul_ps( _mm_load_ps( m+8 ),z ) );
+}
+
+void SkinCache::skinRange( const Vec4 *palette,int first,int last,float *out_coords,float *out_normals )const{
+	alignas(16) float tc[4],tn[4];
+
+	for( int k=first;k<last;++k ){
+		const Weights &w=weights[k];
+		__m128 c=_mm_load_ps( &coords[k].x );
+		__m128 nm=_mm_load_ps( &normals[k].x );
+
+		if( w.count==1 ){
+			const float *p=&palette[w.bone[0]*SKIN_PALETTE].x;
+			_mm_store_ps( tc,_mm_add_ps( skinMul( p,c ),_mm_load_ps( p+12 ) ) );
+			_mm_store_ps( tn,skinMul( p+16,nm ) );
+		}else{
+			__m128 ac=_mm_setzero_ps(),an=_mm_setzero_ps();
+			for( int b=0;b<w.count;++b ){
+				const float *p=&palette[w.bone[b]*SKIN_PALETTE].x;
+				__m128 wt=_mm_set1_ps( w.weight[b] );
+				ac=_mm_add_ps( ac,_mm_mul_ps( _mm_add_ps( skinMul( p,c ),_mm_load_ps( p+12 ) ),wt ) );
+				an=_mm_add_ps( an,_mm_mul_ps( skinMul( p+16,nm ),wt ) );
+			}
+			_mm_store_ps( tc,ac );
+			_mm_store_ps( tn,an );
+			float l=sqrtf( tn[0]*tn[0]+tn[1]*tn[1]+tn[2]*tn[2] );
+			tn[0]/=l;tn[1]/=l;tn[2]/=l;
+		}
+
+		float *oc=out_coords+k*3,*on=out_normals+k*3;
+		oc[0]=tc[0];oc[1]=tc[1];oc[2]=tc[2];
+		on[0]=tn[0];on[1]=tn[1];on[2]=tn[2];
+	}
+}
+
+#else
+
+static inline void skinMul( const float *m,const float *v,float *r ){
+	r[0]=m[0]*v[0]+m[4]*v[1]+m[8]*v[2];
+	r[1]=m[1]*v[0]+m[5]*v[1]+m[9]*v[2];
+	r[2]=m[2]*v[0]+m[6]*v[1]+m[10]*v[2];
+}
+
+void SkinCache::skinRange( const Vec4 *palette,int first,int last,float *out_coords,float *out_normals )const{
+	float tc[3],tn[3];
+
+	for( int k=first;k<last;++k ){
+		const Weights &w=weights[k];
+		const float *c=&coords[k].x,*nm=&normals[k].x;
+		float *oc=out_coords+k*3,*on=out_normals+k*3;
+
+		if( w.count==1 ){
+			const float *p=&palette[w.bone[0]*SKIN_PALETTE].x;
+			skinMul( p,c,tc );
+			oc[0]=tc[0]+p[12];oc[1]=tc[1]+p[13];oc[2]=tc[2]+p[14];
+			skinMul( p+16,nm,on );
+			continue;
+		}
+
+		float ac[3]={ 0,0,0 },an[3]={ 0,0,0 };
+		for( int b=0;b<w.count;++b ){
+			const float *p=&palette[w.bone[b]*SKIN_PALETTE].x;
+			float wt=w.weight[b];
+			skinMul( p,c,tc );
+			skinMul( p+16,nm,tn );
+			for( int i=0;i<3;++i ){
+				ac[i]+=(tc[i]+p[12+i])*wt;
+				an[i]+=tn[i]*wt;
+			}
+		}
+		float l=sqrtf( an[0]*an[0]+an[1]*an[1]+an[2]*an[2] );
+		oc[0]=ac[0];oc[1]=ac[1];oc[2]=ac[2];
+		on[0]=an[0]/l;on[1]=an[1]/l;on[2]=an[2]/l;
+	}
+}
+
+#endif
@@ -0,0 +1,47 @@
+
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include "surface.h"
+
+class WorkerPool;
+
+//CPU skinning for Surface::getMesh( bones,... )
+//
+//Keeps a copy of a surface's vertex positions, normals and weights as
+//separate, 16 byte aligned arrays, and transforms them in batches with SSE
+//where available. Results match the per-vertex Transform/Matrix arithmetic
+//bit for bit. Large meshes can be split across a pool set by setThreads.
+class SkinCache{
+public:
+	//skin every vertex into mesh, which must be locked
+	//valid: verts [0,valid) are unchanged since the last call
+	void skin( const std::vector<Surface::Bone> &bones,const std::vector<Surface::Vertex> &verts,int valid,BBMesh *mesh );
+
+	//threads<=1 skins on the calling thread only, <0 uses every core
+	static void setThreads( int threads );
+
+private:
+	struct alignas(16) Vec4{
+		float x,y,z,w;
+	};
+
+	struct Weights{
+		float weight[MAX_SURFACE_BONES];
+		unsigned char bone[MAX_SURFACE_BONES];
+		//1: rigid, bone[0] at full weight; else number of weighted bones
+		int count;
+	};
+
+	std::vector<Vec4> coords,normals;
+	std::vector<Weights> weights;
+	std::vector<Vec4> palette;
+
+	//skinned output, packed xyz, handed to the mesh
+	std::vector<float> skinned_coords,skinned_normals;
+
+	void update( const std::vector<Surface::Vertex> &verts,int valid );
+	void skinRange( const Vec4 *palette,int first,int last,float *out_coords,float *out_normals )const;
+};
+
+#endif
@@ -2,19 +2,24 @@
 #include "std.h"
 #include "surface.h"
 #include "scene.h"
+#include "skinning.h"
+#include <bb/profile/profile.h>
 
 static Surface::Monitor nop_mon;
 
+int Surface::geom_epoch;
+
 Surface::Surface():
-mesh(0),mesh_vs(0),mesh_ts(0),valid_vs(0),valid_ts(0),skin_owner(0),skin_mesh(false),mon( &nop_mon ){
+mesh(0),mesh_vs(0),mesh_ts(0),valid_vs(0),valid_ts(0),skin_owner(0),skin_mesh(false),skin_cache(0),skin_vs(0),mon( &nop_mon ){
 }
 
 Surface::Surface( Monitor *m ):
-mesh(0),mesh_vs(0),mesh_ts(0),valid_vs(0),valid_ts(0),skin_owner(0),skin_mesh(false),mon(m){
+mesh(0),mesh_vs(0),mesh_ts(0),valid_vs(0),valid_ts(0),skin_owner(0),skin_mesh(false),skin_cache(0),skin_vs(0),mon(m){
 }
 
 Surface::~Surface(){
 	if( mesh ) bbScene->freeMesh( mesh );
+	delete skin_cache;
 }
 
 void Surface::setBrush( const Brush &b ){
@@ -27,14 +32,14 @@ void Surface::setName( const std::string &n ){
 }
 
 void Surface::clear( bool verts,bool tris ){
-	if( verts ){ vertices.clear();valid_vs=0; }
+	if( verts ){ vertices.clear();valid_vs=skin_vs=0; }
 	if( tris ){ triangles.clear();valid_ts=0; }
-	++mon->geom_changes;
+	geomChanged();
 }
 
 void Surface::addVertices( const std::vector<Vertex> &verts ){
 	vertices.insert( vertices.end(),verts.begin(),verts.end() );
-	++mon->geom_changes;
+	geomChanged();
 }
 
 void Surface::setColor( int n,const Vector &v ){
@@ -78,6 +83,7 @@ void Surface::updateNormals(){
 		Vertex *v=&vertices[k];
 		v->normal=norm_map[v->coords].normalized();
 	}
+	skin_vs=0;
 }
 
 BBMesh *Surface::getMesh(){
@@ -85,6 +91,8 @@ BBMesh *Surface::getMesh(){
 
 	if( valid_vs==vertices.size() && valid_ts==triangles.size() ) return mesh;
 
+	BB_PROFILE( "Surface::getMesh" );
+
 	valid_vs=valid_ts=0;
 
 	if( mesh_vs<vertices.size() || mesh_ts<triangles.size() ){
@@ -116,6 +124,8 @@ BBMesh *Surface::getMesh( const std::vector<Bone> &bones,const void *owner,bool
 	if( !bones_moved && owner==skin_owner && mesh && valid_vs==vertices.size() && valid_ts==triangles.size() ) return mesh;
 	skin_owner=owner;
 
+	BB_PROFILE( "Surface::getMesh" );
+
 	// vertices are re-skinned every call, but the indices only need
 	// (re)writing when the mesh is created or grows
 	valid_vs=0;
@@ -128,30 +138,11 @@ BBMesh *Surface::getMesh( const std::vector<Bone> &bones,const void *owner,bool
 		valid_ts=0;
 	}
 
+	if( !skin_cache ) skin_cache=d_new SkinCache();
+
 	mesh->lock( true );
-	for( ;valid_vs<vertices.size();++valid_vs ){
-		const Vertex &v=vertices[valid_vs];
-		if( v.bone_bones[0]==255 ){
-			//no bone!
-			const Bone &bone=bones[0];
-			mesh->setVertex( valid_vs,bone.coord_tform * v.coords,bone.normal_tform * v.normal,v.color,v.tex_coords );
-		}else if( v.bone_bones[1]==255 ){
-			//one bone only
-			const Bone &bone=bones[v.bone_bones[0]];
-			mesh->setVertex( valid_vs,bone.coord_tform * v.coords,bone.normal_tform * v.normal,v.color,v.tex_coords );
-		}else{
-			const Vertex &v=vertices[valid_vs];
-			//two or more bones
-			Vector tv,tn;
-			for( int n=0;n<MAX_SURFACE_BONES;++n ){
-				if( v.bone_bones[n]==255 ) break;
-				const Bone &bone=bones[v.bone_bones[n]];
-				tv+=bone.coord_tform * v.coords * v.bone_weights[n];
-				tn+=bone.normal_tform * v.normal * v.bone_weights[n];
-			}
-			mesh->setVertex( valid_vs,tv,tn.normalized(),v.color,v.tex_coords );
-		}
-	}
+	skin_cache->skin( bones,vertices,skin_vs,mesh );
+	valid_vs=skin_vs=vertices.size();
 	for( ;valid_ts<triangles.size();++valid_ts ){
 		const Triangle &t=triangles[valid_ts];
 		mesh->setTriangle( valid_ts,t.verts[0],t.verts[1],t.verts[2] );
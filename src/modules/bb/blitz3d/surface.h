@@ -7,6 +7,8 @@
 
 #define MAX_SURFACE_BONES 4
 
+class SkinCache;
+
 class Surface{
 public:
 	struct Vertex{
@@ -54,21 +56,24 @@ public:
 
 	void addVertex( const Vertex &v ){
 		vertices.push_back(v);
-		++mon->geom_changes;
+		geomChanged();
 	}
 	void setVertex( int n,const Vertex &v ){
 		vertices[n]=v;
 		if( n<valid_vs ) valid_vs=n;
-		++mon->geom_changes;
+		if( n<skin_vs ) skin_vs=n;
+		geomChanged();
 	}
 	void setCoords( int n,const Vector &v ){
 		vertices[n].coords=v;
 		if( n<valid_vs ) valid_vs=n;
-		++mon->geom_changes;
+		if( n<skin_vs ) skin_vs=n;
+		geomChanged();
 	}
 	void setNormal( int n,const Vector &v ){
 		vertices[n].normal=v;
 		if( n<valid_vs ) valid_vs=n;
+		if( n<skin_vs ) skin_vs=n;
 	}
 	void setColor( int n,unsigned argb ){
 		vertices[n].color=argb;
@@ -81,12 +86,12 @@ public:
 	}
 	void addTriangle( const Triangle &t ){
 		triangles.push_back(t);
-		++mon->geom_changes;
+		geomChanged();
 	}
 	void setTriangle( int n,const Triangle &t ){
 		triangles[n]=t;
 		if( n<valid_ts ) valid_ts=n;
-		++mon->geom_changes;
+		geomChanged();
 	}
 
 	Vector getColor( int index )const;
@@ -112,6 +117,9 @@ public:
 	const Vertex &getVertex( int n )const{ return vertices[n]; }
 	const Triangle &getTriangle( int n )const{ return triangles[n]; }
 
+	//bumped whenever any surface's geometry changes
+	static int geomEpoch(){ return geom_epoch; }
+
 private:
 	Brush brush;
 	std::string name;
@@ -124,7 +132,17 @@ private:
 	const void *skin_owner;
 	//mesh was created with MESH_SKINNED (bind pose + weight attributes)
 	bool skin_mesh;
+	//CPU skinning copy of the vertices, [0,skin_vs) of which are current
+	SkinCache *skin_cache;
+	int skin_vs;
 	Monitor *mon;
+
+	static int geom_epoch;
+
+	void geomChanged(){
+		++mon->geom_changes;
+		++geom_epoch;
+	}
 };
 
 #endif
@@ -1,8 +1,12 @@
 
 #include <bb/graphics/graphics.h>
+#include <bb/profile/profile.h>
 #include "std.h"
 #include <queue>
+#include <unordered_set>
 #include "world.h"
+#include "meshmodel.h"
+#include "../../../stdutil/workers.h"
 
 //0=tris compared for collision
 //1=max proj err of terrain
@@ -10,60 +14,138 @@ float stats3d[10];
 
 extern BBScene *bbScene;
 
-static std::vector<Object*> _enabled,_visible;
-
-static void enumEnabled(){
-	_enabled.clear();
-	for( Entity *e=Entity::orphans();e;e=e->successor() ){
-		e->enumEnabled( _enabled );
-	}
-}
-
-static void enumVisible(){
-	_visible.clear();
-	for( Entity *e=Entity::orphans();e;e=e->successor() ){
-		e->enumVisible( _visible );
-	}
-}
-
 /******************************* Update *******************************/
 
 static std::vector<Object*> _objsByType[1000];
 
-static std::vector<ObjCollision*> free_colls,used_colls;
+extern thread_local float *tris_stat;
+
+//below this many colliding objects threads don't pay for themselves
+static const int THREAD_MIN=64;
+//movers per WorkerPool index
+static const int THREAD_CHUNK=16;
 
-static ObjCollision *allocObjColl( Object *with,const Vector &coords,const Collision &coll ){
+ObjCollisionPool::~ObjCollisionPool(){
+	recycle();
+	for( unsigned int k=0;k<free.size();++k ) delete free[k];
+}
+
+ObjCollision *ObjCollisionPool::alloc( Object *with,const Vector &coords,const Collision &coll ){
 	ObjCollision *c;
-	if( free_colls.size() ){
-		c=free_colls.back();
-		free_colls.pop_back();
+	if( free.size() ){
+		c=free.back();
+		free.pop_back();
 	}else{
 		c=new ObjCollision();
 	}
-	used_colls.push_back( c );
+	used.push_back( c );
 	c->with=with;
 	c->coords=coords;
 	c->collision=coll;
 	return c;
 }
 
-static void collided( Object *src,Object *dest,const Line &line,const Collision &coll,float y_scale ){
+void ObjCollisionPool::recycle(){
+	for( ;used.size();used.pop_back() ){
+		free.push_back( used.back() );
+	}
+}
 
-	ObjCollision *c;
-	const Vector &coords=line*coll.time-coll.normal*src->getCollisionRadii().x;
+//XZ areas where targets moved during a threaded update, so later movers know
+//whether their speculative result still holds
+class DirtyMap{
+public:
+	void reset( float cell ){
+		inv_cell=cell>0 ? 1/cell : 0;
+		cells.clear();
+		boxes.clear();
+		large.clear();
+	}
+	void mark( const Box &b ){
+		if( b.empty() ) return;
+		boxes.push_back( b );
+		int x0,z0,x1,z1;
+		if( !range( b,x0,z0,x1,z1 ) ){
+			large.push_back( b );
+			return;
+		}
+		for( int z=z0;z<=z1;++z ){
+			for( int x=x0;x<=x1;++x ) cells.insert( key( x,z ) );
+		}
+	}
+	bool test( const Box &b )const{
+		if( b.empty() || !boxes.size() ) return false;
+		for( unsigned int k=0;k<large.size();++k ){
+			if( overlaps( b,large[k] ) ) return true;
+		}
+		int x0,z0,x1,z1;
+		if( !range( b,x0,z0,x1,z1 ) ){
+			for( unsigned int k=0;k<boxes.size();++k ){
+				if( overlaps( b,boxes[k] ) ) return true;
+			}
+			return false;
+		}
+		for( int z=z0;z<=z1;++z ){
+			for( int x=x0;x<=x1;++x ){
+				if( cells.count( key( x,z ) ) ) return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	static const int MAX_CELLS=64;
 
-	c=allocObjColl( dest,coords,coll );
-	c->coords.y*=y_scale;
-	src->addCollision( c );
+	float inv_cell;
+	std::unordered_set<long long> cells;
+	std::vector<Box> boxes,large;
 
-	c=allocObjColl( src,coords,coll );
-	c->coords.y*=y_scale;
-	dest->addCollision( c );
+	static long long key( int x,int z ){
+		return ((long long)x<<32)|(unsigned int)z;
+	}
+	static bool overlaps( const Box &p,const Box &q ){
+		return p.a.x<=q.b.x && p.b.x>=q.a.x && p.a.z<=q.b.z && p.b.z>=q.a.z;
+	}
+	static bool cell( float t,int &n ){
+		t=floorf( t );
+		if( !(t>-1e9f && t<1e9f) ) return false;
+		n=(int)t;
+		return true;
+	}
+	bool range( const Box &b,int &x0,int &z0,int &x1,int &z1 )const{
+		if( !cell( b.a.x*inv_cell,x0 ) || !cell( b.b.x*inv_cell,x1 ) ) return false;
+		if( !cell( b.a.z*inv_cell,z0 ) || !cell( b.b.z*inv_cell,z1 ) ) return false;
+		return (long long)(x1-x0+1)*(z1-z0+1)<=MAX_CELLS;
+	}
+};
+
+World::World():
+_workers(0),_dirty(d_new DirtyMap()){
+	clearCollisions();
+	setThreads( 0 );
+}
+
+World::~World(){
+	delete _workers;
+	delete _dirty;
+	for( unsigned int k=0;k<_pools.size();++k ) delete _pools[k];
+}
+
+void World::setThreads( int threads ){
+	if( threads<0 ) threads=WorkerPool::hardwareThreads();
+	if( threads<1 ) threads=1;
+
+	delete _workers;
+	_workers=threads>1 ? d_new WorkerPool( threads ) : 0;
+
+	while( (int)_pools.size()<threads ) _pools.push_back( d_new ObjCollisionPool() );
+	_cands.resize( threads );
 }
 
 void World::clearCollisions(){
 	for( int k=0;k<1000;++k ){
 		_collInfo[k].clear();
+		_collMethods[k]=0;
 	}
 }
 
@@ -77,6 +159,7 @@ void World::addCollision( int src_type,int dst_type,int method,int response ){
 
 	CollInfo co={dst_type,method,response};
 	_collInfo[src_type].push_back(co);
+	_collMethods[dst_type]|=1<<(method&31);
 }
 
 bool World::hitTest( const Line &line,float radius,Object *obj,const Transform &tf,int method,Collision *curr_coll  ){
@@ -98,19 +181,18 @@ bool World::hitTest( const Line &line,float radius,Object *obj,const Transform &
 
 bool World::checkLOS( Object *src,Object *dest ){
 
-	enumEnabled();
+	_picks.validate();
 
-	Object *coll_obj=0;
 	Collision curr_coll;
 
 	Line line( src->getWorldPosition(),dest->getWorldPosition()-src->getWorldPosition() );
 
-	std::vector<Object*>::const_iterator it;
+	_picks.query( line,0,curr_coll.time,_pick_cands );
 
-	for( it=_enabled.begin();it!=_enabled.end();++it ){
-		Object *obj=*it;
+	for( unsigned int k=0;k<_pick_cands.size();++k ){
+		Object *obj=_picks.object( _pick_cands[k] );
 
-		if( obj==src || obj==dest || !obj->getPickGeometry() || !obj->getObscurer() ) continue;
+		if( obj==src || obj==dest || !obj->getObscurer() ) continue;
 
 		if( hitTest( line,0,obj,obj->getWorldTform(),obj->getPickGeometry(),&curr_coll ) ){
 			return false;
@@ -120,47 +202,74 @@ bool World::checkLOS( Object *src,Object *dest ){
 }
 
 Object *World::traceRay( const Line &line,float radius,ObjCollision *curr_coll ){
+	traceRays( &line,&radius,curr_coll,1 );
+	return curr_coll->with;
+}
 
-	enumEnabled();
+void World::traceRays( const Line *lines,const float *radii,ObjCollision *colls,int n ){
 
-	Object *coll_obj=0;
+	_picks.validate();
 
-	std::vector<Object*>::const_iterator it;
-	for( it=_enabled.begin();it!=_enabled.end();++it ){
-		Object *obj=*it;
+	for( int k=0;k<n;++k ){
+		const Line &line=lines[k];
+		float radius=radii[k];
+		ObjCollision *curr_coll=&colls[k];
 
-		if( !obj->getPickGeometry() ) continue;
+		Object *coll_obj=0;
+
+		_picks.query( line,radius,curr_coll->collision.time,_pick_cands );
 
-		if( hitTest( line,radius,obj,obj->getWorldTform(),obj->getPickGeometry(),&curr_coll->collision ) ){
-			coll_obj=obj;
+		for( unsigned int j=0;j<_pick_cands.size();++j ){
+			int index=_pick_cands[j];
+			//an earlier hit may have brought time in
+			if( !_picks.mayHit( index,line,radius,curr_coll->collision.time ) ) continue;
+
+			Object *obj=_picks.object( index );
+			if( hitTest( line,radius,obj,obj->getWorldTform(),obj->getPickGeometry(),&curr_coll->collision ) ){
+				coll_obj=obj;
+			}
+		}
+		if( (curr_coll->with=coll_obj) ){
+			curr_coll->coords=line*curr_coll->collision.time-curr_coll->collision.normal*radius;
 		}
 	}
-	if( (curr_coll->with=coll_obj) ){
-		curr_coll->coords=line*curr_coll->collision.time-curr_coll->collision.normal*radius;
-	}
-	return coll_obj;
+}
+
+//terrain collisions go through shared statics in terrainrep.cpp
+static bool threadSafe( Object *obj ){
+	Model *model=obj->getModel();
+	return !model || !model->getTerrain();
 }
 
 //
 // NEW VERSION
 //
-void World::collide( Object *src ){
+bool World::collide( Object *src,CollJob &job,ObjCollisionPool &pool,std::vector<int> &cands,bool speculate ){
+	BB_PROFILE( "World::collide" );
 
 	static const int MAX_HITS=10;
 
+	job.src=src;
+	job.colls.clear();
+	job.move=false;
+	job.region.clear();
+
 	Vector dv=src->getWorldTform().v;
 	Vector sv=src->getPrevWorldTform().v;
 
+	job.start=dv;
+
 	if( sv==dv ){
 		if( dv.x!=sv.x || dv.y!=sv.y || dv.z!=sv.z ){
-			src->setWorldPosition( sv );
+			job.move=true;
+			job.pos=sv;
 		}
-		return;
+		return true;
 	}
 
 	Vector panic=sv;
 
-	static Transform y_tform;
+	Transform y_tform;
 
 	const Vector &radii=src->getCollisionRadii();
 
@@ -191,18 +300,31 @@ void World::collide( Object *src ){
 		Object *coll_obj=0;
 		std::vector<CollInfo>::const_iterator coll_it,coll_info;
 
-		for( coll_it=collinfos.begin();coll_it!=collinfos.end();++coll_it ){
+		//swept sphere, padded for rounding in the narrow phase
+		Box sweep( coll_line );
+		sweep.expand( radius+COLLISION_EPSILON );
+		if( speculate ) job.region.update( sweep );
 
-			std::vector<Object*>::const_iterator dst_it;
+		for( coll_it=collinfos.begin();coll_it!=collinfos.end();++coll_it ){
 
 			const std::vector<Object*> &dst_objs=_objsByType[coll_it->dst_type];
+			if( !dst_objs.size() ) continue;
 
-			for( dst_it=dst_objs.begin();dst_it!=dst_objs.end();++dst_it ){
+			const CollisionGrid &grid=_gridByType[coll_it->dst_type];
+			if( speculate ) job.region.update( grid.reach( coll_line,coll_it->method,radius ) );
+			grid.query( coll_line,y_scale,coll_it->method,radius,cands );
 
-				Object *dst=*dst_it;
+			for( unsigned int k=0;k<cands.size();++k ){
+
+				Object *dst=dst_objs[cands[k]];
 
 				if( src==dst ) continue;
 
+				if( speculate && coll_it->method==COLLISION_METHOD_POLYGON && !threadSafe( dst ) ){
+					job.bailed=true;
+					return false;
+				}
+
 				const Transform &dst_tform=dst->getPrevWorldTform();
 
 				if( y_scale==1 ){
@@ -230,7 +352,15 @@ void World::collide( Object *src ){
 			break;
 		}
 
-		collided( src,coll_obj,coll_line,coll,inv_y_scale );
+		const Vector &coords=coll_line*coll.time-coll.normal*radius;
+
+		ObjCollision *c=pool.alloc( coll_obj,coords,coll );
+		c->coords.y*=inv_y_scale;
+		job.colls.push_back( c );
+
+		c=pool.alloc( src,coords,coll );
+		c->coords.y*=inv_y_scale;
+		job.colls.push_back( c );
 
 		Plane coll_plane( coll_line*coll.time,coll.normal );
 
@@ -291,13 +421,33 @@ void World::collide( Object *src ){
 	}
 
 	if( hits ){
+		job.move=true;
 		if( hits<MAX_HITS ){
 			dv.y*=inv_y_scale;
-			src->setWorldPosition( dv );
+			job.pos=dv;
 		}else{
-			src->setWorldPosition( panic );
+			job.pos=panic;
+		}
+	}
+
+	//box targets are tested with the source radius added on
+	if( speculate ) job.region.expand( radius );
+	return true;
+}
+
+void World::commit( const CollJob &job,bool hoisted ){
+	Object *src=job.src;
+
+	for( unsigned int k=0;k<job.colls.size();k+=2 ){
+		ObjCollision *c=job.colls[k];
+		src->addCollision( c );
+		//with beginUpdate hoisted, a later object's collisions would have been cleared by it
+		if( !hoisted || c->with->getUpdateIndex()<src->getUpdateIndex() ){
+			c->with->addCollision( job.colls[k+1] );
 		}
 	}
+
+	if( job.move ) src->setWorldPosition( job.pos );
 }
 
 /*
@@ -464,37 +614,174 @@ void World::collide( Object *src ){
 */
 
 void World::update( float elapsed ){
+	BB_PROFILE( "World::update" );
 
 	stats3d[0]=0;
 
-	for( ;used_colls.size();used_colls.pop_back() ){
-		free_colls.push_back( used_colls.back() );
+	for( unsigned int k=0;k<_pools.size();++k ){
+		_pools[k]->recycle();
 	}
 
-	enumEnabled();
+	const std::vector<Object*> &enabled=Entity::enabledObjects();
 
-	std::vector<Object*>::const_iterator it;
-	for( it=_enabled.begin();it!=_enabled.end();++it ){
-		Object *o=*it;
+	_slots.resize( enabled.size() );
+
+	for( unsigned int k=0;k<enabled.size();++k ){
+		Object *o=enabled[k];
+
+		o->setUpdateIndex( k );
 
 		if( int n=o->getCollisionType() ){
+			_slots[k]=_objsByType[n].size();
 			_objsByType[n].push_back(o);
 		}
 	}
 
-	for( it=_enabled.begin();it!=_enabled.end();++it ){
-		Object *o=*it;
+	for( int k=0;k<1000;++k ){
+		if( _collMethods[k] && _objsByType[k].size() ){
+			_gridByType[k].build( _objsByType[k],_collMethods[k] );
+		}
+	}
+
+	if( !_workers || !updateThreaded( elapsed ) ) updateSerial( elapsed );
+
+	for( unsigned int k=0;k<enabled.size();++k ){
+		enabled[k]->setUpdateIndex( -1 );
+	}
+
+	for( int k=0;k<1000;++k ){
+		if( _objsByType[k].size() ){
+			_objsByType[k].clear();
+			_gridByType[k].clear();
+		}
+	}
+}
+
+void World::updateSerial( float elapsed ){
+
+	const std::vector<Object*> &enabled=Entity::enabledObjects();
+
+	_jobs.resize( 1 );
+	CollJob &job=_jobs[0];
+
+	for( unsigned int k=0;k<enabled.size();++k ){
+		Object *o=enabled[k];
 
 		o->beginUpdate( elapsed );
 
-		if( o->getCollisionType() ) collide( o );
+		int n=o->getCollisionType();
+		if( n ){
+			collide( o,job,*_pools[0],_cands[0],false );
+			commit( job,false );
+		}
 
 		o->endUpdate();
+
+		//endUpdate moves the previous tform targets are tested against
+		if( n && _collMethods[n] ) _gridByType[n].update( _slots[k] );
+	}
+}
+
+//Resolves all movers on the worker threads against the targets as they were at
+//the start of the update, then walks the enabled objects in order committing the results.
+//A mover whose result may have been affected by something committed before it
+//is redone serially, so the outcome is the same as updateSerial's.
+bool World::updateThreaded( float elapsed ){
+
+	const std::vector<Object*> &enabled=Entity::enabledObjects();
+
+	_movers.clear();
+	for( unsigned int k=0;k<enabled.size();++k ){
+		if( enabled[k]->getCollisionType() ) _movers.push_back( k );
+	}
+	if( _movers.size()<THREAD_MIN ) return false;
+
+	//beginUpdate is hoisted out of the commit loop, which is only equivalent if
+	//no animator touches an object updated before its owner
+	for( unsigned int k=0;k<enabled.size();++k ){
+		Animator *anim=enabled[k]->getAnimator();
+		if( !anim ) continue;
+		const std::vector<Object*> &objs=anim->getObjects();
+		for( unsigned int j=0;j<objs.size();++j ){
+			int t=objs[j]->getUpdateIndex();
+			if( t>=0 && t<(int)k ) return false;
+		}
 	}
 
+	for( unsigned int k=0;k<enabled.size();++k ){
+		enabled[k]->beginUpdate( elapsed );
+	}
+
+	//fill in the lazily computed state the workers read
+	for( unsigned int k=0;k<_movers.size();++k ){
+		enabled[_movers[k]]->getWorldTform();
+	}
 	for( int k=0;k<1000;++k ){
-		_objsByType[k].clear();
+		if( !(_collMethods[k] & (1<<COLLISION_METHOD_POLYGON)) ) continue;
+		const std::vector<Object*> &objs=_objsByType[k];
+		for( unsigned int j=0;j<objs.size();++j ){
+			Model *model=objs[j]->getModel();
+			MeshModel *mesh=model ? model->getMeshModel() : 0;
+			if( mesh ) mesh->getCollider();
+		}
+	}
+
+	_jobs.resize( _movers.size() );
+
+	int n_chunks=(_movers.size()+THREAD_CHUNK-1)/THREAD_CHUNK;
+	_workers->run( n_chunks,[this,&enabled]( int chunk,int worker ){
+		int end=std::min( (chunk+1)*THREAD_CHUNK,(int)_movers.size() );
+		for( int k=chunk*THREAD_CHUNK;k<end;++k ){
+			CollJob &job=_jobs[k];
+			job.tris=0;
+			job.bailed=false;
+			tris_stat=&job.tris;
+			collide( enabled[_movers[k]],job,*_pools[worker],_cands[worker],true );
+		}
+		tris_stat=&stats3d[0];
+	} );
+
+	float size=0;
+	for( unsigned int k=0;k<_jobs.size();++k ){
+		const Box &b=_jobs[k].region;
+		if( !b.empty() ) size+=std::max( b.width(),b.depth() );
 	}
+	_dirty->reset( size/_jobs.size() );
+
+	int next=0;
+	for( unsigned int k=0;k<enabled.size();++k ){
+		Object *o=enabled[k];
+
+		int n=o->getCollisionType();
+		if( !n ){
+			o->endUpdate();
+			continue;
+		}
+
+		CollJob &job=_jobs[next++];
+
+		const Vector &v=o->getWorldTform().v;
+		if( job.bailed || v.x!=job.start.x || v.y!=job.start.y || v.z!=job.start.z || _dirty->test( job.region ) ){
+			collide( o,job,*_pools[0],_cands[0],false );
+		}else{
+			stats3d[0]+=job.tris;
+		}
+		commit( job,true );
+
+		if( !_collMethods[n] ){
+			o->endUpdate();
+			continue;
+		}
+
+		Transform prev=o->getPrevWorldTform();
+		o->endUpdate();
+		if( !memcmp( &prev,&o->getPrevWorldTform(),sizeof(Transform) ) ) continue;
+
+		_dirty->mark( _gridByType[n].bounds( _slots[k] ) );
+		_gridByType[n].update( _slots[k] );
+		_dirty->mark( _gridByType[n].bounds( _slots[k] ) );
+	}
+	return true;
 }
 
 /****************************** Render *********************************/
@@ -529,28 +816,28 @@ static std::priority_queue<Model*,std::vector<Model*>,TransComp> transparents;
 
 void World::capture(){
 
-	enumVisible();
+	const std::vector<Object*> &visible=Entity::visibleObjects();
 
 	std::vector<Object*>::const_iterator it;
-	for( it=_visible.begin();it!=_visible.end();++it ){
+	for( it=visible.begin();it!=visible.end();++it ){
 		(*it)->capture();
 	}
 }
 
 void World::render( float tween ){
+	BB_PROFILE( "World::render" );
 	//set render tweens, and build ordered and unordered model lists...
 	ord_mods.clear();
 	unord_mods.clear();
 
-	_visible.clear();
 	_lights.clear();
 	_mirrors.clear();
 	_listeners.clear();
 
-	enumVisible();
+	const std::vector<Object*> &visible=Entity::visibleObjects();
 
 	std::vector<Object*>::const_iterator it;
-	for( it=_visible.begin();it!=_visible.end();++it ){
+	for( it=visible.begin();it!=visible.end();++it ){
 		Object *o=*it;
 
 		if( !o->beginRender(tween) ) continue;
@@ -624,7 +911,8 @@ void World::render( Camera *cam,Mirror *mirror ){
 	}
 
 	//set camera matrix
-	bbScene->setViewMatrix( (BBScene::Matrix*)&(-cam_tform) );
+	Transform view=-cam_tform;
+	bbScene->setViewMatrix( (BBScene::Matrix*)&view );
 
 	//initialize render context
 	RenderContext rc( cam_tform,cam->getFrustum(),mirror!=0 );
@@ -9,6 +9,23 @@
 #include "light.h"
 #include "mirror.h"
 #include "listener.h"
+#include "collisiongrid.h"
+#include "pickindex.h"
+
+class WorkerPool;
+class DirtyMap;
+
+//ObjCollisions handed out by one thread, recycled at the next update
+class ObjCollisionPool{
+public:
+	~ObjCollisionPool();
+
+	ObjCollision *alloc( Object *with,const Vector &coords,const Collision &coll );
+	void recycle();
+
+private:
+	std::vector<ObjCollision*> free,used;
+};
 
 class World{
 public:
@@ -27,9 +44,15 @@ public:
 		COLLISION_RESPONSE_SLIDEXZ=3,
 	};
 
+	World();
+	~World();
+
 	void clearCollisions();
 	void addCollision( int src_type,int dest_type,int method,int response );
 
+	//threads<=1 resolves collisions serially
+	void setThreads( int threads );
+
 	void update( float elapsed );
 	void capture();
 	void render( float tween );
@@ -37,16 +60,52 @@ public:
 	bool checkLOS( Object *src,Object *dest );
 	bool hitTest( const Line &line,float radius,Object *obj,const Transform &tf,int method,Collision *curr_coll  );
 	Object *traceRay( const Line &line,float radius,ObjCollision *curr_coll );
+	//traceRay for n lines at once; colls[k].collision.time limits line k on entry
+	void traceRays( const Line *lines,const float *radii,ObjCollision *colls,int n );
 
 private:
 	struct CollInfo{
 		int dst_type,method,response;
 	};
 
+	//outcome of resolving one mover, applied by commit()
+	struct CollJob{
+		Object *src;
+		//src side and dst side of each hit, in hit order
+		std::vector<ObjCollision*> colls;
+		bool move;
+		Vector pos;
+		//for validating a speculative (threaded) run
+		Vector start;
+		Box region;
+		float tris;
+		bool bailed;
+	};
+
 	std::vector<CollInfo> _collInfo[1000];
 	std::vector<Object*> _objsByType[1000];
+	//methods used against each type, as 1<<COLLISION_METHOD_*
+	int _collMethods[1000];
+	CollisionGrid _gridByType[1000];
+	//index of each enabled object in _objsByType, for keeping the grids current
+	std::vector<int> _slots;
+
+	WorkerPool *_workers;
+	std::vector<ObjCollisionPool*> _pools;
+	std::vector<std::vector<int> > _cands;
+	std::vector<CollJob> _jobs;
+	//enabled object indices with a collision type, and where targets moved,
+	//for updateThreaded
+	std::vector<int> _movers;
+	DirtyMap *_dirty;
+
+	PickIndex _picks;
+	std::vector<int> _pick_cands;
 
-	void collide( Object *src );
+	bool collide( Object *src,CollJob &job,ObjCollisionPool &pool,std::vector<int> &cands,bool speculate );
+	void commit( const CollJob &job,bool hoisted );
+	void updateSerial( float elapsed );
+	bool updateThreaded( float elapsed );
 	void render( Camera *c,Mirror *m );
 	void render( Model *m,const RenderContext &rc,bool sort_opaque=false );
 	void flushTransparent();
@@ -253,6 +253,7 @@ bool EGLContextDriver::graphicsLost(){
 }
 
 void EGLContextDriver::flip( bool vwait ){
+	bbGLFlush2D();
 	egl.swap();
 }
 
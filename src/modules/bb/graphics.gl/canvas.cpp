@@ -1,10 +1,13 @@
 #include "../stdutil/stdutil.h"
 #include <bb/graphics/font.h>
+#include <bb/graphics/pixels.h>
 #include "canvas.h"
 #include "graphics_util.h"
+#include <bb/profile/profile.h>
 #include <utf8.h>
 
 #include <cmath>
+#include <cstring>
 #include <map>
 #include <algorithm>
 
@@ -20,22 +23,22 @@ GLenum _cube_order[6]={
 	GL_TEXTURE_CUBE_MAP_POSITIVE_Y  // down (negative Y) face
 };
 
+// padded out to a whole std140 block
 struct UniformState{
-	float xywh[4];
 	float res[2];
-	float texscale[2];
-	float color[3];
-	int texenabled;
 	float scale[2];
+	int texenabled;
+	int pad[3];
 };
 
-struct Vertex{
-	float x,y;
-	float u,v;
-};
+// a batch that grows past this is drawn and started over
+static const size_t MAX_BATCH_VERTS=65536;
+
+// the resources holding queued primitives, if any
+static ContextResources *batch_res;
 
 static
-bool makeProgram( ContextResources *res,float sx,float sy,float tx,float ty,bool tex_enabled,float resx,float resy,float x,float y,float width,float height,float color[3] ){
+bool useProgram( ContextResources *res,const GLBatch2D &st ){
 	// Phase 1 Optimization: Use cached flag instead of glIsProgram() every frame
 	if( !res->program_initialized ){
 		std::string src( DEFAULT_GLSL,DEFAULT_GLSL+DEFAULT_GLSL_SIZE );
@@ -66,12 +69,9 @@ bool makeProgram( ContextResources *res,float sx,float sy,float tx,float ty,bool
 	GL( glUseProgram( res->default_program ) );
 
 	UniformState us={ 0 };
-	us.texscale[0]=tx;us.texscale[1]=ty;
-	us.texenabled=tex_enabled;
-	us.res[0]=resx;us.res[1]=resy;
-	us.xywh[0]=x;us.xywh[1]=y;us.xywh[2]=width;us.xywh[3]=height;
-	us.color[0]=color[0];us.color[1]=color[1];us.color[2]=color[2];
-	us.scale[0]=sx;us.scale[1]=sy;
+	us.res[0]=st.res[0];us.res[1]=st.res[1];
+	us.scale[0]=st.scale[0];us.scale[1]=st.scale[1];
+	us.texenabled=st.texture ? ( st.coverage ? 2 : 1 ) : 0;
 
 	if( res->ubo ){
 		GL( glBindBuffer( GL_UNIFORM_BUFFER,res->ubo ) );
@@ -120,25 +120,99 @@ void setTextureParams( ContextResources *res, GLuint texture, GLint min_filter,
 }
 
 static
-void initArrays( int size,GLuint* buffer,GLuint *array ){
-	if( !glIsVertexArray( buffer[0] ) ){
-		GL( glGenVertexArrays( size,array ) );
-		GL( glGenBuffers( size,buffer ) );
+void flushBatch( ContextResources *res ){
+	size_t n=res->batch.size();
+	if( !n ) return;
+
+	const GLBatch2D &st=res->batch_state;
+	if( !useProgram( res,st ) ){
+		res->batch.clear();
+		return;
+	}
 
-		for( int i=0;i<size;i++) {
-			GL( glBindVertexArray( array[i] ) );
-			GL( glBindBuffer( GL_ARRAY_BUFFER,buffer[i] ) );
+	if( !res->batch_array ){
+		GL( glGenVertexArrays( 1,&res->batch_array ) );
+		GL( glGenBuffers( 1,&res->batch_buffer ) );
 
-			GL( glEnableVertexAttribArray( 0 ) );
-			GL( glEnableVertexAttribArray( 1 ) );
+		GL( glBindVertexArray( res->batch_array ) );
+		GL( glBindBuffer( GL_ARRAY_BUFFER,res->batch_buffer ) );
 
-			GL( glVertexAttribPointer( 0,2,GL_FLOAT,GL_FALSE,sizeof(Vertex),0 ) );
-			GL( glVertexAttribPointer( 1,2,GL_FLOAT,GL_FALSE,sizeof(Vertex),(void*)offsetof( Vertex,u ) ) );
-		}
+		GL( glEnableVertexAttribArray( 0 ) );
+		GL( glEnableVertexAttribArray( 1 ) );
+		GL( glEnableVertexAttribArray( 2 ) );
+
+		GL( glVertexAttribPointer( 0,2,GL_FLOAT,GL_FALSE,sizeof(GLVertex2D),(void*)offsetof( GLVertex2D,x ) ) );
+		GL( glVertexAttribPointer( 1,2,GL_FLOAT,GL_FALSE,sizeof(GLVertex2D),(void*)offsetof( GLVertex2D,u ) ) );
+		GL( glVertexAttribPointer( 2,4,GL_UNSIGNED_BYTE,GL_TRUE,sizeof(GLVertex2D),(void*)offsetof( GLVertex2D,rgba ) ) );
+	}else{
+		GL( glBindVertexArray( res->batch_array ) );
+		GL( glBindBuffer( GL_ARRAY_BUFFER,res->batch_buffer ) );
 	}
+
+	// orphan last flush's storage rather than wait for the GPU to finish with it
+	size_t size=n*sizeof(GLVertex2D);
+	if( size>res->batch_capacity ){
+		res->batch_capacity=std::max( size,std::max( res->batch_capacity*2,(size_t)4096*sizeof(GLVertex2D) ) );
+	}
+	GL( glBufferData( GL_ARRAY_BUFFER,res->batch_capacity,0,GL_STREAM_DRAW ) );
+	GL( glBufferSubData( GL_ARRAY_BUFFER,0,size,res->batch.data() ) );
+
+	if( st.texture ){
+		GL( glActiveTexture( GL_TEXTURE0 ) );
+		GL( glBindTexture( GL_TEXTURE_2D,st.texture ) );
+	}
+	if( st.blend ){
+		GL( glEnable( GL_BLEND ) );
+		GL( glBlendFunc( GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA ) );
+	}
+#ifdef BB_DESKTOP
+	if( st.prim==GL_POINTS ){
+		GL( glEnable( GL_PROGRAM_POINT_SIZE ) );
+	}
+#endif
+
+	GL( glDrawArrays( st.prim,0,n ) );
+
+#ifdef BB_DESKTOP
+	if( st.prim==GL_POINTS ){
+		GL( glDisable( GL_PROGRAM_POINT_SIZE ) );
+	}
+#endif
+	if( st.blend ){
+		GL( glDisable( GL_BLEND ) );
+	}
+
+	GL( glBindVertexArray( 0 ) );
+	GL( glBindBuffer( GL_ARRAY_BUFFER,0 ) );
+
+	++bbStats2DFrame[STATS2D_DRAWS];
+	bbStats2DFrame[STATS2D_VERTICES]+=n;
+	res->batch.clear();
 }
 
-GLCanvas::GLCanvas( ContextResources *res,int w,int h,int f ):res(res),pixmap(0),mask(0),width(w),height(h),pixels(0),handle_x(0),handle_y(0),texture(0),framebuffer(0),mode(0),depthbuffer(0),cube_mode(0){
+void bbGLFlush2D(){
+	if( !batch_res ) return;
+	flushBatch( batch_res );
+	batch_res=0;
+}
+
+static inline
+bool sameBatch( const GLBatch2D &a,const GLBatch2D &b ){
+	return a.prim==b.prim && a.texture==b.texture && a.blend==b.blend && a.coverage==b.coverage &&
+		a.scale[0]==b.scale[0] && a.scale[1]==b.scale[1] &&
+		a.res[0]==b.res[0] && a.res[1]==b.res[1];
+}
+
+static inline
+void addVertex( std::vector<GLVertex2D> &batch,float x,float y,float u,float v,const unsigned char rgba[4] ){
+	GLVertex2D t;
+	t.x=x;t.y=y;
+	t.u=u;t.v=v;
+	memcpy( t.rgba,rgba,4 );
+	batch.push_back( t );
+}
+
+GLCanvas::GLCanvas( ContextResources *res,int w,int h,int f ):res(res),pixmap(0),mask(0),width(w),height(h),pixels(0),staging(0),write_only(false),written_count(0),stage_texture(0),stage_fbo(0),handle_x(0),handle_y(0),texture(0),framebuffer(0),mode(0),depthbuffer(0),cube_mode(0){
 	flags=f;
 
 	setOrigin( 0,0 );
@@ -148,6 +222,8 @@ GLCanvas::GLCanvas( ContextResources *res,int w,int h,int f ):res(res),pixmap(0)
 	vx=vy=0;
 	vw=w;vh=h;
 
+	color[0]=color[1]=color[2]=color[3]=255;
+
 	cube_face=0;
 	if( flags&CANVAS_TEX_CUBE ){
 		target=GL_TEXTURE_CUBE_MAP;
@@ -161,6 +237,9 @@ GLCanvas::GLCanvas( ContextResources *res,int f ):GLCanvas(res,0,0,f){
 
 
 GLCanvas::~GLCanvas(){
+	// queued draws may still sample or target this canvas
+	if( texture || depthbuffer ) bbGLFlush2D();
+
 	// depthbuffer is only ever set when framebufferId() created the FBO,
 	// so it doubles as the ownership flag (setFramebuffer() leaves it 0)
 	if( depthbuffer ){
@@ -168,11 +247,25 @@ GLCanvas::~GLCanvas(){
 		GL( glDeleteRenderbuffers( 1,&depthbuffer ) );
 	}
 	if( texture ) GL( glDeleteTextures( 1,&texture ) );
-	delete[] pixels;
+	freeStaging();
 	delete pixmap;
 }
 
+void GLCanvas::freeStaging(){
+	if( stage_fbo ){
+		GL( glDeleteFramebuffers( 1,&stage_fbo ) );
+	}
+	if( stage_texture ){
+		GL( glDeleteTextures( 1,&stage_texture ) );
+	}
+	stage_fbo=stage_texture=0;
+	delete[] staging;
+	staging=pixels=0;
+	written.clear();
+}
+
 void GLCanvas::resize( int w,int h,float d ){
+	if( w!=width || h!=height ) freeStaging();
 	width=w;height=h;
 }
 
@@ -186,9 +279,10 @@ void GLCanvas::setMask( unsigned argb ){
 }
 
 void GLCanvas::setColor( unsigned argb ){
-	color[0]=((argb>>16)&255)/255.0f;
-	color[1]=((argb>>8)&255)/255.0f;
-	color[2]=(argb&255)/255.0f;
+	color[0]=(argb>>16)&255;
+	color[1]=(argb>>8)&255;
+	color[2]=argb&255;
+	color[3]=255;
 }
 
 void GLCanvas::setClsColor( unsigned argb ){
@@ -215,112 +309,83 @@ void GLCanvas::setHandle( int x,int y ){
 }
 
 void GLCanvas::setViewport( int x,int y,int w,int h ){
+	bbGLFlush2D();
 	vx=x;vy=y;vw=w;vh=h;
 	GL( glViewport( x,height-y-h,w,h ) );
 	GL( glScissor( x,height-y-h,w,h ) );
 }
 
 void GLCanvas::cls(){
+	BB_PROFILE( "GLCanvas::draw" );
+	bbGLFlush2D();
 	GL( glClear( GL_COLOR_BUFFER_BIT ) );
 }
 
-void GLCanvas::plot( int x,int y ){
-	if( res->plot_buffer==0 ){
-		const Vertex vertices[1] = {
-			{ 0.0,0.0,0.0,0.0 }
-		};
-
-		initArrays( 1,&res->plot_buffer,&res->plot_array );
-		GL( glBindBuffer( GL_ARRAY_BUFFER,res->plot_buffer ) );
-		GL( glBufferData( GL_ARRAY_BUFFER,sizeof(vertices),vertices,GL_STATIC_DRAW ) );
+std::vector<GLVertex2D> &GLCanvas::batch( GLenum prim,GLuint tex,bool blend,bool primitive,bool coverage ){
+	GLBatch2D st;
+	st.prim=prim;
+	st.texture=tex;
+	st.blend=blend;
+	st.coverage=coverage;
+	st.scale[0]=scale_x;st.scale[1]=scale_y;
+	st.res[0]=width;st.res[1]=height;
+
+	if( batch_res!=res ) bbGLFlush2D();
+	if( res->batch.size() && ( !sameBatch( res->batch_state,st ) || res->batch.size()>=MAX_BATCH_VERTS ) ){
+		flushBatch( res );
 	}
+	res->batch_state=st;
+	batch_res=res;
 
-#ifdef BB_DESKTOP
-	GL( glEnable(GL_PROGRAM_POINT_SIZE) );
-#endif
-
-	makeProgram( res,scale_x,scale_y,1.0,1.0,false,width,height,x,y,1.0,1.0,color );
+	if( primitive ) ++bbStats2DFrame[STATS2D_PRIMITIVES];
+	return res->batch;
+}
 
-	GL( glBindVertexArray( res->plot_array ) );
-	GL( glDrawArrays( GL_POINTS,0,1 ) );
-	GL( glBindVertexArray( 0 ) );
+void GLCanvas::plot( int x,int y ){
+	BB_PROFILE( "GLCanvas::draw" );
+	std::vector<GLVertex2D> &b=batch( GL_POINTS,0,false );
+	addVertex( b,x,y,0.0f,0.0f,color );
 	flush();
-
-#ifdef BB_DESKTOP
-	GL( glDisable(GL_PROGRAM_POINT_SIZE) );
-#endif
 }
 
 void GLCanvas::line( int x,int y,int x2,int y2 ){
-	const Vertex vertices[2] = {
-		{ (float)x,(float)y,0.0,0.0 },
-		{ (float)x2,(float)y2,0.0,0.0 }
-	};
-
-	initArrays( 1,&res->line_buffer,&res->line_array );
-
-	GL( glBindBuffer( GL_ARRAY_BUFFER,res->line_buffer ) );
-	GL( glBufferData( GL_ARRAY_BUFFER,sizeof(vertices),vertices,GL_DYNAMIC_DRAW ) );
-
-	makeProgram( res,scale_x,scale_y,1.0,1.0,false,width,height,0.0,0.0,1.0,1.0,color );
-
-	GL( glBindVertexArray( res->line_array ) );
-	GL( glDrawArrays( GL_LINES,0,2 ) );
-	GL( glBindVertexArray( 0 ) );
+	BB_PROFILE( "GLCanvas::draw" );
+	std::vector<GLVertex2D> &b=batch( GL_LINES,0,false );
+	addVertex( b,x,y,0.0f,0.0f,color );
+	addVertex( b,x2,y2,0.0f,0.0f,color );
 	flush();
 }
 
 void GLCanvas::rect( int x,int y,int w,int h,bool solid ){
-	quad( x,y,w,h,solid,false,1.0,1.0,color );
+	BB_PROFILE( "GLCanvas::draw" );
+	float l=x,t=y,r=x+w,b=y+h;
+	if( solid ){
+		std::vector<GLVertex2D> &v=batch( GL_TRIANGLES,0,false );
+		addVertex( v,l,t,0.0f,0.0f,color );addVertex( v,l,b,0.0f,0.0f,color );addVertex( v,r,t,0.0f,0.0f,color );
+		addVertex( v,r,t,0.0f,0.0f,color );addVertex( v,l,b,0.0f,0.0f,color );addVertex( v,r,b,0.0f,0.0f,color );
+	}else{
+		std::vector<GLVertex2D> &v=batch( GL_LINES,0,false );
+		addVertex( v,l,t,0.0f,0.0f,color );addVertex( v,l,b,0.0f,0.0f,color );
+		addVertex( v,l,b,0.0f,0.0f,color );addVertex( v,r,b,0.0f,0.0f,color );
+		addVertex( v,r,b,0.0f,0.0f,color );addVertex( v,r,t,0.0f,0.0f,color );
+		addVertex( v,r,t,0.0f,0.0f,color );addVertex( v,l,t,0.0f,0.0f,color );
+	}
+	flush();
 }
 
 void GLCanvas::flush(){
 	// here to support FrontBuffer...
 	if( mode==GL_FRONT ){
+		bbGLFlush2D();
 		GL( glFlush() );
 	}
 }
 
-void GLCanvas::quad( int x,int y,int w,int h,bool solid,bool texenabled,float tx,float ty,float color[3] ){
-	static const Vertex vertices[2][4] = {
-		{
-			{ 0.0, 0.0, 0.0, 0.0 },
-			{ 0.0, 1.0, 0.0, 1.0 },
-			{ 1.0, 0.0, 1.0, 0.0 },
-			{ 1.0, 1.0, 1.0, 1.0 }
-		},
-		{
-			{ 0.0, 0.0, 0.0, 0.0 },
-			{ 0.0, 1.0, 0.0, 1.0 },
-			{ 1.0, 1.0, 1.0, 1.0 },
-			{ 1.0, 0.0, 1.0, 0.0 }
-		}
-	};
-
-	if( res->quad_buffer[0]==0 ){
-		initArrays( 2,res->quad_buffer,res->quad_array );
-
-		GL( glBindBuffer( GL_ARRAY_BUFFER,res->quad_buffer[0] ) );
-		GL( glBufferData( GL_ARRAY_BUFFER,sizeof(vertices[0]),vertices[0],GL_STATIC_DRAW ) );
-
-		GL( glBindBuffer( GL_ARRAY_BUFFER,res->quad_buffer[1] ) );
-		GL( glBufferData( GL_ARRAY_BUFFER,sizeof(vertices[1]),vertices[1],GL_STATIC_DRAW ) );
-
-		GL( glBindBuffer( GL_ARRAY_BUFFER,0 ) );
-	}
-
-	makeProgram( res,scale_x,scale_y,tx,ty,texenabled,width,height,x,y,w,h,color );
-
-	int i=solid?0:1;
-	GL( glBindVertexArray( res->quad_array[i] ) );
-	GL( glDrawArrays( solid?GL_TRIANGLE_STRIP:GL_LINE_LOOP,0,4 ) );
-	GL( glBindVertexArray( 0 ) );
-	flush();
-}
-
 void GLCanvas::oval( int x,int y,int w,int h,bool solid ){
+	BB_PROFILE( "GLCanvas::draw" );
 	int rx=w/2.0f,ry=h/2.0f;
 	int segs=abs(rx)+abs(ry);
+	if( segs<=0 ) return;
 
 	float theta = 2*3.1415926/float(segs);
 	float c=cosf(theta),s=sinf(theta),t;
@@ -329,120 +394,116 @@ void GLCanvas::oval( int x,int y,int w,int h,bool solid ){
 
 	float vx=1.0f,vy=0.0f;
 
-	std::vector<Vertex> verts;
-	for( int i=0;i<segs;i++ ){
-		verts.push_back( { vx*rx+x,vy*ry+y,0.0,0.0 } );
+	std::vector<GLVertex2D> ring( segs );
+	for( int i=segs-1;i>=0;i-- ){
+		ring[i].x=vx*rx+x;
+		ring[i].y=vy*ry+y;
 
 		t=vx;
 		vx=c*vx-s*vy;
 		vy=s*t+c*vy;
 	}
-	std::reverse( verts.begin(),verts.end() );
 
-	if( res->oval_buffer==0 ){
-		initArrays( 1,&res->oval_buffer,&res->oval_array );
+	if( solid ){
+		std::vector<GLVertex2D> &b=batch( GL_TRIANGLES,0,false );
+		for( int i=1;i+1<segs;i++ ){
+			addVertex( b,ring[0].x,ring[0].y,0.0f,0.0f,color );
+			addVertex( b,ring[i].x,ring[i].y,0.0f,0.0f,color );
+			addVertex( b,ring[i+1].x,ring[i+1].y,0.0f,0.0f,color );
+		}
+	}else{
+		std::vector<GLVertex2D> &b=batch( GL_LINES,0,false );
+		for( int i=0;i<segs;i++ ){
+			const GLVertex2D &p=ring[i],&q=ring[(i+1)%segs];
+			addVertex( b,p.x,p.y,0.0f,0.0f,color );
+			addVertex( b,q.x,q.y,0.0f,0.0f,color );
+		}
 	}
-
-	makeProgram( res,scale_x,scale_y,1.0,1.0,false,width,height,0.0,0.0,1.0,1.0,color );
-
-	GL( glBindBuffer( GL_ARRAY_BUFFER,res->oval_buffer ) );
-	GL( glBufferData( GL_ARRAY_BUFFER,sizeof(Vertex)*verts.size(),verts.data(),GL_DYNAMIC_DRAW ) );
-
-	GL( glBindVertexArray( res->oval_array ) );
-	GL( glDrawArrays( solid?GL_TRIANGLE_FAN:GL_LINE_LOOP,0,verts.size() ) );
-	GL( glBindVertexArray( 0 ) );
 	flush();
 }
 
-void GLCanvas::text( int x,int y,const std::string &t ){
-	if( !font || t.size()==0 ) return;
+//brings this context's copy of an atlas page up to date, uploading only what was packed since
+//this context's last upload. Other contexts keep their own copies, so the page itself isn't marked.
+static GLuint fontPage( ContextResources *res,BBImageFont::Page *p ){
+	GLFontPage &copy=res->font_pages[p->serial];
+	if( copy.texture && copy.version==p->version ) return copy.texture;
 
-	unsigned int texture;
-	if( res->font_textures.count(font)==0 ){
-		GL( glGenTextures( 1,&texture ) );
-		res->font_textures[font]=texture;
-	}else{
-		texture=res->font_textures[font];
-	}
+	// queued text may still be drawn from the page
+	bbGLFlush2D();
 
 	GL( glActiveTexture( GL_TEXTURE0 ) );
-	GL( glBindTexture( GL_TEXTURE_2D,texture ) );
-
-	if( font->loadChars( t ) ){
-		font->rebuildAtlas();
-		if( font->atlas ){
-			int size=font->atlas->width*font->atlas->height;
-			std::vector<unsigned char> bmp( size*4 );
-			for( int i=0;i<font->atlas->width*font->atlas->height;i++ ){
-				bmp[i*4+0]=bmp[i*4+1]=bmp[i*4+2]=255;
-				bmp[i*4+3]=font->atlas->bits[i];
-			}
-
-			GL( glPixelStorei( GL_UNPACK_ALIGNMENT,1 ) );
-			GL( glTexImage2D( GL_TEXTURE_2D,0,GL_RGBA,font->atlas->width,font->atlas->height,0,GL_RGBA,GL_UNSIGNED_BYTE,bmp.data() ) );
-			// Phase 1 Optimization: Use cached texture parameters
-			setTextureParams( res, texture, GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE );
-		}
+	if( !copy.texture ){
+		GL( glGenTextures( 1,&copy.texture ) );
+		GL( glBindTexture( GL_TEXTURE_2D,copy.texture ) );
+		GL( glTexImage2D( GL_TEXTURE_2D,0,GL_R8,p->width,p->height,0,GL_RED,GL_UNSIGNED_BYTE,0 ) );
+		// Phase 1 Optimization: Use cached texture parameters
+		setTextureParams( res,copy.texture,GL_LINEAR,GL_LINEAR,GL_CLAMP_TO_EDGE,GL_CLAMP_TO_EDGE );
+	}else{
+		GL( glBindTexture( GL_TEXTURE_2D,copy.texture ) );
 	}
-	if( !font->atlas ) return;
-
-	std::vector<Vertex> verts;
-
-	y+=font->baseline*font->density;
-
-	float awidth=font->atlas->width,aheight=font->atlas->height;
 
-	const char *c=t.c_str();
-	utf8_int32_t curr=0,prev=0;
-	while( *c ){
-		prev=curr;
-		c=utf8codepoint( c,&curr );
-		BBImageFont::Char c=font->getChar( curr );
+	//shelves from before an eviction are gone, so everything packed since comes across
+	if( copy.clears!=p->clears ) copy.shelves.clear();
 
-		float cx=x+c.bearing_x*font->density,cy=y-c.bearing_y*font->density;
-
-		if( prev>0 ){
-			cx+=font->getKerning( prev,curr );
-		}
+	int x0=p->width,y0=p->height,x1=0,y1=0;
+	for( int i=0;i<p->shelves.size();i++ ){
+		const BBImageFont::Page::Shelf &s=p->shelves[i];
+		int from=i<copy.shelves.size() ? copy.shelves[i] : 0;
+		if( s.x<=from ) continue;
+		x0=std::min( x0,from );x1=std::max( x1,s.x );
+		y0=std::min( y0,s.y );y1=std::max( y1,s.y+s.height );
+	}
 
-		float l=c.x/awidth;
-		float r=(c.x+c.width)/awidth;
-		float t=c.y/aheight;
-		float b=(c.y+c.height)/aheight;
+	if( x0<x1 ){
+		GL( glPixelStorei( GL_UNPACK_ALIGNMENT,1 ) );
+		GL( glPixelStorei( GL_UNPACK_ROW_LENGTH,p->width ) );
+		GL( glTexSubImage2D( GL_TEXTURE_2D,0,x0,y0,x1-x0,y1-y0,GL_RED,GL_UNSIGNED_BYTE,p->bits+y0*p->width+x0 ) );
+		GL( glPixelStorei( GL_UNPACK_ROW_LENGTH,0 ) );
+	}
 
-		Vertex lb={ cx,cy+c.height*font->density,l,b },
-		       rb={ cx+c.width*font->density,cy+c.height*font->density,r,b },
-		       rt={ cx+c.width*font->density,cy,r,t },
-		       lt={ cx,cy,l,t };
+	copy.version=p->version;
+	copy.clears=p->clears;
+	copy.shelves.resize( p->shelves.size() );
+	for( int i=0;i<p->shelves.size();i++ ) copy.shelves[i]=p->shelves[i].x;
 
-		verts.push_back( lb );verts.push_back( rb );verts.push_back( rt );
-		verts.push_back( lb );verts.push_back( rt );verts.push_back( lt );
+	return copy.texture;
+}
 
-		x+=c.advance*font->density;
-	}
+void GLCanvas::text( int x,int y,const std::string &t ){
+	BB_PROFILE( "GLCanvas::draw" );
+	if( !font || t.size()==0 ) return;
 
-	GL( glEnable( GL_BLEND ) );
-	GL( glBlendFunc( GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA ) );
+	const BBImageFont::Run &run=font->layout( t );
+	if( run.quads.empty() ) return;
 
-	if( res->text_buffer==0 ){
-		initArrays( 1,&res->text_buffer,&res->text_array );
+	//upload before queueing, an upload flushes the batch
+	for( int i=0;i<run.pages.size();i++ ){
+		fontPage( res,font->pages[run.pages[i]] );
 	}
 
-	makeProgram( res,scale_x,scale_y,1.0,1.0,true,width,height,0.0,0.0,1.0,1.0,color );
+	std::vector<GLVertex2D> *b=0;
+	int page=-1;
+	for( int i=0;i<run.quads.size();i++ ){
+		const BBImageFont::Quad &q=run.quads[i];
+		if( q.page!=page ){
+			page=q.page;
+			b=&batch( GL_TRIANGLES,fontPage( res,font->pages[page] ),true,b==0,true );
+		}
 
-	GL( glBindBuffer( GL_ARRAY_BUFFER,res->text_buffer ) );
-	GL( glBufferData( GL_ARRAY_BUFFER,sizeof(Vertex)*verts.size(),verts.data(),GL_DYNAMIC_DRAW ) );
-	GL( glBindBuffer( GL_ARRAY_BUFFER,0 ) );
+		float x0=x+q.x0,x1=x+q.x1;
+		float y0=y+q.y0,y1=y+q.y1;
 
-	GL( glBindVertexArray( res->text_array ) );
-	GL( glDrawArrays( GL_TRIANGLES,0,verts.size() ) );
-	GL( glBindVertexArray( 0 ) );
+		addVertex( *b,x0,y1,q.u0,q.v1,color );addVertex( *b,x1,y1,q.u1,q.v1,color );addVertex( *b,x1,y0,q.u1,q.v0,color );
+		addVertex( *b,x0,y1,q.u0,q.v1,color );addVertex( *b,x1,y0,q.u1,q.v0,color );addVertex( *b,x0,y0,q.u0,q.v0,color );
+	}
 
-	GL( glDisable( GL_BLEND ) );
 	flush();
 }
 
 void GLCanvas::blit( int x,int y,BBCanvas *s,int src_x,int src_y,int src_w,int src_h,bool solid ){
+	BB_PROFILE( "GLCanvas::draw" );
+	bbGLFlush2D();
+
 	uint32_t cfb;
 	GL( glGetIntegerv( GL_FRAMEBUFFER_BINDING,(GLint*)&cfb ) );
 
@@ -496,22 +557,23 @@ void GLCanvas::blit( int x,int y,BBCanvas *s,int src_x,int src_y,int src_w,int s
 }
 
 void GLCanvas::image( BBCanvas *c,int x,int y,bool solid ){
+	BB_PROFILE( "GLCanvas::draw" );
 	GLCanvas *src=(GLCanvas*)c;
 
-
 	GL( glActiveTexture( GL_TEXTURE0 ) );
 	src->bind();
 
-	GL( glEnable( GL_BLEND ) );
-	GL( glBlendFunc( GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA ) );
-
 	// Phase 1 Optimization: Use cached texture parameters
 	setTextureParams( res, src->texture, GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE );
 
-	float white[3]={ 1.0,1.0,1.0 };
-	quad( x-src->handle_x,y-src->handle_y,src->getWidth(),src->getHeight(),true,true,1.0,1.0,white );
+	static const unsigned char white[4]={ 255,255,255,255 };
+	float l=x-src->handle_x,t=y-src->handle_y;
+	float r=l+src->getWidth(),b=t+src->getHeight();
 
-	GL( glDisable( GL_BLEND ) );
+	std::vector<GLVertex2D> &v=batch( GL_TRIANGLES,src->texture,true );
+	addVertex( v,l,t,0.0f,0.0f,white );addVertex( v,l,b,0.0f,1.0f,white );addVertex( v,r,t,1.0f,0.0f,white );
+	addVertex( v,r,t,1.0f,0.0f,white );addVertex( v,l,b,0.0f,1.0f,white );addVertex( v,r,b,1.0f,1.0f,white );
+	flush();
 }
 
 // Helper function to ensure collision pixel data is available
@@ -537,7 +599,8 @@ static unsigned char* ensureCollisionPixels(GLCanvas *canvas) {
 		canvas->pixmap->bits = new unsigned char[w * h * 4];
 
 		if (canvas->pixmap->bits) {
-			// Bind the texture and read pixels
+			// Bind the texture and read pixels, once anything queued to it is drawn
+			bbGLFlush2D();
 			glBindTexture(GL_TEXTURE_2D, canvas->texture);
 			glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, canvas->pixmap->bits);
 			return (unsigned char*)canvas->pixmap->bits;
@@ -666,30 +729,42 @@ bool GLCanvas::rect_collide( int x,int y,int rect_x,int rect_y,int rect_w,int re
 	return collision;
 }
 
-bool GLCanvas::lock(){
+bool GLCanvas::lock( bool write_only ){
 	if( pixels ) return false;
 
-	pixels=new unsigned char[width*height*4];
+	bbGLFlush2D();
 
-	// Only download data if this canvas has existing content
-	// For new canvases (no texture, not a framebuffer like BackBuffer),
-	// just initialize to zero - tformCanvas will fill it
-	if( texture || mode == GL_FRONT || mode == GL_BACK ){
-		// Flush all pending GL commands before reading pixels
-		GL( glFinish() );
+	// a loaded image may not have made its texture yet
+	if( !texture && pixmap ) textureId();
+
+	if( !staging ) staging=new unsigned char[width*height*4]();
+	pixels=staging;
+	written_x0=width;written_y0=height;
+	written_x1=written_y1=0;
+
+	// write only: skip the readback when unlock() sends back just the written
+	// rect. Textures due a rebuild, cube maps and new canvases go up whole, so
+	// they still need everything read back (or cleared)
+	bool display=mode == GL_FRONT || mode == GL_BACK;
+	this->write_only=write_only && ( texture ? !dirty && target==GL_TEXTURE_2D : display );
+	if( this->write_only ){
+		if( written.empty() ) written.assign( width*height,0 );
+		written_count=0;
+		return true;
+	}
+	if( texture || display ){
 		downloadData();
 	} else {
-		// New canvas - initialize to transparent black
-		memset(pixels, 0, width*height*4);
+		memset( pixels,0,width*height*4 );
 	}
 	return true;
 }
 
 void GLCanvas::setPixel( int x,int y,unsigned argb ){
-	// RTEX( "GLCanvas::setPixel not implemented" );
-	lock();
+	// only the one pixel goes up
+	bool l=lock( true );
 	setPixelFast( x,y,argb );
-	unlock();
+	if( l ) unlock();
 }
 
 #define UC(c) static_cast<unsigned char>(c)
@@ -705,6 +780,15 @@ void GLCanvas::setPixelFast( int x,int y,unsigned argb ){
 	p[1] = (argb >> 8) & 0xFF; // G
 	p[2] = (argb >> 16) & 0xFF; // R
 	p[3] = (argb >> 24) & 0xFF; // A
+
+	if( write_only ){
+		unsigned char &m=written[fy*width+x];
+		if( !m ){ m=1;++written_count; }
+	}
+	if( x<written_x0 ) written_x0=x;
+	if( x>=written_x1 ) written_x1=x+1;
+	if( y<written_y0 ) written_y0=y;
+	if( y>=written_y1 ) written_y1=y+1;
 }
 
 void GLCanvas::copyPixel( int x,int y,BBCanvas *src,int src_x,int src_y ){
@@ -716,10 +800,16 @@ void GLCanvas::copyPixelFast( int x,int y,BBCanvas *src,int src_x,int src_y ){
 }
 
 unsigned GLCanvas::getPixel( int x,int y ){
-	lock();
-	unsigned result = getPixelFast( x, y );
-	unlock();
-	return result;
+	if( pixels ) return getPixelFast( x,y );
+	if( x<0 || x>=width || y<0 || y>=height ) return 0;
+
+	// read back just the one pixel rather than locking the whole surface
+	unsigned argb=0;
+	if( !texture && pixmap ) textureId();
+	if( texture || mode == GL_FRONT || mode == GL_BACK ){
+		readback( x,height-1-y,1,1,&argb );
+	}
+	return argb;
 }
 
 unsigned GLCanvas::getPixelFast( int x,int y ){
@@ -735,55 +825,129 @@ unsigned GLCanvas::getPixelFast( int x,int y ){
 void GLCanvas::unlock(){
 	if( !pixels ) return;
 
-
-	// For framebuffer-based canvas (like BackBuffer), we need to write pixels back
-	// Note: framebuffer=0 is the default framebuffer (BackBuffer), but for a canvas
-	// created with createCanvas, framebuffer starts at 0 too. We need to check mode
-	// to distinguish: mode is GL_FRONT or GL_BACK for default framebuffer.
-	if( !texture && (mode == GL_FRONT || mode == GL_BACK) ){
-		// Use texture + glBlitFramebuffer approach (works in Core Profile)
-		// pixels is in BGRA format, convert to RGBA for texture upload
-		unsigned char *rgba = new unsigned char[width * height * 4];
-		for( int i = 0; i < width * height; i++ ){
-			rgba[i*4 + 0] = pixels[i*4 + 2]; // R
-			rgba[i*4 + 1] = pixels[i*4 + 1]; // G
-			rgba[i*4 + 2] = pixels[i*4 + 0]; // B
-			rgba[i*4 + 3] = 255; // A
+	if( written_x0<written_x1 && written_y0<written_y1 ){
+		// the written rect in GL's bottom up rows
+		int x0=written_x0,w=written_x1-written_x0;
+		int y0=height-written_y1,h=written_y1-written_y0;
+		unsigned char *rect=pixels+(y0*width+x0)*4;
+
+		if( write_only ){
+			// fill in the pixels of the rect that weren't written
+			if( written_count<w*h ){
+				std::vector<unsigned> back( w*h );
+				readback( x0,y0,w,h,back.data() );
+				for( int j=0;j<h;j++ ){
+					const unsigned char *m=written.data()+(y0+j)*width+x0;
+					unsigned *p=(unsigned*)rect+j*width;
+					for( int i=0;i<w;i++ ) if( !m[i] ) p[i]=back[j*w+i];
+				}
+			}
+			for( int j=0;j<h;j++ ) memset( written.data()+(y0+j)*width+x0,0,w );
 		}
 
-		// Create temporary texture and framebuffer for blitting
-		GLuint tempTex, tempFbo;
-		GL( glGenTextures( 1, &tempTex ) );
-		GL( glBindTexture( GL_TEXTURE_2D, tempTex ) );
-		GL( glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba ) );
-		GL( glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST ) );
-		GL( glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST ) );
-
-		GL( glGenFramebuffers( 1, &tempFbo ) );
-		GL( glBindFramebuffer( GL_READ_FRAMEBUFFER, tempFbo ) );
-		GL( glFramebufferTexture2D( GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tempTex, 0 ) );
-
-		// Bind destination framebuffer
-		GL( glBindFramebuffer( GL_DRAW_FRAMEBUFFER, framebuffer ) );
-		if( framebuffer == 0 ){
-			GL( glDrawBuffer( mode ) );
-		}
+		// For framebuffer-based canvas (like BackBuffer), we need to write pixels back
+		// Note: framebuffer=0 is the default framebuffer (BackBuffer), but for a canvas
+		// created with createCanvas, framebuffer starts at 0 too. We need to check mode
+		// to distinguish: mode is GL_FRONT or GL_BACK for default framebuffer.
+		if( !texture && (mode == GL_FRONT || mode == GL_BACK) ){
+			// the display stays opaque
+			for( int j=0;j<h;j++ ){
+				unsigned char *p=rect+j*width*4+3;
+				for( int i=0;i<w;i++ ) p[i*4]=255;
+			}
 
-		// Blit from temp texture to target framebuffer
-		GL( glBlitFramebuffer( 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST ) );
+			// Upload to a texture kept for the purpose and blit from it (works in Core Profile)
+			if( !stage_texture ){
+				GL( glGenTextures( 1,&stage_texture ) );
+				GL( glBindTexture( GL_TEXTURE_2D,stage_texture ) );
+				GL( glTexImage2D( GL_TEXTURE_2D,0,GL_RGBA,width,height,0,GL_BGRA,GL_UNSIGNED_BYTE,0 ) );
+				GL( glTexParameteri( GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST ) );
+				GL( glTexParameteri( GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST ) );
+
+				GL( glGenFramebuffers( 1,&stage_fbo ) );
+				GL( glBindFramebuffer( GL_READ_FRAMEBUFFER,stage_fbo ) );
+				GL( glFramebufferTexture2D( GL_READ_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,stage_texture,0 ) );
+			}else{
+				GL( glBindTexture( GL_TEXTURE_2D,stage_texture ) );
+			}
 
-		// Cleanup
-		GL( glBindFramebuffer( GL_FRAMEBUFFER, framebuffer ) );
-		GL( glDeleteFramebuffers( 1, &tempFbo ) );
-		GL( glDeleteTextures( 1, &tempTex ) );
+			GL( glPixelStorei( GL_UNPACK_ROW_LENGTH,width ) );
+			GL( glTexSubImage2D( GL_TEXTURE_2D,0,x0,y0,w,h,GL_BGRA,GL_UNSIGNED_BYTE,rect ) );
+			GL( glPixelStorei( GL_UNPACK_ROW_LENGTH,0 ) );
 
-		delete[] rgba;
-	} else {
-		// Regular texture canvas
-		uploadData();
+			GL( glBindFramebuffer( GL_READ_FRAMEBUFFER,stage_fbo ) );
+			GL( glBindFramebuffer( GL_DRAW_FRAMEBUFFER,framebuffer ) );
+			if( framebuffer == 0 ){
+				GL( glDrawBuffer( mode ) );
+			}
+			GL( glBlitFramebuffer( x0,y0,x0+w,y0+h,x0,y0,x0+w,y0+h,GL_COLOR_BUFFER_BIT,GL_NEAREST ) );
+
+			GL( glBindFramebuffer( GL_FRAMEBUFFER,framebuffer ) );
+		} else if( !texture || target!=GL_TEXTURE_2D || dirty ){
+			// no texture yet, or one that wants rebuilding anyway
+			uploadData();
+		} else {
+			// queued draws sample the texture as it is now
+			bbGLFlush2D();
+
+			GL( glActiveTexture( GL_TEXTURE0 ) );
+			GL( glBindTexture( GL_TEXTURE_2D,texture ) );
+			GL( glPixelStorei( GL_UNPACK_ROW_LENGTH,width ) );
+			GL( glTexSubImage2D( GL_TEXTURE_2D,0,x0,y0,w,h,GL_BGRA,GL_UNSIGNED_BYTE,rect ) );
+			GL( glPixelStorei( GL_UNPACK_ROW_LENGTH,0 ) );
+			GL( glGenerateMipmap( GL_TEXTURE_2D ) );
+		}
 	}
-	delete[] pixels;
+
+	// staging stays around for the next lock
 	pixels = 0;
+	write_only = false;
+}
+
+// pixels are ARGB ints bottom up, so a rect is a run of rows converted in place
+void GLCanvas::readPixels( int x,int y,int w,int h,void *dst,int pitch,int format ){
+	int offset;
+	if( !clipPixels( x,y,w,h,offset,pitch,format ) ) return;
+
+	if( pixels ){
+		const unsigned *rows=(const unsigned*)pixels;
+		for( int j=0;j<h;j++ ){
+			bbPixelsFromARGB( rows+(height-1-y-j)*width+x,(char*)dst+offset+j*pitch,w,format );
+		}
+		return;
+	}
+
+	// not locked: read back just the rect
+	std::vector<unsigned> rect( w*h );
+	if( !texture && pixmap ) textureId();
+	if( texture || mode == GL_FRONT || mode == GL_BACK ){
+		readback( x,height-y-h,w,h,rect.data() );
+	}
+	for( int j=0;j<h;j++ ){
+		bbPixelsFromARGB( rect.data()+(h-1-j)*w,(char*)dst+offset+j*pitch,w,format );
+	}
+}
+
+void GLCanvas::writePixels( int x,int y,int w,int h,const void *src,int pitch,int format ){
+	int offset;
+	if( !clipPixels( x,y,w,h,offset,pitch,format ) ) return;
+
+	// the whole rect gets written, so there's nothing to read back
+	bool l=lock( true );
+	unsigned *rows=(unsigned*)pixels;
+	for( int j=0;j<h;j++ ){
+		int fy=height-1-y-j;
+		bbPixelsToARGB( (const char*)src+offset+j*pitch,rows+fy*width+x,w,format );
+		if( write_only ){
+			unsigned char *m=written.data()+fy*width+x;
+			for( int i=0;i<w;i++ ) if( !m[i] ){ m[i]=1;++written_count; }
+		}
+	}
+	if( x<written_x0 ) written_x0=x;
+	if( x+w>written_x1 ) written_x1=x+w;
+	if( y<written_y0 ) written_y0=y;
+	if( y+h>written_y1 ) written_y1=y+h;
+	if( l ) unlock();
 }
 
 void GLCanvas::setCubeMode( int mode ){
@@ -842,6 +1006,7 @@ unsigned GLCanvas::getClsColor()const{
 }
 
 void GLCanvas::set(){
+	bbGLFlush2D();
 	GL( glBindFramebuffer( GL_FRAMEBUFFER,framebufferId() ) );
 	if( mode!=GL_FRONT&&mode!=GL_BACK ){
 		const GLenum modes[1]{ mode };
@@ -852,6 +1017,7 @@ void GLCanvas::set(){
 }
 
 void GLCanvas::unset(){
+	bbGLFlush2D();
 	flush();
 
 	// if( !pixmap ){
@@ -887,6 +1053,9 @@ void GLCanvas::unset(){
 void GLCanvas::uploadData(){
 	if( texture && target!=GL_TEXTURE_2D ) return;
 
+	// queued draws sample the texture as it is now
+	bbGLFlush2D();
+
 	BBPixmap *pm=0;
 	void *data=0;
 
@@ -950,22 +1119,21 @@ void GLCanvas::uploadData(){
 	dirty=false;
 }
 
+void GLCanvas::readback( int x,int y,int w,int h,void *bits ){
+	bbGLFlush2D();
+	unsigned int fbo = framebufferId();
+	GL( glBindFramebuffer( GL_FRAMEBUFFER,fbo ) );
+	// For default framebuffer (0), need to set read buffer
+	if( fbo == 0 ){
+		GL( glReadBuffer( mode ) );  // GL_FRONT or GL_BACK
+	}
+	GL( glReadPixels( x,y,w,h,GL_BGRA,GL_UNSIGNED_BYTE,bits ) );
+}
+
 void GLCanvas::downloadData(){
 	// Always read into pixels if it exists (for getPixelFast), otherwise pixmap->bits
 	void *bits=pixels?pixels:(pixmap?pixmap->bits:0);
-	if( bits ){
-		unsigned int fbo = framebufferId();
-		GL( glBindFramebuffer( GL_FRAMEBUFFER,fbo ) );
-		// For default framebuffer (0), need to set read buffer
-		if( fbo == 0 ){
-			GL( glReadBuffer( mode ) );  // GL_FRONT or GL_BACK
-		}
-		GL( glReadPixels( 0,0,width,height,GL_BGRA,GL_UNSIGNED_BYTE,bits ) );
-		// Debug: check what was read - center pixel
-		unsigned char *p = (unsigned char*)bits;
-		int cx = width/2, cy = height/2;
-		unsigned char *pc = p + (cy * width + cx) * 4;
-	}
+	if( bits ) readback( 0,0,width,height,bits );
 }
 
 unsigned int GLCanvas::textureId(){
@@ -12,6 +12,19 @@ protected:
 
 	int width,height;
 	mutable unsigned char *pixels;
+
+	// lock() points pixels at staging, which outlives the lock; unlock()
+	// sends back only the rect written in between
+	unsigned char *staging;
+	int written_x0,written_y0,written_x1,written_y1;
+	// a write only lock skips the readback, so it marks each pixel it sets;
+	// unlock() reads back the rest of the written rect, if there is any
+	bool write_only;
+	std::vector<unsigned char> written;
+	int written_count;
+	unsigned int stage_texture,stage_fbo;	// blit source for the display
+	void freeStaging();
+	void readback( int x,int y,int w,int h,void *bits );
 	BBImageFont *font;
 
 	unsigned framebuffer, mode;
@@ -21,12 +34,14 @@ protected:
 	int origin_x,origin_y;
 	int handle_x,handle_y;
 	int mask;
-	float color[3];
+	unsigned char color[4];
 	bool dirty;
 
 	void flush();
 
-	void quad( int x,int y,int w,int h,bool solid,bool tex,float tx,float ty,float color[3] );
+	// the queue to add a primitive's vertices to, drawing what's queued first
+	// if it doesn't share this state
+	std::vector<GLVertex2D> &batch( GLenum prim,GLuint texture,bool blend,bool primitive=true,bool coverage=false );
 public:
 	GLCanvas( ContextResources *res,int f );
 	GLCanvas( ContextResources *res,int w,int h,int f );
@@ -80,7 +95,7 @@ public:
 	bool collide( int x,int y,const BBCanvas *src,int src_x,int src_y,bool solid );
 	bool rect_collide( int x,int y,int rect_x,int rect_y,int rect_w,int rect_h,bool solid );
 
-	bool lock();
+	bool lock( bool write_only=false );
 	void setPixel( int x,int y,unsigned argb );
 	void setPixelFast( int x,int y,unsigned argb );
 	void copyPixel( int x,int y,BBCanvas *src,int src_x,int src_y );
@@ -89,6 +104,9 @@ public:
 	unsigned getPixelFast( int x,int y );
 	void unlock();
 
+	void readPixels( int x,int y,int w,int h,void *dst,int pitch,int format );
+	void writePixels( int x,int y,int w,int h,const void *src,int pitch,int format );
+
 	void setCubeMode( int mode );
 	void setCubeFace( int face );
 
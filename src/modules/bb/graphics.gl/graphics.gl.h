@@ -3,6 +3,7 @@
 
 #include <bb/graphics/graphics.h>
 #include <map>
+#include <vector>
 
 #ifdef BB_DESKTOP
 #include <GL/glew.h>
@@ -45,15 +46,42 @@ const char * bbGLFramebufferStatusString( GLenum status );
 #define GL( func ) func; bbGLGraphicsCheckErrors( __FILE__,__LINE__ );
 #endif
 
+// 2D vertex, in canvas pixels
+struct GLVertex2D{
+	float x,y;
+	float u,v;
+	unsigned char rgba[4];
+};
+
+// state every vertex in a 2D batch shares
+struct GLBatch2D{
+	GLenum prim;
+	GLuint texture;
+	bool blend;
+	bool coverage;	// texture is a font page, red is the glyph coverage
+	float scale[2],res[2];
+};
+
+// one context's copy of a font atlas page
+struct GLFontPage{
+	GLuint texture;
+	unsigned int version,clears;	// the page's, as of the last upload
+	std::vector<int> shelves;	// how far each shelf was filled then
+};
+
 struct ContextResources{
 	unsigned int ubo;
 	GLuint default_program;
-	GLuint plot_buffer,plot_array;
-	GLuint line_buffer,line_array;
-	GLuint quad_buffer[2],quad_array[2];
-	GLuint oval_buffer,oval_array;
-	GLuint text_buffer,text_array;
-	std::map<BBImageFont*,unsigned int> font_textures;
+
+	// 2D primitives queued by GLCanvas, drawn in one go when the state changes;
+	// see bbGLFlush2D
+	GLuint batch_buffer,batch_array;
+	size_t batch_capacity;
+	GLBatch2D batch_state;
+	std::vector<GLVertex2D> batch;
+
+	// font atlas pages by BBImageFont::Page::serial
+	std::map<unsigned int,GLFontPage> font_pages;
 
 	// Phase 1 Optimization: Cached uniform locations (avoid glGetUniformLocation per frame)
 	bool program_initialized;
@@ -68,6 +96,12 @@ struct ContextResources{
 	GLint tex_wrap_t;
 };
 
+// draws whatever 2D primitives are still queued. Anything that reads back,
+// clears or retargets what they draw to, or draws with GL itself, calls this
+// first: canvases do it for their own state changes, the 3D scene before it
+// renders, and the context drivers before they present.
+void bbGLFlush2D();
+
 #include "canvas.h"
 
 class GLGraphics:public BBGraphics{
@@ -259,6 +259,7 @@ bool SDLContextDriver::graphicsLost(){
 }
 
 void SDLContextDriver::flip( bool vwait ){
+	bbGLFlush2D();
 	if( SDL_GL_SetSwapInterval( vwait ? -1 : 0 )==-1 ){
 		SDL_GL_SetSwapInterval( 1 );
 	}
@@ -1,4 +1,7 @@
 #include "canvas.h"
+#include "pixels.h"
+
+#include <vector>
 
 BBCanvas::~BBCanvas(){
 }
@@ -9,3 +12,41 @@ void BBCanvas::getLogicalViewport( int *x,int *y,int *w,int *h )const{
 	getViewport( x,y,w,h );
 	*x/=sx;*y/=sy;*w/=sx;*h/=sy;
 }
+
+bool BBCanvas::clipPixels( int &x,int &y,int &w,int &h,int &offset,int pitch,int format )const{
+	int bpp=bbPixelsBytes( format );
+	if( !bpp ) return false;
+
+	offset=0;
+	if( x<0 ){ offset-=x*bpp;w+=x;x=0; }
+	if( y<0 ){ offset-=y*pitch;h+=y;y=0; }
+	if( x+w>getWidth() ) w=getWidth()-x;
+	if( y+h>getHeight() ) h=getHeight()-y;
+	return w>0 && h>0;
+}
+
+void BBCanvas::readPixels( int x,int y,int w,int h,void *dst,int pitch,int format ){
+	int offset;
+	if( !clipPixels( x,y,w,h,offset,pitch,format ) ) return;
+
+	bool l=lock();
+	std::vector<unsigned> row( w );
+	for( int j=0;j<h;j++ ){
+		for( int i=0;i<w;i++ ) row[i]=getPixelFast( x+i,y+j );
+		bbPixelsFromARGB( row.data(),(char*)dst+offset+j*pitch,w,format );
+	}
+	if( l ) unlock();
+}
+
+void BBCanvas::writePixels( int x,int y,int w,int h,const void *src,int pitch,int format ){
+	int offset;
+	if( !clipPixels( x,y,w,h,offset,pitch,format ) ) return;
+
+	bool l=lock( true );
+	std::vector<unsigned> row( w );
+	for( int j=0;j<h;j++ ){
+		bbPixelsToARGB( (const char*)src+offset+j*pitch,row.data(),w,format );
+		for( int i=0;i<w;i++ ) setPixelFast( x+i,y+j,row[i] );
+	}
+	if( l ) unlock();
+}
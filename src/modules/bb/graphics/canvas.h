@@ -46,6 +46,13 @@ public:
     CUBESPACE_WORLD=0
   };
 
+  //layouts for readPixels/writePixels, rows packed top down
+  enum{
+    PIXELS_ARGB=1,	//32 bit ints, as ReadPixelFast returns them
+    PIXELS_RGBA=2,	//bytes in R,G,B,A order, as image files and GL want them
+    PIXELS_R8=3		//one byte per pixel: red when read, opaque grey when written
+  };
+
 	virtual void unset()=0;
 	virtual void set()=0;
 
@@ -71,7 +78,8 @@ public:
 	virtual bool collide( int x,int y,const BBCanvas *src,int src_x,int src_y,bool solid )=0;
 	virtual bool rect_collide( int x,int y,int rect_x,int rect_y,int rect_w,int rect_h,bool solid )=0;
 
-	virtual bool lock()=0;
+	//write_only skips reading the surface back; pixels not written read as undefined
+	virtual bool lock( bool write_only=false )=0;
 	virtual void setPixel( int x,int y,unsigned argb )=0;
 	virtual void setPixelFast( int x,int y,unsigned argb )=0;
 	virtual void copyPixel( int x,int y,BBCanvas *src,int src_x,int src_y )=0;
@@ -80,6 +88,10 @@ public:
 	virtual unsigned getPixelFast( int x,int y )=0;
 	virtual void unlock()=0;
 
+	//bulk transfer of a rect, locking around it if need be; pitch is in bytes
+	virtual void readPixels( int x,int y,int w,int h,void *dst,int pitch,int format );
+	virtual void writePixels( int x,int y,int w,int h,const void *src,int pitch,int format );
+
 	virtual void setCubeMode( int mode )=0;
 	virtual void setCubeFace( int face )=0;
 
@@ -98,6 +110,10 @@ public:
 	virtual unsigned getColor()const=0;
 	virtual unsigned getClsColor()const=0;
 
+protected:
+	bool clipPixels( int &x,int &y,int &w,int &h,int &offset,int pitch,int format )const;
+
+public:
 	BBCanvas():flags(0){}
 	BBCanvas( bb_int_t t ){}
 	virtual ~BBCanvas();
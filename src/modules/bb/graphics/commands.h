@@ -51,6 +51,7 @@ BBCanvas * BBCALL bbBackBuffer(  );
 bb_int_t BBCALL bbScanLine(  );
 void BBCALL bbVWait( bb_int_t frames );
 void BBCALL bbFlip( bb_int_t vwait );
+bb_int_t BBCALL bbStats2D( bb_int_t type );
 bb_int_t BBCALL bbGraphicsWidth(  );
 bb_int_t BBCALL bbGraphicsHeight(  );
 bb_int_t BBCALL bbGraphicsDepth(  );
@@ -63,7 +64,7 @@ bb_int_t BBCALL bbSaveBuffer( BBCanvas *buffer,BBStr *bmpfile );
 void BBCALL bbBufferDirty( BBCanvas *buffer );
 
 //fast pixel reads/write
-void BBCALL bbLockBuffer( BBCanvas *buffer );
+void BBCALL bbLockBuffer( BBCanvas *buffer,bb_int_t write_only );
 void BBCALL bbUnlockBuffer( BBCanvas *buffer );
 bb_int_t BBCALL bbReadPixel( bb_int_t x,bb_int_t y,BBCanvas *buffer );
 void BBCALL bbWritePixel( bb_int_t x,bb_int_t y,bb_int_t argb,BBCanvas *buffer );
@@ -71,6 +72,8 @@ bb_int_t BBCALL bbReadPixelFast( bb_int_t x,bb_int_t y,BBCanvas *buffer );
 void BBCALL bbWritePixelFast( bb_int_t x,bb_int_t y,bb_int_t argb,BBCanvas *buffer );
 void BBCALL bbCopyPixel( bb_int_t src_x,bb_int_t src_y,BBCanvas *src_buffer,bb_int_t dest_x,bb_int_t dest_y,BBCanvas *dest_buffer );
 void BBCALL bbCopyPixelFast( bb_int_t src_x,bb_int_t src_y,BBCanvas *src_buffer,bb_int_t dest_x,bb_int_t dest_y,BBCanvas *dest_buffer );
+void BBCALL bbReadPixels( bb_int_t x,bb_int_t y,bb_int_t width,bb_int_t height,bbBank *bank,bb_int_t offset,bb_int_t format,BBCanvas *buffer );
+void BBCALL bbWritePixels( bb_int_t x,bb_int_t y,bb_int_t width,bb_int_t height,bbBank *bank,bb_int_t offset,bb_int_t format,BBCanvas *buffer );
 void BBCALL bbCopyRect( bb_int_t source_x,bb_int_t source_y,bb_int_t width,bb_int_t height,bb_int_t dest_x,bb_int_t dest_y,BBCanvas *src_buffer,BBCanvas *dest_buffer );
 
 //rendering
@@ -2,6 +2,7 @@
 #include "../stdutil/stdutil.h"
 #include "font.h"
 #include <utf8.h>
+#include <algorithm>
 
 #undef max
 
@@ -148,7 +149,53 @@ std::map<std::string,BBFontData> bbFontCache;
 BBFont::~BBFont(){
 }
 
-BBImageFont::BBImageFont( FT_Face f,int h,float d ):face(f),height(h),atlas(0){
+//pages a font may hold before cold ones get evicted
+static const int MAX_PAGES=4;
+//laid out strings kept per font
+static const size_t MAX_RUNS=256;
+
+BBImageFont::Page::Page( int w,int h ):width(w),height(h),used(0),version(0),clears(0){
+	static unsigned int next_serial;
+	serial=++next_serial;
+	bits=new unsigned char[width*height];
+	clear();
+}
+
+BBImageFont::Page::~Page(){
+	delete[] bits;
+}
+
+bool BBImageFont::Page::pack( int w,int h,int &x,int &y ){
+	//best fit by height among shelves with room left
+	Shelf *best=0;
+	for( int i=0;i<shelves.size();i++ ){
+		Shelf &s=shelves[i];
+		if( s.height<h || s.x+w>width ) continue;
+		if( !best || s.height<best->height ) best=&s;
+	}
+	if( !best ){
+		if( top+h>height || w>width ) return false;
+		Shelf s={ top,h,0 };
+		shelves.push_back( s );
+		top+=h;
+		best=&shelves.back();
+	}
+
+	x=best->x;y=best->y;
+	best->x+=w;
+	++version;
+	return true;
+}
+
+void BBImageFont::Page::clear(){
+	memset( bits,0,width*height );
+	shelves.clear();
+	top=0;
+	++version;
+	++clears;
+}
+
+BBImageFont::BBImageFont( FT_Face f,int h,float d ):face(f),height(h),stamp(0),epoch(0){
 	FT_Size_RequestRec req={ FT_SIZE_REQUEST_TYPE_REAL_DIM,0,(long)(height*64*d),0,0 };
 	FT_Request_Size( face,&req );
 
@@ -156,6 +203,10 @@ BBImageFont::BBImageFont( FT_Face f,int h,float d ):face(f),height(h),atlas(0){
 	density=1.0/d;
 }
 
+BBImageFont::~BBImageFont(){
+	for( int i=0;i<pages.size();i++ ) delete pages[i];
+}
+
 BBImageFont *BBImageFont::load( const std::string &name,int height,float density,int flags ){
 	BBFontData font;
 	if( bbFontCache.count( name )==0 ){
@@ -203,6 +254,8 @@ bool BBImageFont::loadChar( uint32_t c )const{
 
 	Char chr;
 	chr.index=FT_Get_Char_Index( face,c );
+	chr.page=-1;
+	chr.x=chr.y=0;
 	FT_Load_Glyph( face,chr.index,FT_LOAD_RENDER );
 
 	chr.width=face->glyph->bitmap.width;
@@ -213,63 +266,141 @@ bool BBImageFont::loadChar( uint32_t c )const{
 
 	characters.insert( std::make_pair( c,chr ) );
 
-	return (dirty=true);
+	return true;
 }
 
 bool BBImageFont::loadChars( const std::string &t )const{
+	bool loaded=false;
 	const char *s=t.c_str();
 	while( *s ){
 		utf8_int32_t chr;
 		s=utf8codepoint( s,&chr );
-		loadChar( chr );
+		if( loadChar( chr ) ) loaded=true;
 	}
-	return dirty;
+	return loaded;
 }
 
-void BBImageFont::rebuildAtlas(){
-	if( !dirty ) return;
+void BBImageFont::evictPage( int n ){
+	pages[n]->clear();
+	for( std::map<uint32_t,Char>::iterator it=characters.begin();it!=characters.end();++it ){
+		if( it->second.page==n ) it->second.page=-1;
+	}
+	//cached runs may point into the page
+	++epoch;
+}
 
-	delete atlas;
-	atlas=d_new BBPixmap;
-	atlas->width=atlas->height=256;
-	atlas->bits=new unsigned char[atlas->width*atlas->height];
-	memset( atlas->bits,0,atlas->width*atlas->height );
+bool BBImageFont::packChar( Char &c ){
+	//1 pixel gutter right and below keeps filtering from bleeding into neighbours
+	int w=c.width+1,h=c.height+1,x,y,n;
+	for( n=0;n<pages.size();n++ ){
+		if( pages[n]->pack( w,h,x,y ) ) break;
+	}
 
-	int ox=0,oy=0,my=0;
-	for( std::map<uint32_t,Char>::iterator it=characters.begin();it!=characters.end();++it ){
-		Char &c=it->second;
+	if( n==pages.size() ){
+		//evict the coldest page not needed by the string being laid out
+		int cold=-1;
+		if( pages.size()>=MAX_PAGES ){
+			for( int i=0;i<pages.size();i++ ){
+				if( pages[i]->used==stamp ) continue;
+				if( cold<0 || pages[i]->used<pages[cold]->used ) cold=i;
+			}
+		}
+		if( cold>=0 ){
+			evictPage( n=cold );
+		}else{
+			int size=256,px=height/density;
+			while( size<px*16 && size<1024 ) size*=2;
+			while( size<w || size<h ) size*=2;
+			pages.push_back( d_new Page( size,size ) );
+		}
+		if( !pages[n]->pack( w,h,x,y ) ) return false;
+	}
 
-		FT_Load_Glyph( face,c.index,FT_LOAD_RENDER );
+	Page *p=pages[n];
+	c.page=n;c.x=x;c.y=y;
+	p->used=stamp;
+
+	FT_Load_Glyph( face,c.index,FT_LOAD_RENDER );
+
+	FT_Bitmap bm=face->glyph->bitmap;
+	for( int y=0;y<bm.rows;y++ ){
+		unsigned char *in=bm.buffer+y*bm.pitch;
+		unsigned char *out=p->bits+(p->width*(c.y+y))+c.x;
+		switch( bm.pixel_mode ){
+		case FT_PIXEL_MODE_MONO:
+			for( int i=0;i<bm.width;i++ ) out[i]=(in[i>>3]>>(7-(i&7)))&1?0xff:0;
+			break;
+		case FT_PIXEL_MODE_GRAY:
+			memcpy( out,in,bm.width );
+			break;
+		default:
+			RTEX( "unhandled font bitmap format" );
+		}
+	}
+	return true;
+}
 
-		if( ox+c.width>=atlas->width ){
-			oy+=my;
-			ox=my=0;
+const BBImageFont::Run &BBImageFont::layout( const std::string &t ){
+	++stamp;
+
+	Run *run;
+	std::unordered_map<std::string,RunList::iterator>::iterator it=run_index.find( t );
+	if( it!=run_index.end() ){
+		runs.splice( runs.begin(),runs,it->second );
+		run=&it->second->second;
+		if( run->epoch==epoch ){
+			for( int i=0;i<run->pages.size();i++ ) pages[run->pages[i]]->used=stamp;
+			return *run;
 		}
+	}else{
+		runs.push_front( std::make_pair( t,Run() ) );
+		run_index[t]=runs.begin();
+		run=&runs.front().second;
+		if( runs.size()>MAX_RUNS ){
+			run_index.erase( runs.back().first );
+			runs.pop_back();
+		}
+	}
+
+	run->quads.clear();
+	run->pages.clear();
 
-		c.x=ox;c.y=oy;
-
-		my=std::max( c.height,my );
-
-		FT_Bitmap bm=face->glyph->bitmap;
-		for( int y=0;y<bm.rows;y++ ){
-			unsigned char *in=bm.buffer+y*bm.pitch;
-			unsigned char *out=atlas->bits+(atlas->width*(oy+y))+ox;
-			switch( bm.pixel_mode ){
-			case FT_PIXEL_MODE_MONO:
-				for( int i=0;i<8;i++ ) out[i]=(*in>>(7-i))&1?0xff:0;
-				break;
-			case FT_PIXEL_MODE_GRAY:
-				memcpy( out,in,bm.width );
-				break;
-			default:
-				RTEX( "unhandled font bitmap format" );
+	int x=0,y=baseline*density;
+
+	const char *s=t.c_str();
+	utf8_int32_t curr=0,prev=0;
+	while( *s ){
+		prev=curr;
+		s=utf8codepoint( s,&curr );
+		Char &c=getChar( curr );
+
+		if( c.width>0 && c.height>0 && ( c.page>=0 || packChar( c ) ) ){
+			Page *p=pages[c.page];
+			p->used=stamp;
+			if( std::find( run->pages.begin(),run->pages.end(),c.page )==run->pages.end() ){
+				run->pages.push_back( c.page );
 			}
+
+			Quad q;
+			q.x0=x+c.bearing_x*density;
+			q.y0=y-c.bearing_y*density;
+			if( prev>0 ) q.x0+=getKerning( prev,curr );
+			q.x1=q.x0+c.width*density;
+			q.y1=q.y0+c.height*density;
+			q.u0=float(c.x)/p->width;
+			q.v0=float(c.y)/p->height;
+			q.u1=float(c.x+c.width)/p->width;
+			q.v1=float(c.y+c.height)/p->height;
+			q.page=c.page;
+			run->quads.push_back( q );
 		}
 
-		ox+=c.width;
+		x+=c.advance*density;
 	}
 
-	dirty=false;
+	//a page evicted above can't hold anything this run uses
+	run->epoch=epoch;
+	return *run;
 }
 
 BBImageFont::Char &BBImageFont::getChar( uint32_t c ){
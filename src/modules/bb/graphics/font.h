@@ -8,6 +8,9 @@
 
 #include <string>
 #include <map>
+#include <list>
+#include <vector>
+#include <unordered_map>
 
 class BBFont{
 public:
@@ -32,28 +35,77 @@ class BBImageFont : public BBFont{
 public:
 	struct Char{
 		uint32_t index;
+		int page;			//atlas page, -1 until packed
 		int x,y,width,height;
 		int bearing_x,bearing_y;
 		int advance;
 	};
 
-	BBPixmap *atlas;
-	mutable bool dirty;
+	//one 8 bit atlas page; glyphs are packed into shelves and never move until the page is evicted
+	struct Page{
+		struct Shelf{
+			int y,height,x;
+		};
+
+		int width,height;
+		unsigned char *bits;
+		std::vector<Shelf> shelves;
+		int top;						//first row not yet given to a shelf
+		unsigned int used;				//layout stamp of last use
+		unsigned int serial;			//never reused, for renderers to key their copies by
+		unsigned int version;			//bumped by every pack and clear
+		unsigned int clears;			//bumped by clear; shelves from before it are gone
+
+		Page( int w,int h );
+		~Page();
+
+		bool pack( int w,int h,int &x,int &y );
+		void clear();
+	};
+
+	//one glyph of a laid out string, in pixels relative to the pen start
+	struct Quad{
+		float x0,y0,x1,y1;
+		float u0,v0,u1,v1;
+		int page;
+	};
+
+	struct Run{
+		std::vector<Quad> quads;
+		std::vector<int> pages;			//distinct pages the quads use
+		unsigned int epoch;
+	};
+
 	int height,baseline;
 	float density;
 
+	std::vector<Page*> pages;
+
 private:
 	FT_Face face;
 	mutable std::map<uint32_t,Char> characters;
 
+	unsigned int stamp,epoch;
+
+	typedef std::list<std::pair<std::string,Run> > RunList;
+	RunList runs;
+	std::unordered_map<std::string,RunList::iterator> run_index;
+
 	BBImageFont( FT_Face f,int height,float density );
 
+	bool packChar( Char &c );
+	void evictPage( int n );
+
 public:
+	~BBImageFont();
+
 	static BBImageFont *load( const std::string &name,int height,float density,int flags );
 
 	bool loadChar( uint32_t c )const;
 	bool loadChars( const std::string &t )const;
-	void rebuildAtlas();
+
+	//lays out t, packing any glyphs not yet in the atlas; the result is valid until the next call
+	const Run &layout( const std::string &t );
 
 	Char &getChar( uint32_t c );
 	float getKerning( uint32_t l,uint32_t r );
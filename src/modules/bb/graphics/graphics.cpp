@@ -3,8 +3,11 @@
 #include "graphics.h"
 #include <bb/runtime/runtime.h>
 #include <bb/system/system.h>
+#include <bb/profile/profile.h>
 #include <bb/input/input.h>
 #include <bb/graphics/graphics.h>
+#include <bb/graphics/pixels.h>
+#include "../../../stdutil/workers.h"
 
 #ifdef WIN32
 #include <windows.h>
@@ -14,6 +17,7 @@
 #include <fstream>
 #include <vector>
 #include <set>
+#include <algorithm>
 
 #include <math.h>
 
@@ -108,6 +112,9 @@ BBContextDriver *bbContextDriver=0;
 BBGraphics *gx_graphics=0;
 BBCanvas *gx_canvas=0;
 
+bb_int_t bbStats2DFrame[STATS2D_COUNT];
+static bb_int_t stats2d[STATS2D_COUNT];
+
 struct GfxMode{
 	int w,h,d,caps;
 };
@@ -427,9 +434,9 @@ BBCanvas * BBCALL bbBackBuffer(){
 	return gx_graphics->getBackCanvas();
 }
 
-void BBCALL bbLockBuffer( BBCanvas *buff ){
+void BBCALL bbLockBuffer( BBCanvas *buff,bb_int_t write_only ){
 	if( buff ) debugCanvas( buff );
-	(buff ? buff : gx_canvas)->lock();
+	(buff ? buff : gx_canvas)->lock( write_only );
 }
 
 void BBCALL bbUnlockBuffer( BBCanvas *buff ){
@@ -463,6 +470,28 @@ void BBCALL bbCopyPixelFast( bb_int_t src_x,bb_int_t src_y,BBCanvas *src,bb_int_
 	(buff ? buff : gx_canvas)->copyPixelFast( dest_x,dest_y,src ? src : gx_canvas,src_x,src_y );
 }
 
+static void debugPixels( bb_int_t x,bb_int_t y,bb_int_t width,bb_int_t height,bbBank *bank,bb_int_t offset,bb_int_t format,BBCanvas *buff ){
+	if( bb_env.debug ){
+		if( buff ) debugCanvas( buff );
+		int bpp=bbPixelsBytes( format );
+		if( !bpp ) RTEX( "Illegal pixel format" );
+		if( width<0 || height<0 ) RTEX( "Illegal rect size" );
+		BBCanvas *c=buff ? buff : gx_canvas;
+		if( x<0 || y<0 || x+width>c->getWidth() || y+height>c->getHeight() ) RTEX( "Rect outside buffer" );
+		debugBankRange( bank,offset,width*height*bpp );
+	}
+}
+
+void BBCALL bbReadPixels( bb_int_t x,bb_int_t y,bb_int_t width,bb_int_t height,bbBank *bank,bb_int_t offset,bb_int_t format,BBCanvas *buff ){
+	debugPixels( x,y,width,height,bank,offset,format,buff );
+	(buff ? buff : gx_canvas)->readPixels( x,y,width,height,bank->data+offset,width*bbPixelsBytes( format ),format );
+}
+
+void BBCALL bbWritePixels( bb_int_t x,bb_int_t y,bb_int_t width,bb_int_t height,bbBank *bank,bb_int_t offset,bb_int_t format,BBCanvas *buff ){
+	debugPixels( x,y,width,height,bank,offset,format,buff );
+	(buff ? buff : gx_canvas)->writePixels( x,y,width,height,bank->data+offset,width*bbPixelsBytes( format ),format );
+}
+
 bb_int_t BBCALL bbScanLine(){
 	return gx_graphics->getScanLine();
 }
@@ -473,10 +502,26 @@ void BBCALL bbVWait( bb_int_t n ){
 }
 
 void BBCALL bbFlip( bb_int_t vwait ){
-	bbContextDriver->flip( vwait ? true : false );
+	{
+		BB_PROFILE( "Flip" );
+		bbContextDriver->flip( vwait ? true : false );
+	}
+	bbProfileEndFrame();
+	for( int k=0;k<STATS2D_COUNT;++k ){
+		stats2d[k]=bbStats2DFrame[k];
+		bbStats2DFrame[k]=0;
+	}
 	if( !bbRuntimeIdle() ) RTEX( 0 );
 }
 
+bb_int_t BBCALL bbStats2D( bb_int_t type ){
+	if( type<0 || type>=STATS2D_COUNT ){
+		if( bb_env.debug ) RTEX( "Illegal Stats2D type" );
+		return 0;
+	}
+	return stats2d[type];
+}
+
 bb_int_t BBCALL bbGraphicsWidth(){
 	return gx_graphics->getLogicalWidth();
 }
@@ -497,34 +542,6 @@ void BBCALL bbCopyRect( bb_int_t sx,bb_int_t sy,bb_int_t w,bb_int_t h,bb_int_t d
 	dest->blit( dx,dy,src,sx,sy,w,h,true );
 }
 
-#define ALP(_X_) ( ((_X_)>>24) & 0xff )
-#define RED(_X_) ( ((_X_)>>16) & 0xff )
-#define GRN(_X_) ( ((_X_)>>8) & 0xff )
-#define BLU(_X_) ( (_X_) & 0xff )
-
-static int getPixel( BBCanvas *c,float x,float y ){
-	debugCanvas( c );
-
-	x-=.5f;y-=.5f;
-	float fx=floor(x),fy=floor(y);
-	int ix=fx,iy=fy;fx=x-fx;fy=y-fy;
-
-	// Use getPixelFast since caller should have already called lock()
-	int tl=c->getPixelFast( ix,iy );
-	int tr=c->getPixelFast( ix+1,iy );
-	int br=c->getPixelFast( ix+1,iy+1 );
-	int bl=c->getPixelFast( ix,iy+1 );
-
-	float w1=(1-fx)*(1-fy),w2=fx*(1-fy),w3=(1-fx)*fy,w4=fx*fy;
-
-	float a=ALP(tl)*w1+ALP(tr)*w2+ALP(bl)*w3+ALP(br)*w4;
-	float r=RED(tl)*w1+RED(tr)*w2+RED(bl)*w3+RED(br)*w4;
-	float g=GRN(tl)*w1+GRN(tr)*w2+GRN(bl)*w3+GRN(br)*w4;
-	float b=BLU(tl)*w1+BLU(tr)*w2+BLU(bl)*w3+BLU(br)*w4;
-
-	return (int(a+.5f)<<24)|(int(r+.5f)<<16)|(int(g+.5f)<<8)|int(b+.5f);
-}
-
 struct vec2{ float x,y; };
 
 static vec2 vrot( float m[2][2],const vec2 &v ){
@@ -540,9 +557,13 @@ static float vmax( float a,float b,float c,float d ){
 	float t=a;if( b>t ) t=b;if( c>t ) t=c;if( d>t ) t=d;return t;
 }
 
+//rows per job, and the pixel count past which tformCanvas spreads them across threads
+static const int TFORM_BAND=32;
+static const int TFORM_THREADED=256*256;
+
 static BBCanvas *tformCanvas( BBCanvas *c,float m[2][2],int x_handle,int y_handle ){
 
-	vec2 v,v0,v1,v2,v3;
+	vec2 v0,v1,v2,v3;
 	float i[2][2];
 	float dt=1.0f/(m[0][0]*m[1][1]-m[1][0]*m[0][1]);
 	i[0][0]=dt*m[1][1];i[1][0]=-dt*m[1][0];
@@ -564,21 +585,23 @@ static BBCanvas *tformCanvas( BBCanvas *c,float m[2][2],int x_handle,int y_handl
 	t->setHandle( -minx,-miny );
 	t->setMask( c->getMask() );
 
-	c->lock();
-	t->lock();
-
-	v.y=miny+.5f;
-	for( int y=0;y<ih;++v.y,++y ){
-		v.x=minx+.5f;
-		for( int x=0;x<iw;++v.x,++x ){
-			vec2 q=vrot(i,v);
-			unsigned rgb=filter ? getPixel( c,q.x+ox,q.y+oy ) : c->getPixelFast( floor(q.x+ox),floor(q.y+oy) );
-			t->setPixelFast( x,y,rgb );
-		}
+	int sw=c->getWidth(),sh=c->getHeight();
+	std::vector<unsigned> src( sw*sh ),dst( iw*ih );
+	c->readPixels( 0,0,sw,sh,src.data(),sw*4,BBCanvas::PIXELS_ARGB );
+
+	//big images are split into bands of rows across threads
+	int bands=(ih+TFORM_BAND-1)/TFORM_BAND;
+	if( bands>1 && iw*ih>=TFORM_THREADED ){
+		static WorkerPool workers( WorkerPool::hardwareThreads() );
+		workers.run( bands,[&]( int band,int worker ){
+			int y0=band*TFORM_BAND,y1=std::min( y0+TFORM_BAND,ih );
+			bbAffinePixels( src.data(),sw,sh,dst.data(),iw,y0,y1,i,minx,miny,ox,oy,filter );
+		} );
+	}else{
+		bbAffinePixels( src.data(),sw,sh,dst.data(),iw,0,ih,i,minx,miny,ox,oy,filter );
 	}
 
-	t->unlock();
-	c->unlock();
+	t->writePixels( 0,0,iw,ih,dst.data(),iw*4,BBCanvas::PIXELS_ARGB );
 
 	return t;
 }
@@ -2,6 +2,7 @@
 #define BBGRAPHICS_H
 
 #include <bb/blitz/blitz.h>
+#include <bb/bank/bank.h>
 #include "movie.h"
 #include "font.h"
 #include "canvas.h"
@@ -109,6 +110,16 @@ public:
 
 class BBImage;
 
+// 2D counts for the frame in progress, kept by the canvases as they draw;
+// Flip moves them to the ones Stats2D reads back
+enum{
+	STATS2D_DRAWS,			//draw calls made to the GPU
+	STATS2D_PRIMITIVES,		//Plot, Line, Rect, Oval, Text and image draws
+	STATS2D_VERTICES,		//vertices sent
+	STATS2D_COUNT
+};
+extern bb_int_t bbStats2DFrame[STATS2D_COUNT];
+
 #include "commands.h"
 
 extern BBGraphics *gx_graphics;
@@ -38,6 +38,7 @@ BBMODULE_LINK( graphics ){
 	rtSym( "%ScanLine","bbScanLine",bbScanLine );
 	rtSym( "VWait%frames=1","bbVWait",bbVWait );
 	rtSym( "Flip%vwait=1","bbFlip",bbFlip );
+	rtSym( "%Stats2D%type","bbStats2D",bbStats2D );
 	rtSym( "%GraphicsWidth","bbGraphicsWidth",bbGraphicsWidth );
 	rtSym( "%GraphicsHeight","bbGraphicsHeight",bbGraphicsHeight );
 	rtSym( "%GraphicsDepth","bbGraphicsDepth",bbGraphicsDepth );
@@ -46,7 +47,7 @@ BBMODULE_LINK( graphics ){
 	rtSym( "%LoadBuffer%buffer$bmpfile","bbLoadBuffer",bbLoadBuffer );
 	rtSym( "%SaveBuffer%buffer$bmpfile","bbSaveBuffer",bbSaveBuffer );
 	rtSym( "BufferDirty%buffer","bbBufferDirty",bbBufferDirty );
-	rtSym( "LockBuffer%buffer=0","bbLockBuffer",bbLockBuffer );
+	rtSym( "LockBuffer%buffer=0%write_only=0","bbLockBuffer",bbLockBuffer );
 	rtSym( "UnlockBuffer%buffer=0","bbUnlockBuffer",bbUnlockBuffer );
 	rtSym( "%ReadPixel%x%y%buffer=0","bbReadPixel",bbReadPixel );
 	rtSym( "WritePixel%x%y%argb%buffer=0","bbWritePixel",bbWritePixel );
@@ -54,6 +55,8 @@ BBMODULE_LINK( graphics ){
 	rtSym( "WritePixelFast%x%y%argb%buffer=0","bbWritePixelFast",bbWritePixelFast );
 	rtSym( "CopyPixel%src_x%src_y%src_buffer%dest_x%dest_y%dest_buffer=0","bbCopyPixel",bbCopyPixel );
 	rtSym( "CopyPixelFast%src_x%src_y%src_buffer%dest_x%dest_y%dest_buffer=0","bbCopyPixelFast",bbCopyPixelFast );
+	rtSym( "ReadPixels%x%y%width%height%bank%offset=0%format=1%buffer=0","bbReadPixels",bbReadPixels );
+	rtSym( "WritePixels%x%y%width%height%bank%offset=0%format=1%buffer=0","bbWritePixels",bbWritePixels );
 	rtSym( "CopyRect%source_x%source_y%width%height%dest_x%dest_y%src_buffer=0%dest_buffer=0","bbCopyRect",bbCopyRect );
 	rtSym( "Origin%x%y","bbOrigin",bbOrigin );
 	rtSym( "Viewport%x%y%width%height","bbViewport",bbViewport );
@@ -0,0 +1,192 @@
+
+#include "pixels.h"
+#include "canvas.h"
+
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define PIXELS_SSE
+#include <emmintrin.h>
+#endif
+
+int bbPixelsBytes( int format ){
+	switch( format ){
+	case BBCanvas::PIXELS_ARGB:case BBCanvas::PIXELS_RGBA:return 4;
+	case BBCanvas::PIXELS_R8:return 1;
+	}
+	return 0;
+}
+
+//ARGB <-> RGBA is the same swap of bytes 0 and 2 both ways
+static void swapRB( const unsigned *src,unsigned *dst,int n ){
+	int i=0;
+#ifdef PIXELS_SSE
+	const __m128i ga=_mm_set1_epi32( 0xff00ff00 ),lo=_mm_set1_epi32( 0xff );
+	for( ;i+4<=n;i+=4 ){
+		__m128i v=_mm_loadu_si128( (const __m128i*)(src+i) );
+		__m128i r=_mm_and_si128( _mm_srli_epi32( v,16 ),lo );
+		__m128i b=_mm_slli_epi32( _mm_and_si128( v,lo ),16 );
+		_mm_storeu_si128( (__m128i*)(dst+i),_mm_or_si128( _mm_and_si128( v,ga ),_mm_or_si128( r,b ) ) );
+	}
+#endif
+	for( ;i<n;i++ ){
+		unsigned v;
+		memcpy( &v,src+i,4 );
+		v=(v&0xff00ff00)|((v>>16)&0xff)|((v&0xff)<<16);
+		memcpy( dst+i,&v,4 );
+	}
+}
+
+static void argbToR8( const unsigned *src,unsigned char *dst,int n ){
+	int i=0;
+#ifdef PIXELS_SSE
+	const __m128i lo=_mm_set1_epi32( 0xff );
+	for( ;i+16<=n;i+=16 ){
+		__m128i a=_mm_and_si128( _mm_srli_epi32( _mm_loadu_si128( (const __m128i*)(src+i) ),16 ),lo );
+		__m128i b=_mm_and_si128( _mm_srli_epi32( _mm_loadu_si128( (const __m128i*)(src+i+4) ),16 ),lo );
+		__m128i c=_mm_and_si128( _mm_srli_epi32( _mm_loadu_si128( (const __m128i*)(src+i+8) ),16 ),lo );
+		__m128i d=_mm_and_si128( _mm_srli_epi32( _mm_loadu_si128( (const __m128i*)(src+i+12) ),16 ),lo );
+		_mm_storeu_si128( (__m128i*)(dst+i),_mm_packus_epi16( _mm_packs_epi32( a,b ),_mm_packs_epi32( c,d ) ) );
+	}
+#endif
+	for( ;i<n;i++ ){
+		unsigned v;
+		memcpy( &v,src+i,4 );
+		dst[i]=v>>16;
+	}
+}
+
+static void r8ToARGB( const unsigned char *src,unsigned *dst,int n ){
+	int i=0;
+#ifdef PIXELS_SSE
+	const __m128i a=_mm_set1_epi32( 0xff000000 );
+	for( ;i+16<=n;i+=16 ){
+		__m128i v=_mm_loadu_si128( (const __m128i*)(src+i) );
+		__m128i l=_mm_unpacklo_epi8( v,v ),h=_mm_unpackhi_epi8( v,v );
+		//each grey byte repeated four times, alpha forced opaque
+		_mm_storeu_si128( (__m128i*)(dst+i),_mm_or_si128( _mm_unpacklo_epi16( l,l ),a ) );
+		_mm_storeu_si128( (__m128i*)(dst+i+4),_mm_or_si128( _mm_unpackhi_epi16( l,l ),a ) );
+		_mm_storeu_si128( (__m128i*)(dst+i+8),_mm_or_si128( _mm_unpacklo_epi16( h,h ),a ) );
+		_mm_storeu_si128( (__m128i*)(dst+i+12),_mm_or_si128( _mm_unpackhi_epi16( h,h ),a ) );
+	}
+#endif
+	for( ;i<n;i++ ){
+		unsigned v=0xff000000|(src[i]*0x010101);
+		memcpy( dst+i,&v,4 );
+	}
+}
+
+void bbPixelsFromARGB( const unsigned *src,void *dst,int n,int format ){
+	switch( format ){
+	case BBCanvas::PIXELS_ARGB:memcpy( dst,src,n*4 );break;
+	case BBCanvas::PIXELS_RGBA:swapRB( src,(unsigned*)dst,n );break;
+	case BBCanvas::PIXELS_R8:argbToR8( src,(unsigned char*)dst,n );break;
+	}
+}
+
+void bbPixelsToARGB( const void *src,unsigned *dst,int n,int format ){
+	switch( format ){
+	case BBCanvas::PIXELS_ARGB:memcpy( dst,src,n*4 );break;
+	case BBCanvas::PIXELS_RGBA:swapRB( (const unsigned*)src,dst,n );break;
+	case BBCanvas::PIXELS_R8:r8ToARGB( (const unsigned char*)src,dst,n );break;
+	}
+}
+
+static inline unsigned texel( const unsigned *src,int sw,int sh,int x,int y ){
+	return x>=0 && x<sw && y>=0 && y<sh ? src[y*sw+x] : 0;
+}
+
+//bilinear sample at x,y, rounding each channel as the per pixel code always has
+static inline unsigned bilinear( const unsigned *src,int sw,int sh,float x,float y ){
+	x-=.5f;y-=.5f;
+	float fx=floor(x),fy=floor(y);
+	int ix=fx,iy=fy;fx=x-fx;fy=y-fy;
+
+	unsigned tl=texel( src,sw,sh,ix,iy ),tr=texel( src,sw,sh,ix+1,iy );
+	unsigned bl=texel( src,sw,sh,ix,iy+1 ),br=texel( src,sw,sh,ix+1,iy+1 );
+
+	float w1=(1-fx)*(1-fy),w2=fx*(1-fy),w3=(1-fx)*fy,w4=fx*fy;
+
+#ifdef PIXELS_SSE
+	//one channel per lane, summed in the same order as the scalar code
+	const __m128i z=_mm_setzero_si128();
+#define CHANNELS(p) _mm_cvtepi32_ps( _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( p ),z ),z ) )
+	__m128 c=_mm_mul_ps( CHANNELS( tl ),_mm_set1_ps( w1 ) );
+	c=_mm_add_ps( c,_mm_mul_ps( CHANNELS( tr ),_mm_set1_ps( w2 ) ) );
+	c=_mm_add_ps( c,_mm_mul_ps( CHANNELS( bl ),_mm_set1_ps( w3 ) ) );
+	c=_mm_add_ps( c,_mm_mul_ps( CHANNELS( br ),_mm_set1_ps( w4 ) ) );
+#undef CHANNELS
+	__m128i i=_mm_cvttps_epi32( _mm_add_ps( c,_mm_set1_ps( .5f ) ) );
+	i=_mm_packs_epi32( i,i );
+	return _mm_cvtsi128_si32( _mm_packus_epi16( i,i ) );
+#else
+	unsigned argb=0;
+	for( int k=0;k<32;k+=8 ){
+		float v=((tl>>k)&0xff)*w1+((tr>>k)&0xff)*w2+((bl>>k)&0xff)*w3+((br>>k)&0xff)*w4;
+		argb|=unsigned(int(v+.5f))<<k;
+	}
+	return argb;
+#endif
+}
+
+void bbAffinePixels( const unsigned *src,int sw,int sh,unsigned *dst,int dw,int row0,int row1,
+	const float inv[2][2],float dx,float dy,float ox,float oy,bool filter ){
+
+	//the per pixel code stepped its coordinates with ++ rather than computing
+	//them, and rounding once differs from rounding every step once they get
+	//big, so both are stepped the same way here
+	std::vector<float> vxs( dw );
+	float vx=dx+.5f;
+	for( int x=0;x<dw;++vx,x++ ) vxs[x]=vx;
+
+	float vy=dy+.5f;
+	for( int y=0;y<row0;y++ ) ++vy;
+
+	for( int y=row0;y<row1;++vy,y++ ){
+		unsigned *out=dst+y*dw;
+		//the products are rounded on their own, as the per pixel code did, so
+		//nearest sampling picks exactly the same texels
+		float ry0=inv[0][1]*vy,ry1=inv[1][1]*vy;
+		int x=0;
+
+		if( filter ){
+			for( ;x<dw;x++ ){
+				out[x]=bilinear( src,sw,sh,(inv[0][0]*vxs[x]+ry0)+ox,(inv[1][0]*vxs[x]+ry1)+oy );
+			}
+			continue;
+		}
+
+#ifdef PIXELS_SSE
+		const __m128 m00=_mm_set1_ps( inv[0][0] ),m10=_mm_set1_ps( inv[1][0] );
+		const __m128 c0=_mm_set1_ps( ry0 ),c1=_mm_set1_ps( ry1 );
+		const __m128 o0=_mm_set1_ps( ox ),o1=_mm_set1_ps( oy );
+		const __m128i w=_mm_set1_epi32( sw ),h=_mm_set1_epi32( sh ),neg=_mm_set1_epi32( -1 );
+		for( ;x+4<=dw;x+=4 ){
+			__m128 v=_mm_loadu_ps( &vxs[x] );
+			__m128 qx=_mm_add_ps( _mm_add_ps( _mm_mul_ps( m00,v ),c0 ),o0 );
+			__m128 qy=_mm_add_ps( _mm_add_ps( _mm_mul_ps( m10,v ),c1 ),o1 );
+
+			//floor: truncate, then step down where that rounded up
+			__m128i ix=_mm_cvttps_epi32( qx ),iy=_mm_cvttps_epi32( qy );
+			ix=_mm_add_epi32( ix,_mm_castps_si128( _mm_cmpgt_ps( _mm_cvtepi32_ps( ix ),qx ) ) );
+			iy=_mm_add_epi32( iy,_mm_castps_si128( _mm_cmpgt_ps( _mm_cvtepi32_ps( iy ),qy ) ) );
+
+			__m128i in=_mm_and_si128(
+				_mm_and_si128( _mm_cmpgt_epi32( ix,neg ),_mm_cmplt_epi32( ix,w ) ),
+				_mm_and_si128( _mm_cmpgt_epi32( iy,neg ),_mm_cmplt_epi32( iy,h ) ) );
+
+			int xs[4],ys[4],ok[4];
+			_mm_storeu_si128( (__m128i*)xs,ix );
+			_mm_storeu_si128( (__m128i*)ys,iy );
+			_mm_storeu_si128( (__m128i*)ok,in );
+			for( int k=0;k<4;k++ ) out[x+k]=ok[k] ? src[ys[k]*sw+xs[k]] : 0;
+		}
+#endif
+		for( ;x<dw;x++ ){
+			float qx=(inv[0][0]*vxs[x]+ry0)+ox,qy=(inv[1][0]*vxs[x]+ry1)+oy;
+			out[x]=texel( src,sw,sh,floor(qx),floor(qy) );
+		}
+	}
+}
@@ -0,0 +1,17 @@
+#ifndef BB_GRAPHICS_PIXELS_H
+#define BB_GRAPHICS_PIXELS_H
+
+//bytes per pixel of a BBCanvas::PIXELS_* format, 0 if it isn't one
+int bbPixelsBytes( int format );
+
+//convert n pixels between canvas ARGB and a BBCanvas::PIXELS_* format; either side may be unaligned
+void bbPixelsFromARGB( const unsigned *src,void *dst,int n,int format );
+void bbPixelsToARGB( const void *src,unsigned *dst,int n,int format );
+
+//resample rows [row0,row1) of an affine transform of src into dst, both ARGB top down.
+//dst pixel x,y samples src at inv*(dx+.5+x,dy+.5+y)+(ox,oy), with the coordinates stepped
+//by 1 a pixel rather than computed; texels outside src read as 0
+void bbAffinePixels( const unsigned *src,int sw,int sh,unsigned *dst,int dw,int row0,int row1,
+	const float inv[2][2],float dx,float dy,float ox,float oy,bool filter );
+
+#endif
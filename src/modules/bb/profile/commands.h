@@ -0,0 +1,25 @@
+#ifndef BB_PROFILE_COMMANDS_H
+#define BB_PROFILE_COMMANDS_H
+
+#include <bb/blitz/module.h>
+#include <bb/profile/profile.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// AUTOGENERATED. DO NOT EDIT.
+// RUN `make` TO UPDATE.
+void BBCALL bbProfileBegin( BBStr *zone );
+void BBCALL bbProfileEnd( BBStr *zone );
+void BBCALL bbProfileFrame(  );
+bb_float_t BBCALL bbProfileFrameTime( BBStr *zone );
+bb_int_t BBCALL bbProfileFrameCalls( BBStr *zone );
+bb_int_t BBCALL bbProfileTrace( BBStr *file );
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -0,0 +1,14 @@
+// AUTOGENERATED. DO NOT EDIT.
+// RUN `make` TO UPDATE.
+
+#include <bb/blitz/module.h>
+#include <bb/profile/profile.h>
+
+BBMODULE_LINK( profile ){
+	rtSym( "ProfileBegin$zone","bbProfileBegin",bbProfileBegin );
+	rtSym( "ProfileEnd$zone=\"\"","bbProfileEnd",bbProfileEnd );
+	rtSym( "ProfileFrame","bbProfileFrame",bbProfileFrame );
+	rtSym( "#ProfileFrameTime$zone=\"\"","bbProfileFrameTime",bbProfileFrameTime );
+	rtSym( "%ProfileFrameCalls$zone","bbProfileFrameCalls",bbProfileFrameCalls );
+	rtSym( "%ProfileTrace$file","bbProfileTrace",bbProfileTrace );
+}
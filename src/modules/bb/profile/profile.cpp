@@ -0,0 +1,208 @@
+#include "../stdutil/stdutil.h"
+#include "profile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> bbProfiling( false );
+
+static std::mutex zone_lock;
+static std::map<std::string,BBProfileZone*> zone_map;
+static std::vector<BBProfileZone*> zones;
+
+static int64_t frame_start,last_frame_ns;
+
+// ProfileBegin zones still open, innermost last; main thread only
+struct OpenZone{
+	BBProfileZone *zone;
+	int64_t start;
+};
+static std::vector<OpenZone> open_zones;
+
+// trace events are buffered, and written out at the end of each frame
+struct TraceEvent{
+	BBProfileZone *zone;
+	int64_t start,dur;
+	int tid;
+};
+
+static std::mutex trace_lock;
+static FILE *trace_out;
+static std::atomic<bool> tracing( false );
+static int64_t trace_start;
+static bool trace_first;
+static std::vector<TraceEvent> trace_events;
+static std::atomic<int> trace_threads( 0 );
+
+static void enable(){
+	if( bbProfiling.load( std::memory_order_relaxed ) ) return;
+	frame_start=bbProfileNow();
+	bbProfiling=true;
+}
+
+int64_t bbProfileNow(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+BBProfileZone *bbProfileZone( const std::string &name ){
+	std::lock_guard<std::mutex> guard( zone_lock );
+	BBProfileZone *&zone=zone_map[name];
+	if( !zone ){
+		zone=new BBProfileZone( name );
+		zones.push_back( zone );
+	}
+	return zone;
+}
+
+static void writeEscaped( FILE *out,const std::string &s ){
+	for( unsigned char c:s ){
+		if( c=='"' || c=='\\' ) fprintf( out,"\\%c",c );
+		else if( c<0x20 ) fprintf( out,"\\u%04x",c );
+		else fputc( c,out );
+	}
+}
+
+// trace_lock held
+static void flushTrace(){
+	if( !trace_out ) return;
+	for( const TraceEvent &e:trace_events ){
+		fputs( trace_first ? "\n" : ",\n",trace_out );
+		trace_first=false;
+		fputs( "{\"name\":\"",trace_out );
+		writeEscaped( trace_out,e.zone->name );
+		fprintf( trace_out,"\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f}",
+			e.tid,(e.start-trace_start)/1000.0,e.dur/1000.0 );
+	}
+	trace_events.clear();
+	fflush( trace_out );
+}
+
+static void closeTrace(){
+	std::lock_guard<std::mutex> guard( trace_lock );
+	if( !trace_out ) return;
+	flushTrace();
+	fputs( "\n]\n",trace_out );
+	fclose( trace_out );
+	trace_out=0;
+	tracing=false;
+}
+
+static bool openTrace( const std::string &file ){
+	closeTrace();
+	if( file.empty() ) return true;
+
+	FILE *out=fopen( file.c_str(),"w" );
+	if( !out ) return false;
+
+	std::lock_guard<std::mutex> guard( trace_lock );
+	trace_out=out;
+	trace_start=bbProfileNow();
+	trace_first=true;
+	fputs( "[",trace_out );
+	tracing=true;
+	return true;
+}
+
+void bbProfileRecord( BBProfileZone *zone,int64_t start,int64_t end ){
+	zone->ns.fetch_add( end-start,std::memory_order_relaxed );
+	zone->calls.fetch_add( 1,std::memory_order_relaxed );
+
+	if( !tracing.load( std::memory_order_relaxed ) ) return;
+
+	thread_local int tid=++trace_threads;
+	std::lock_guard<std::mutex> guard( trace_lock );
+	if( !trace_out ) return;
+	trace_events.push_back( { zone,start,end-start,tid } );
+	if( trace_events.size()>=65536 ) flushTrace();
+}
+
+void bbProfileEndFrame(){
+	if( !bbProfiling.load( std::memory_order_relaxed ) ) return;
+
+	int64_t now=bbProfileNow();
+	last_frame_ns=now-frame_start;
+	frame_start=now;
+
+	{
+		std::lock_guard<std::mutex> guard( zone_lock );
+		for( BBProfileZone *zone:zones ){
+			zone->last_ns=zone->ns.exchange( 0,std::memory_order_relaxed );
+			zone->last_calls=zone->calls.exchange( 0,std::memory_order_relaxed );
+		}
+	}
+
+	std::lock_guard<std::mutex> guard( trace_lock );
+	flushTrace();
+}
+
+void BBCALL bbProfileBegin( BBStr *zone ){
+	std::string name=*zone;delete zone;
+	enable();
+	open_zones.push_back( { bbProfileZone( name ),bbProfileNow() } );
+}
+
+void BBCALL bbProfileEnd( BBStr *zone ){
+	std::string name=*zone;delete zone;
+	int64_t now=bbProfileNow();
+
+	// unnamed ends the innermost zone, named ends that one and any left
+	// open inside it
+	int n=open_zones.size()-1;
+	if( name.size() ){
+		while( n>=0 && open_zones[n].zone->name!=name ) --n;
+	}
+	if( n<0 ){
+		if( bb_env.debug ) RTEX( "ProfileEnd without ProfileBegin" );
+		return;
+	}
+
+	while( (int)open_zones.size()>n ){
+		const OpenZone &open=open_zones.back();
+		bbProfileRecord( open.zone,open.start,now );
+		open_zones.pop_back();
+	}
+}
+
+void BBCALL bbProfileFrame(){
+	enable();
+	bbProfileEndFrame();
+}
+
+bb_float_t BBCALL bbProfileFrameTime( BBStr *zone ){
+	std::string name=*zone;delete zone;
+	enable();
+	if( name.empty() ) return last_frame_ns/1000000.0;
+	return bbProfileZone( name )->last_ns/1000000.0;
+}
+
+bb_int_t BBCALL bbProfileFrameCalls( BBStr *zone ){
+	std::string name=*zone;delete zone;
+	enable();
+	return bbProfileZone( name )->last_calls;
+}
+
+bb_int_t BBCALL bbProfileTrace( BBStr *file ){
+	std::string path=*file;delete file;
+	if( path.size() ) enable();
+	return openTrace( path ) ? 1 : 0;
+}
+
+BBMODULE_CREATE( profile ){
+	open_zones.clear();
+	last_frame_ns=0;
+
+	if( const char *path=getenv( "BB_PROFILE_TRACE" ) ){
+		if( *path && openTrace( path ) ) enable();
+	}
+	return true;
+}
+
+BBMODULE_DESTROY( profile ){
+	closeTrace();
+	bbProfiling=false;
+	return true;
+}
@@ -0,0 +1,68 @@
+#ifndef BB_PROFILE_H
+#define BB_PROFILE_H
+
+#include <bb/blitz/blitz.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Named timing zones, built into every runtime.
+//
+// The runtime times its own zones (World::update, World::render, Flip...),
+// and programs add theirs with ProfileBegin/ProfileEnd. Each zone adds up
+// its time and calls over a frame; Flip, or ProfileFrame, closes the frame
+// and ProfileFrameTime reads the totals back. ProfileTrace, or the
+// BB_PROFILE_TRACE environment variable, also streams every zone as a
+// Chrome trace event file that chrome://tracing and Perfetto open.
+//
+// Nothing is timed until one of the Profile commands is first used or a
+// trace is started; until then a zone costs a single test.
+struct BBProfileZone{
+	std::string name;
+
+	// frame in progress, added to from any thread
+	std::atomic<int64_t> ns,calls;
+
+	// last complete frame
+	int64_t last_ns,last_calls;
+
+	BBProfileZone( const std::string &n ):name(n),ns(0),calls(0),last_ns(0),last_calls(0){}
+};
+
+extern std::atomic<bool> bbProfiling;
+
+// the zone called name, created on first use; zones are never freed
+BBProfileZone *bbProfileZone( const std::string &name );
+
+// monotonic clock in nanoseconds
+int64_t bbProfileNow();
+
+void bbProfileRecord( BBProfileZone *zone,int64_t start,int64_t end );
+
+// called by Flip
+void bbProfileEndFrame();
+
+class BBProfileScope{
+	BBProfileZone *zone;
+	int64_t start;
+public:
+	BBProfileScope( BBProfileZone *z ):zone(bbProfiling.load( std::memory_order_relaxed ) ? z : 0),start(0){
+		if( zone ) start=bbProfileNow();
+	}
+	~BBProfileScope(){
+		if( zone ) bbProfileRecord( zone,start,bbProfileNow() );
+	}
+};
+
+#define BB_PROFILE_JOIN2( a,b ) a##b
+#define BB_PROFILE_JOIN( a,b ) BB_PROFILE_JOIN2( a,b )
+
+// times the rest of the enclosing block as zone name
+#define BB_PROFILE( name ) \
+	static BBProfileZone *BB_PROFILE_JOIN( _bb_zone,__LINE__ )=bbProfileZone( name ); \
+	BBProfileScope BB_PROFILE_JOIN( _bb_scope,__LINE__ )( BB_PROFILE_JOIN( _bb_zone,__LINE__ ) )
+
+#include "commands.h"
+
+#endif
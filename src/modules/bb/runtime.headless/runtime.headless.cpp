@@ -0,0 +1,32 @@
+
+#include "../stdutil/stdutil.h"
+#include "runtime.headless.h"
+#include <bb/graphics/graphics.h>
+
+// a console runtime with the null renderer behind Graphics and Graphics3D,
+// for running whole programs where there is no window or GPU
+class HeadlessRuntime : public BBRuntime{
+public:
+	// runtime
+	void afterCreate(){
+		BBContextDriver::change( "null" );
+		bbDefaultGraphics();
+	}
+
+	void asyncStop(){}
+	void asyncRun(){}
+	void asyncEnd(){}
+
+	bool idle(){ return true; }
+
+	void *window(){ return 0; }
+
+	void moveMouse( int x,int y ){}
+	void setPointerVisible( bool vis ){}
+};
+
+BBRuntime *bbCreateHeadlessRuntime(){
+	return d_new HeadlessRuntime();
+}
+
+BBMODULE_EMPTY( runtime_headless );
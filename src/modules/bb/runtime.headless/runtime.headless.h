@@ -0,0 +1,6 @@
+#ifndef BB_RUNTIME_HEADLESS_H
+#define BB_RUNTIME_HEADLESS_H
+
+#include <bb/runtime/runtime.h>
+
+#endif
@@ -65,6 +65,7 @@ public:
 	}
 
 	void flip( bool vwait ){
+		bbGLFlush2D();
 	}
 
 	// graphics
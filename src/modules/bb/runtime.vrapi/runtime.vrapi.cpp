@@ -846,6 +846,7 @@ public:
 
 
 	void flip( bool vwait ){
+		bbGLFlush2D();
 		if( Ovr==NULL ){
 			return;
 		}
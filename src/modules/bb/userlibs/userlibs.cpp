@@ -69,7 +69,7 @@ const char* BBCALL _bbStrToCStr( BBStr *str ){
 
 	memcpy( t.p,str->data(),size );
 	t.p[size]=0;
-	delete str;
+	_bbStrRelease( str );
 	return t.p;
 }
 
@@ -0,0 +1,77 @@
+
+#include "workers.h"
+
+WorkerPool::WorkerPool( int threads ):
+job(0),count(0),next(0),busy(0),generation(0),quit(false){
+	for( int k=1;k<threads;++k ){
+		workers.push_back( std::thread( &WorkerPool::work,this,k ) );
+	}
+}
+
+WorkerPool::~WorkerPool(){
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		quit=true;
+	}
+	start.notify_all();
+	for( unsigned int k=0;k<workers.size();++k ) workers[k].join();
+}
+
+int WorkerPool::hardwareThreads(){
+	int n=std::thread::hardware_concurrency();
+	return n>0 ? n : 1;
+}
+
+void WorkerPool::run( int n,const Job &j ){
+	if( n<=0 ) return;
+
+	if( !workers.size() || n==1 ){
+		for( int k=0;k<n;++k ) j( k,0 );
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		job=&j;
+		count=n;
+		next=0;
+		busy=workers.size();
+		++generation;
+	}
+	start.notify_all();
+
+	drain( 0 );
+
+	std::unique_lock<std::mutex> lock( mutex );
+	done.wait( lock,[this]{ return busy==0; } );
+	job=0;
+}
+
+void WorkerPool::work( int worker ){
+	int seen=0;
+	for(;;){
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			start.wait( lock,[&]{ return quit || generation!=seen; } );
+			if( quit ) return;
+			seen=generation;
+		}
+
+		drain( worker );
+
+		std::lock_guard<std::mutex> lock( mutex );
+		if( !--busy ) done.notify_one();
+	}
+}
+
+void WorkerPool::drain( int worker ){
+	for(;;){
+		int index;
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			if( next>=count ) return;
+			index=next++;
+		}
+		(*job)( index,worker );
+	}
+}
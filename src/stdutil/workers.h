@@ -0,0 +1,44 @@
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+//Fixed set of worker threads for data parallel loops.
+//
+//run() hands out the indices [0,n) to the workers and the calling thread, and
+//returns once every index has been processed. Which worker gets which index is
+//unspecified, so callers must write results into per-index slots.
+class WorkerPool{
+public:
+	typedef std::function<void( int index,int worker )> Job;
+
+	//threads: total number of threads including the caller
+	WorkerPool( int threads );
+	~WorkerPool();
+
+	//number of threads including the caller; worker ids are [0,size())
+	int size()const{ return workers.size()+1; }
+
+	void run( int n,const Job &job );
+
+	static int hardwareThreads();
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable start,done;
+
+	const Job *job;
+	int count,next,busy,generation;
+	bool quit;
+
+	void work( int worker );
+	void drain( int worker );
+};
+
+#endif
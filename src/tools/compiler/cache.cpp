@@ -0,0 +1,188 @@
+
+#include "cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <filesystem>
+
+static const char *CACHE_MAGIC="blitzcc-cache 1";
+
+static unsigned long long hashBytes( const char *p,size_t n ){
+	//FNV-1a
+	unsigned long long h=14695981039346656037ull;
+	for( size_t k=0;k<n;++k ){
+		h^=(unsigned char)p[k];
+		h*=1099511628211ull;
+	}
+	return h;
+}
+
+static bool readFile( const std::string &path,std::string &out ){
+	std::ifstream in( path.c_str(),std::ios_base::binary );
+	if( !in ) return false;
+	std::ostringstream buf;
+	buf<<in.rdbuf();
+	out=buf.str();
+	return true;
+}
+
+std::string CompileCache::stamp( const std::string &path ){
+	std::string data;
+	if( !readFile( path,data ) ) return "";
+	std::ostringstream out;
+	out<<data.size()<<' '<<std::hex<<hashBytes( data.data(),data.size() );
+	return out.str();
+}
+
+//strings are length prefixed, so they may hold anything
+static void writeStr( std::ostream &out,const std::string &s ){
+	out<<s.size()<<':'<<s<<'\n';
+}
+
+static bool readStr( std::istream &in,std::string &s ){
+	size_t n;
+	if( !(in>>n) || in.get()!=':' ) return false;
+	s.resize( n );
+	if( n && !in.read( &s[0],n ) ) return false;
+	return in.get()=='\n';
+}
+
+static std::string cacheDir(){
+	if( const char *p=getenv( "blitzcache" ) ) return *p ? p : "";
+#ifdef WIN32
+	if( const char *p=getenv( "LOCALAPPDATA" ) ) return std::string( p )+"\\blitzcc\\cache";
+#else
+	if( const char *p=getenv( "XDG_CACHE_HOME" ) ) return std::string( p )+"/blitzcc";
+	if( const char *p=getenv( "HOME" ) ) return std::string( p )+"/.cache/blitzcc";
+#endif
+	return "";
+}
+
+CompileCache::CompileCache( const std::string &config ):config(config),n_hits(0),n_misses(0){
+	dir=cacheDir();
+	if( dir.empty() ) return;
+
+	std::error_code ec;
+	std::filesystem::create_directories( dir,ec );
+	if( ec ){
+		dir="";
+		return;
+	}
+
+	std::ifstream in( (dir+"/stats").c_str() );
+	in>>n_hits>>n_misses;
+}
+
+std::string CompileCache::entryPath( const std::string &main_file )const{
+	std::string key=config+'\n'+main_file;
+	char name[32];
+	snprintf( name,sizeof(name),"%016llx",hashBytes( key.data(),key.size() ) );
+	return dir+"/"+name;
+}
+
+void CompileCache::countLookup( bool hit ){
+	if( hit ) ++n_hits;
+	else ++n_misses;
+
+	std::ofstream out( (dir+"/stats").c_str() );
+	out<<n_hits<<' '<<n_misses<<'\n';
+}
+
+bool CompileCache::lookup( const std::string &main_file,std::string &obj,BundleInfo &bundle ){
+	if( !enabled() ) return false;
+
+	std::ifstream in( entryPath( main_file ).c_str(),std::ios_base::binary );
+
+	std::string magic,t_config,t_main;
+	bool hit=in && std::getline( in,magic ) && magic==CACHE_MAGIC &&
+		readStr( in,t_config ) && t_config==config &&
+		readStr( in,t_main ) && t_main==main_file;
+
+	//every source must be as it was
+	int n_files=0;
+	if( hit ) hit=(in>>n_files) && in.get()=='\n';
+	for( int k=0;hit && k<n_files;++k ){
+		std::string path,t_stamp;
+		hit=readStr( in,path ) && readStr( in,t_stamp ) && t_stamp==stamp( path );
+	}
+
+	BundleInfo t_bundle;
+	int n_bundled=0;
+	if( hit ){
+		t_bundle.enabled=in.get()=='1';
+		hit=in.get()=='\n' && readStr( in,t_bundle.identifier ) && readStr( in,t_bundle.appName ) && (in>>n_bundled) && in.get()=='\n';
+	}
+	for( int k=0;hit && k<n_bundled;++k ){
+		std::string rel,abs;
+		hit=readStr( in,rel ) && readStr( in,abs );
+		if( hit ) t_bundle.files.push_back( BundleFile( rel,abs ) );
+	}
+
+	std::string t_obj;
+	if( hit ) hit=readStr( in,t_obj );
+
+	countLookup( hit );
+	if( !hit ) return false;
+
+	obj.swap( t_obj );
+	bundle.enabled=t_bundle.enabled;
+	bundle.identifier=t_bundle.identifier;
+	bundle.appName=t_bundle.appName;
+	bundle.files=t_bundle.files;
+	return true;
+}
+
+void CompileCache::store( const std::string &main_file,const std::set<std::string> &includes,const std::string &obj,const BundleInfo &bundle ){
+	if( !enabled() ) return;
+
+	std::vector<std::string> files;
+	files.push_back( main_file );
+	files.insert( files.end(),includes.begin(),includes.end() );
+
+	std::string path=entryPath( main_file );
+
+	//written aside and renamed, so concurrent builds never see half an entry
+	std::ostringstream tmp_name;
+	tmp_name<<path<<".tmp"<<(size_t)this<<'.'<<rand();
+	std::string tmp=tmp_name.str();
+	{
+		std::ofstream out( tmp.c_str(),std::ios_base::binary );
+		if( !out ) return;
+
+		out<<CACHE_MAGIC<<'\n';
+		writeStr( out,config );
+		writeStr( out,main_file );
+		out<<files.size()<<'\n';
+		for( const std::string &f:files ){
+			std::string t_stamp=stamp( f );
+			if( t_stamp.empty() ){
+				out.close();
+				std::remove( tmp.c_str() );
+				return;
+			}
+			writeStr( out,f );
+			writeStr( out,t_stamp );
+		}
+		out<<(bundle.enabled ? '1' : '0')<<'\n';
+		writeStr( out,bundle.identifier );
+		writeStr( out,bundle.appName );
+		out<<bundle.files.size()<<'\n';
+		for( const BundleFile &f:bundle.files ){
+			writeStr( out,f.relativePath );
+			writeStr( out,f.absolutePath );
+		}
+		writeStr( out,obj );
+		if( !out ){
+			out.close();
+			std::remove( tmp.c_str() );
+			return;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename( tmp,path,ec );
+	if( ec ) std::remove( tmp.c_str() );
+}
@@ -0,0 +1,47 @@
+
+/*
+
+  On-disk cache of compiled programs, so an unchanged program skips straight
+  to linking or running.
+
+  An entry is keyed by the main source file and the build configuration, and
+  records the size and hash of the main file and every file it Includes; it
+  only hits while all of them are unchanged.
+
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <set>
+#include <string>
+
+#include "bundle.h"
+
+class CompileCache{
+public:
+	//config: everything besides the sources the object depends on
+	CompileCache( const std::string &config );
+
+	//false if there's nowhere to keep the cache
+	bool enabled()const{ return dir.size()>0; }
+
+	bool lookup( const std::string &main_file,std::string &obj,BundleInfo &bundle );
+	void store( const std::string &main_file,const std::set<std::string> &includes,const std::string &obj,const BundleInfo &bundle );
+
+	//size and content hash of a file, or "" if it can't be read
+	static std::string stamp( const std::string &path );
+
+	//running totals, updated by lookup()
+	int hits()const{ return n_hits; }
+	int misses()const{ return n_misses; }
+
+private:
+	std::string dir,config;
+	int n_hits,n_misses;
+
+	std::string entryPath( const std::string &main_file )const;
+	void countLookup( bool hit );
+};
+
+#endif
@@ -62,7 +62,9 @@ Codegen_C::Codegen_C(bool debug) : debug(debug), indentLevel(0), stringCounter(0
     header << "extern bb_int_t _bbStrCompare(bb_string_t a, bb_string_t b);\n";
     header << "extern bb_string_t _bbStrLoad(bb_string_t *s);\n";
     header << "extern bb_string_t _bbStrCopy(bb_string_t s);\n";
+    header << "extern bb_string_t _bbStrUnique(bb_string_t s);\n";
     header << "extern void _bbStrStore(bb_string_t *s, bb_string_t v);\n";
+    header << "extern void _bbStrAppend(bb_string_t *s, bb_string_t v);\n";
     header << "extern void _bbObjStore(void **p, bb_obj_t o);\n";
     header << "\n";
     header << "/* Object runtime functions */\n";
@@ -196,7 +198,7 @@ Codegen_C::Codegen_C(bool debug) : debug(debug), indentLevel(0), stringCounter(0
     header << "extern bb_int_t bbStringWidth(bb_string_t s);\n";
     header << "extern bb_int_t bbStringHeight(bb_string_t s);\n";
     header << "extern void bbAppTitle(bb_string_t title, bb_string_t close);\n";
-    header << "extern void bbLockBuffer(bb_int_t buffer);\n";
+    header << "extern void bbLockBuffer(bb_int_t buffer, bb_int_t write_only);\n";
     header << "extern void bbUnlockBuffer(bb_int_t buffer);\n";
     header << "extern bb_int_t bbReadPixelFast(bb_int_t x, bb_int_t y, bb_int_t buffer);\n";
     header << "extern void bbWritePixelFast(bb_int_t x, bb_int_t y, bb_int_t argb, bb_int_t buffer);\n";
@@ -3,8 +3,11 @@
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/PassManager.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/InlineAsm.h>
 #include <llvm/Analysis/CGSCCPassManager.h>
 #include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/Analysis/LoopInfo.h>
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
@@ -14,11 +17,18 @@
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/TargetParser/Host.h>
 #include <llvm/Object/Binary.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/TargetParser/SubtargetFeature.h>
+#include <llvm/TargetParser/Triple.h>
 
 #include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 
+#include <algorithm>
 #include <cstdarg>
 #include <iostream>
 
@@ -80,6 +90,20 @@ Codegen_LLVM::Codegen_LLVM( bool debug ):debug(debug),breakBlock(0) {
 	}
 }
 
+void Codegen_LLVM::hostCPU( std::string &cpu,std::string &features ){
+	//sorted, so the string is the same every time for the same host
+	std::map<std::string,bool> sorted;
+	for( auto &f:llvm::sys::getHostCPUFeatures() ){
+		sorted[f.first().str()]=f.second;
+	}
+	llvm::SubtargetFeatures host;
+	for( auto &f:sorted ){
+		host.AddFeature( f.first,f.second );
+	}
+	cpu=llvm::sys::getHostCPUName().str();
+	features=host.getString();
+}
+
 void Codegen_LLVM::SetTarget( const ::Target &t ){
 	target=t.type;
 
@@ -109,8 +133,14 @@ void Codegen_LLVM::SetTarget( const ::Target &t ){
 		exit( 1 );
 	}
 
-	auto cpu="generic";
 	std::string features="";
+	if( cpu=="native" ){
+		if( !t.host ){
+			llvm::errs()<<"-cpu native only works for the host target\n";
+			exit( 1 );
+		}
+		hostCPU( cpu,features );
+	}
 	// Disable outline atomics for Android ARM64 to avoid __aarch64_* symbol errors on older devices
 	if( (t.type=="android" || t.type=="ovr") && (t.arch=="arm64" || t.arch=="arm64-v8a") ){
 		features="-outline-atomics";
@@ -184,6 +214,24 @@ llvm::BasicBlock *Codegen_LLVM::getLabel( std::string &ident ){
 	return labels[ident];
 }
 
+llvm::BasicBlock *Codegen_LLVM::getGosubReturn(){
+	if( !gosubSwitch ){
+		llvm::IRBuilderBase::InsertPointGuard guard( *builder );
+
+		auto dispatch=llvm::BasicBlock::Create( *context,"_gosub_return",bbMain );
+		auto bad=llvm::BasicBlock::Create( *context,"_gosub_bad",bbMain );
+
+		builder->SetInsertPoint( bad );
+		builder->CreateUnreachable();
+
+		builder->SetInsertPoint( dispatch );
+		auto site=builder->CreatePtrToInt( CallIntrinsic( "_bbPopGosub",voidPtr,0 ),intTy );
+		gosubSwitch=builder->CreateSwitch( site,bad );
+	}
+
+	return gosubSwitch->getParent();
+}
+
 llvm::GlobalVariable *Codegen_LLVM::getArray( std::string &ident, int dims ){
 	if( !arrays[ident] ){
 		std::vector<llvm::Type*> els;
@@ -198,20 +246,163 @@ llvm::GlobalVariable *Codegen_LLVM::getArray( std::string &ident, int dims ){
 	return arrays[ident];
 }
 
-void Codegen_LLVM::optimize(){
-	if( debug ){
+void Codegen_LLVM::linkIntrinsics(){
+	if( intrinsicsPath.empty() ) return;
+
+	// without the bitcode the calls simply stay calls
+	auto buf=llvm::MemoryBuffer::getFile( intrinsicsPath );
+	if( !buf ) return;
+
+	auto parsed=llvm::parseBitcodeFile( (*buf)->getMemBufferRef(),*context );
+	if( !parsed ){
+		llvm::consumeError( parsed.takeError() );
 		return;
 	}
+	std::unique_ptr<llvm::Module> rt=std::move( *parsed );
 
-	// until the gosub implementation is improved, we have to relax optimization
-	// to avoid long build times...
-	if( gosubUsed ){
-		targetMachine->setOptLevel( llvm::CodeGenOptLevel::None );
-		targetMachine->setFastISel( false );
-		targetMachine->setGlobalISel( false );
+	llvm::Triple tt( module->getTargetTriple() ),rtt( rt->getTargetTriple() );
+	if( tt.getArch()!=rtt.getArch() || tt.getOS()!=rtt.getOS() || rt->getDataLayout()!=module->getDataLayout() ){
 		return;
 	}
 
+	// only the bodies are wanted: anything left uninlined still calls into the
+	// runtime, and is compiled for the same cpu as the rest of the program
+	for( auto &f:*rt ){
+		if( f.isDeclaration() ) continue;
+		f.setLinkage( llvm::GlobalValue::AvailableExternallyLinkage );
+		f.removeFnAttr( "target-cpu" );
+		f.removeFnAttr( "target-features" );
+		f.removeFnAttr( "tune-cpu" );
+	}
+
+	llvm::Linker::linkModules( *module,std::move( rt ),llvm::Linker::Flags::LinkOnlyNeeded );
+}
+
+// sets bbCpuLevel to 1 when the cpu and the OS both support AVX2 and FMA
+static llvm::Function *cpuLevelCheck( llvm::Module &mod,llvm::GlobalVariable *level ){
+	auto &ctx=mod.getContext();
+	auto i32=llvm::Type::getInt32Ty( ctx );
+	auto regs=llvm::StructType::get( ctx,{ i32,i32,i32,i32 } );
+
+	auto cpuid=llvm::InlineAsm::get(
+		llvm::FunctionType::get( regs,{ i32,i32 },false ),
+		"cpuid","={ax},={bx},={cx},={dx},{ax},{cx},~{dirflag},~{fpsr},~{flags}",false
+	);
+	auto xgetbv=llvm::InlineAsm::get(
+		llvm::FunctionType::get( llvm::StructType::get( ctx,{ i32,i32 } ),{ i32 },false ),
+		"xgetbv","={ax},={dx},{cx},~{dirflag},~{fpsr},~{flags}",false
+	);
+
+	auto func=llvm::Function::Create( llvm::FunctionType::get( llvm::Type::getVoidTy( ctx ),false ),llvm::GlobalValue::InternalLinkage,"bbCheckCpu",mod );
+	auto entry=llvm::BasicBlock::Create( ctx,"entry",func );
+	auto avx=llvm::BasicBlock::Create( ctx,"avx",func );
+	auto done=llvm::BasicBlock::Create( ctx,"done",func );
+
+	llvm::IRBuilder<> b( entry );
+
+	auto bits=[&]( llvm::Value *v,uint32_t mask ){
+		return b.CreateICmpEQ( b.CreateAnd( v,mask ),b.getInt32( mask ) );
+	};
+
+	// FMA, OSXSAVE and AVX, before xgetbv may even be used
+	auto leaf1=b.CreateCall( cpuid,{ b.getInt32( 1 ),b.getInt32( 0 ) } );
+	b.CreateCondBr( bits( b.CreateExtractValue( leaf1,2 ),(1u<<12)|(1u<<27)|(1u<<28) ),avx,done );
+
+	// the OS saves the ymm registers, and the cpu has AVX2
+	b.SetInsertPoint( avx );
+	auto xcr0=b.CreateCall( xgetbv,{ b.getInt32( 0 ) } );
+	auto leaf7=b.CreateCall( cpuid,{ b.getInt32( 7 ),b.getInt32( 0 ) } );
+	auto ok=b.CreateAnd( bits( b.CreateExtractValue( xcr0,0 ),6 ),bits( b.CreateExtractValue( leaf7,1 ),1u<<5 ) );
+	b.CreateStore( b.CreateZExt( ok,i32 ),level );
+	b.CreateBr( done );
+
+	b.SetInsertPoint( done );
+	b.CreateRetVoid();
+
+	return func;
+}
+
+void Codegen_LLVM::multiversion(){
+	if( debug ) return;
+
+	llvm::Triple tt( module->getTargetTriple() );
+	if( !tt.isX86() ){
+		llvm::errs()<<"warning: -multiversion is only supported on x86 targets\n";
+		return;
+	}
+
+	std::vector<llvm::Function*> funcs;
+	for( auto &f:*module ){
+		if( f.isDeclaration() || f.isVarArg() ) continue;
+		if( &f!=bbMain && !f.getName().starts_with( "f" ) ) continue;
+
+		llvm::DominatorTree dt( f );
+		llvm::LoopInfo li( dt );
+		if( li.empty() ) continue;
+
+		funcs.push_back( &f );
+	}
+	if( funcs.empty() ) return;
+
+	auto i32=llvm::Type::getInt32Ty( *context );
+	auto level=new llvm::GlobalVariable( *module,i32,false,llvm::GlobalValue::InternalLinkage,llvm::ConstantInt::get( i32,0 ),"bbCpuLevel" );
+
+	// the main program always runs first, so it checks the cpu for everyone
+	auto check=cpuLevelCheck( *module,level );
+	if( std::find( funcs.begin(),funcs.end(),bbMain )==funcs.end() ){
+		llvm::IRBuilder<> b( &*bbMain->getEntryBlock().getFirstInsertionPt() );
+		b.CreateCall( check );
+	}
+
+	std::string features=targetMachine->getTargetFeatureString().str();
+	if( features.size() ) features+=",";
+	features+="+avx2,+fma";
+
+	for( auto f:funcs ){
+		llvm::ValueToValueMapTy vmap;
+		auto fast=llvm::CloneFunction( f,vmap );
+		fast->setName( f->getName()+"$avx2" );
+		fast->setLinkage( llvm::GlobalValue::InternalLinkage );
+		fast->addFnAttr( "target-features",features );
+
+		// a new entry block picks the copy; static allocas move up into it, so
+		// they still get promoted to registers
+		auto body=&f->getEntryBlock();
+		std::vector<llvm::AllocaInst*> allocas;
+		for( auto &inst:*body ){
+			auto alloca=llvm::dyn_cast<llvm::AllocaInst>( &inst );
+			if( alloca && alloca->isStaticAlloca() ) allocas.push_back( alloca );
+		}
+
+		auto entry=llvm::BasicBlock::Create( *context,"multiversion",f,body );
+		auto jump=llvm::BasicBlock::Create( *context,"avx2",f,body );
+
+		llvm::IRBuilder<> b( entry );
+		if( f==bbMain ) b.CreateCall( check );
+		b.CreateCondBr( b.CreateICmpNE( b.CreateLoad( i32,level ),b.getInt32( 0 ) ),jump,body );
+
+		for( auto alloca:allocas ) alloca->moveBefore( entry->getTerminator() );
+
+		b.SetInsertPoint( jump );
+		std::vector<llvm::Value*> args;
+		for( auto &arg:f->args() ) args.push_back( &arg );
+		auto call=b.CreateCall( fast,args );
+		call->setTailCallKind( llvm::CallInst::TCK_MustTail );
+		if( f->getReturnType()->isVoidTy() ){
+			b.CreateRetVoid();
+		}else{
+			b.CreateRet( call );
+		}
+	}
+}
+
+void Codegen_LLVM::optimize(){
+	if( debug ){
+		return;
+	}
+
+	linkIntrinsics();
+
 	llvm::LoopAnalysisManager LAM;
 	llvm::FunctionAnalysisManager FAM;
 	llvm::CGSCCAnalysisManager CGAM;
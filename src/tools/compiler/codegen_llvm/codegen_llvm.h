@@ -16,7 +16,6 @@ public:
 
 	std::string target="native";
 	bool debug;
-	bool gosubUsed=false;
 
 	std::unique_ptr<llvm::LLVMContext> context;
 	std::unique_ptr<llvm::Module> module;
@@ -59,12 +58,33 @@ public:
 	std::vector<llvm::Constant*> data_values;
 
 	llvm::BasicBlock *getLabel( std::string &ident );
+
+	// Gosub pushes the index of its return site, and every Return branches to
+	// a single block that switches on the popped index; no block address is
+	// ever taken, so the optimizer sees an ordinary CFG
+	llvm::SwitchInst *gosubSwitch=0;
+	llvm::BasicBlock *getGosubReturn();
 	llvm::GlobalVariable *getArray( std::string &ident,int dims );
 
 	llvm::Function *bbMain;
 
+	// "generic", "native" for the host's own cpu and features, or any cpu
+	// name llvm knows; set before SetTarget
+	std::string cpu="generic";
 	void SetTarget( const Target &target );
 
+	// what "native" resolves to: the host's cpu name and feature string
+	static void hostCPU( std::string &cpu,std::string &features );
+
+	// gives user functions with loops, and the main program, a second copy
+	// built for AVX2 and FMA, picked once at startup by checking the cpu; a
+	// generic executable still gets the wider vectors where they exist
+	void multiversion();
+
+	// runtime primitives as bitcode, inlined by optimize() when present
+	std::string intrinsicsPath;
+	void linkIntrinsics();
+
 	void optimize();
 	bool verify();
 
@@ -16,6 +16,8 @@
 #include "tree/decl.h"
 #include "tree/label.h"
 
+struct ForNode;
+
 class Environ{
 public:
 	int level;
@@ -31,6 +33,8 @@ public:
 	std::string funcLabel,breakLabel;
 	std::list<Environ*> children;		//for delete!
 
+	std::vector<ForNode*> loops;		//For loops being semanted, innermost last
+
 	Environ( const std::string &f,Type *r,int l,Environ *gs );
 	~Environ();
 
@@ -1,10 +1,11 @@
 #include "jit_orc.h"
+#include "tiering.h"
 
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 
-int JIT_ORC::run( Runtime *runtime,const std::string &obj, const std::string &home, const std::string &rt,std::string &args ) {
-	auto J=llvm::cantFail( llvm::orc::LLJITBuilder().create() );
-
+static llvm::orc::SymbolMap runtimeSymbols( llvm::orc::LLJIT &J,Runtime *runtime ){
 	std::map<const char*,void*> syms;
 	runtime->loadSyms( syms );
 
@@ -21,11 +22,18 @@ int JIT_ORC::run( Runtime *runtime,const std::string &obj, const std::string &ho
 
 		symmap.insert(
 			std::pair< llvm::orc::SymbolStringPtr,llvm::orc::ExecutorSymbolDef >(
-				J->mangleAndIntern( ident ),
+				J.mangleAndIntern( ident ),
 				llvm::orc::ExecutorSymbolDef( llvm::orc::ExecutorAddr( (uint64_t)sym.second ),llvm::JITSymbolFlags::Absolute|llvm::JITSymbolFlags::Exported )
 			)
 		);
 	}
+	return symmap;
+}
+
+int JIT_ORC::run( Runtime *runtime,const std::string &obj, const std::string &home, const std::string &rt,std::string &args ) {
+	auto J=llvm::cantFail( llvm::orc::LLJITBuilder().create() );
+
+	auto symmap=runtimeSymbols( *J,runtime );
 
 	auto RT=J->getMainJITDylib().createResourceTracker();
 	llvm::cantFail( J->getMainJITDylib().define( llvm::orc::absoluteSymbols( symmap ),RT ) );
@@ -45,3 +53,32 @@ int JIT_ORC::run( Runtime *runtime,const std::string &obj, const std::string &ho
 
 	return retcode;
 }
+
+int JIT_ORC::runLazy( Runtime *runtime,std::unique_ptr<llvm::LLVMContext> context,std::unique_ptr<llvm::Module> module,const std::string &home,const std::string &rt,std::string &args ) {
+	// first calls get a quick -O0 compile, and Tiering takes care of the rest
+	auto jtmb=llvm::cantFail( llvm::orc::JITTargetMachineBuilder::detectHost() );
+	jtmb.setCodeGenOptLevel( llvm::CodeGenOptLevel::None );
+
+	auto J=llvm::cantFail( llvm::orc::LLLazyJITBuilder().setJITTargetMachineBuilder( jtmb ).create() );
+	J->setPartitionFunction( llvm::orc::CompileOnDemandLayer::compileRequested );
+
+	llvm::cantFail( J->getMainJITDylib().define( llvm::orc::absoluteSymbols( runtimeSymbols( *J,runtime ) ) ) );
+
+	Tiering tiering( *J,jtmb );
+	tiering.prepare( *module );
+
+	module->setDataLayout( J->getDataLayout() );
+	llvm::cantFail( J->addLazyIRModule( llvm::orc::ThreadSafeModule( std::move( module ),std::move( context ) ) ) );
+
+	auto main_sym=cantFail( J->lookup( "bbMain" ) );
+	auto start_sym=cantFail( J->lookup( "_bbStart" ) );
+	BBMAIN bbMain=(BBMAIN)main_sym.getValue();
+	BBSTART bbStart=(BBSTART)start_sym.getValue();
+
+	const char *argv[2]={ "blitzcc",args.c_str() };
+	int retcode=bbStart( 2, (char**)argv, bbMain );
+
+	tiering.stop();
+
+	return retcode;
+}
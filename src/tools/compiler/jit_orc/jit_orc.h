@@ -3,12 +3,24 @@
 
 #include "../libs.h"
 
+#include <memory>
+#include <string>
+
+namespace llvm{
+	class LLVMContext;
+	class Module;
+}
+
 typedef void (*BBMAIN)();
 typedef int (*BBSTART)( int,char**,BBMAIN );
 
 class JIT_ORC {
 public:
 	static int run( Runtime *runtime,const std::string &obj,const std::string &home,const std::string &rt,std::string &args );
+
+	// compiles functions as they're first called, and hot ones again with
+	// full optimization in the background; module must not be optimized yet
+	static int runLazy( Runtime *runtime,std::unique_ptr<llvm::LLVMContext> context,std::unique_ptr<llvm::Module> module,const std::string &home,const std::string &rt,std::string &args );
 };
 
 
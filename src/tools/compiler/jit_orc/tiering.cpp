@@ -0,0 +1,293 @@
+#include "tiering.h"
+
+#include <llvm/Analysis/CGSCCPassManager.h>
+#include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <atomic>
+#include <set>
+
+// calls before a function is rebuilt with full optimization
+static const int TIER_UP_CALLS=100;
+
+// the stubs can only reach one instance
+static Tiering *active;
+
+Tiering::Tiering( llvm::orc::LLJIT &jit,const llvm::orc::JITTargetMachineBuilder &jtmb ):jit(jit),jtmb(jtmb),quit(false),n_tiered(0){
+	active=this;
+	worker=std::thread( &Tiering::work,this );
+}
+
+Tiering::~Tiering(){
+	stop();
+	if( active==this ) active=0;
+}
+
+void Tiering::prepare( llvm::Module &mod ){
+	// optimized builds live in modules of their own, so everything they might
+	// refer to needs a name and has to be visible
+	for( auto &gv:mod.global_values() ){
+		if( gv.isDeclaration() ) continue;
+		if( !gv.hasName() ) gv.setName( "__bb_anon" );
+		if( gv.hasLocalLinkage() ) gv.setLinkage( llvm::GlobalValue::ExternalLinkage );
+	}
+
+	llvm::raw_svector_ostream os( original );
+	llvm::WriteBitcodeToFile( mod,os );
+
+	std::vector<llvm::Function*> funcs;
+	for( auto &f:mod ){
+		if( !f.isDeclaration() && !f.isVarArg() ) funcs.push_back( &f );
+	}
+
+	// the tables live out here rather than in the program, so tiering up never
+	// has to look anything up through the lazy layers
+	code.reset( new std::atomic<void*>[funcs.size()] );
+	calls.reset( new int32_t[funcs.size()] );
+	for( int k=0;k<(int)funcs.size();++k ){
+		code[k]=0;
+		calls[k]=0;
+	}
+	requested.resize( funcs.size() );
+
+	auto flags=llvm::JITSymbolFlags::Absolute|llvm::JITSymbolFlags::Exported;
+	llvm::orc::SymbolMap symmap;
+	symmap[jit.mangleAndIntern( "__bbTierUp" )]=llvm::orc::ExecutorSymbolDef( llvm::orc::ExecutorAddr::fromPtr( &Tiering::hook ),flags );
+	symmap[jit.mangleAndIntern( "__bbTierCode" )]=llvm::orc::ExecutorSymbolDef( llvm::orc::ExecutorAddr::fromPtr( code.get() ),flags );
+	symmap[jit.mangleAndIntern( "__bbTierCalls" )]=llvm::orc::ExecutorSymbolDef( llvm::orc::ExecutorAddr::fromPtr( calls.get() ),flags );
+	llvm::cantFail( jit.getMainJITDylib().define( llvm::orc::absoluteSymbols( symmap ) ) );
+
+	llvm::LLVMContext &ctx=mod.getContext();
+	const llvm::DataLayout &dl=mod.getDataLayout();
+	auto voidTy=llvm::Type::getVoidTy( ctx );
+	auto i32=llvm::Type::getInt32Ty( ctx );
+	auto i64=llvm::Type::getInt64Ty( ctx );
+	auto ptrTy=llvm::PointerType::get( ctx,0 );
+
+	auto hookFn=llvm::Function::Create( llvm::FunctionType::get( voidTy,{ i64 },false ),llvm::GlobalValue::ExternalLinkage,"__bbTierUp",mod );
+	auto codeTable=new llvm::GlobalVariable( mod,llvm::ArrayType::get( ptrTy,0 ),false,llvm::GlobalValue::ExternalLinkage,nullptr,"__bbTierCode" );
+	auto callsTable=new llvm::GlobalVariable( mod,llvm::ArrayType::get( i32,0 ),false,llvm::GlobalValue::ExternalLinkage,nullptr,"__bbTierCalls" );
+
+	for( auto f:funcs ){
+		int id=names.size();
+		std::string name=f->getName().str();
+		names.push_back( name );
+
+		// the body becomes tier 0, and the stub takes over its name and callers
+		f->setName( name+"$0" );
+		auto stub=llvm::Function::Create( f->getFunctionType(),llvm::GlobalValue::ExternalLinkage,name,mod );
+		stub->setCallingConv( f->getCallingConv() );
+		f->replaceAllUsesWith( stub );
+
+		auto entry=llvm::BasicBlock::Create( ctx,"entry",stub );
+		auto hot=llvm::BasicBlock::Create( ctx,"hot",stub );
+		auto dispatch=llvm::BasicBlock::Create( ctx,"dispatch",stub );
+		auto tier0=llvm::BasicBlock::Create( ctx,"tier0",stub );
+		auto tier1=llvm::BasicBlock::Create( ctx,"tier1",stub );
+		llvm::IRBuilder<> b( entry );
+
+		// racy, but a lost count only puts the tier up off a little
+		auto count=b.CreateConstInBoundsGEP2_64( callsTable->getValueType(),callsTable,0,id );
+		auto n=b.CreateAlignedLoad( i32,count,llvm::Align( 4 ) );
+		n->setAtomic( llvm::AtomicOrdering::Monotonic );
+		auto n2=b.CreateAdd( n,llvm::ConstantInt::get( i32,1 ) );
+		b.CreateAlignedStore( n2,count,llvm::Align( 4 ) )->setAtomic( llvm::AtomicOrdering::Monotonic );
+		b.CreateCondBr( b.CreateICmpEQ( n2,llvm::ConstantInt::get( i32,TIER_UP_CALLS ) ),hot,dispatch );
+
+		b.SetInsertPoint( hot );
+		b.CreateCall( hookFn,{ llvm::ConstantInt::get( i64,id ) } );
+		b.CreateBr( dispatch );
+
+		b.SetInsertPoint( dispatch );
+		auto slot=b.CreateConstInBoundsGEP2_64( codeTable->getValueType(),codeTable,0,id );
+		auto target=b.CreateAlignedLoad( ptrTy,slot,dl.getPointerABIAlignment( 0 ) );
+		target->setAtomic( llvm::AtomicOrdering::Acquire );
+		b.CreateCondBr( b.CreateIsNull( target ),tier0,tier1 );
+
+		std::vector<llvm::Value*> args;
+		for( auto &arg:stub->args() ) args.push_back( &arg );
+
+		llvm::BasicBlock *blocks[]={ tier0,tier1 };
+		llvm::Value *callees[]={ f,target };
+		for( int k=0;k<2;++k ){
+			b.SetInsertPoint( blocks[k] );
+			auto ret=b.CreateCall( f->getFunctionType(),callees[k],args );
+			ret->setCallingConv( f->getCallingConv() );
+			ret->setTailCallKind( llvm::CallInst::TCK_MustTail );
+			if( ret->getType()->isVoidTy() ){
+				b.CreateRetVoid();
+			}else{
+				b.CreateRet( ret );
+			}
+		}
+	}
+}
+
+void Tiering::stop(){
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		quit=true;
+		queue.clear();
+	}
+	wake.notify_one();
+	if( worker.joinable() ) worker.join();
+}
+
+void Tiering::hook( int64_t id ){
+	if( active ) active->request( id );
+}
+
+void Tiering::request( int id ){
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		if( quit || id<0 || id>=(int)requested.size() || requested[id] ) return;
+		requested[id]=1;
+		queue.push_back( id );
+	}
+	wake.notify_one();
+}
+
+void Tiering::work(){
+	llvm::orc::JITTargetMachineBuilder optJtmb=jtmb;
+	optJtmb.setCodeGenOptLevel( llvm::CodeGenOptLevel::Aggressive );
+	auto tm=optJtmb.createTargetMachine();
+	if( !tm ){
+		llvm::consumeError( tm.takeError() );
+		return;
+	}
+
+	for(;;){
+		int id;
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			wake.wait( lock,[this]{ return quit || queue.size(); } );
+			if( quit ) return;
+			id=queue.front();
+			queue.pop_front();
+		}
+
+		if( tierUp( id,tm->get() ) ) ++n_tiered;
+	}
+}
+
+static bool loaded( llvm::Error err ){
+	if( !err ) return true;
+	llvm::consumeError( std::move( err ) );
+	return false;
+}
+
+bool Tiering::tierUp( int id,llvm::TargetMachine *tm ){
+	const std::string &name=names[id];
+
+	// only the bodies that are wanted get loaded, so a tier up costs about
+	// the same however big the program is
+	llvm::LLVMContext ctx;
+	llvm::MemoryBufferRef buf( llvm::StringRef( original.data(),original.size() ),name );
+	auto parsed=llvm::getLazyBitcodeModule( buf,ctx );
+	if( !parsed ){
+		llvm::consumeError( parsed.takeError() );
+		return false;
+	}
+	std::unique_ptr<llvm::Module> mod=std::move( *parsed );
+
+	llvm::Function *func=mod->getFunction( name );
+	if( !func || !loaded( func->materialize() ) ) return false;
+
+	// bodies of direct callees are kept for the inliner; calls that aren't
+	// inlined still go through their stubs
+	std::set<llvm::Function*> callees;
+	for( auto &bb:*func ){
+		for( auto &inst:bb ){
+			if( auto call=llvm::dyn_cast<llvm::CallBase>( &inst ) ){
+				if( auto callee=call->getCalledFunction() ) callees.insert( callee );
+			}
+		}
+	}
+	for( auto callee:callees ){
+		if( callee==func || !callee->isMaterializable() ) continue;
+		if( !loaded( callee->materialize() ) ) return false;
+		callee->setLinkage( llvm::GlobalValue::AvailableExternallyLinkage );
+	}
+
+	// everything else becomes a plain declaration
+	std::vector<llvm::Function*> unused;
+	for( auto &f:*mod ){
+		if( f.isMaterializable() ) unused.push_back( &f );
+	}
+	for( auto f:unused ){
+		auto decl=llvm::Function::Create( f->getFunctionType(),llvm::GlobalValue::ExternalLinkage,"",mod.get() );
+		decl->takeName( f );
+		decl->setCallingConv( f->getCallingConv() );
+		decl->setAttributes( f->getAttributes() );
+		f->replaceAllUsesWith( decl );
+		f->eraseFromParent();
+	}
+	if( !loaded( mod->materializeMetadata() ) ) return false;
+
+	for( auto &gv:mod->globals() ){
+		if( gv.isDeclaration() ) continue;
+		gv.setInitializer( nullptr );
+		gv.setLinkage( llvm::GlobalValue::ExternalLinkage );
+	}
+
+	// module passes visit every declaration, so drop the ones not needed
+	for( auto it=mod->begin();it!=mod->end(); ){
+		llvm::Function &f=*it++;
+		if( f.isDeclaration() && f.use_empty() ) f.eraseFromParent();
+	}
+	for( auto it=mod->global_begin();it!=mod->global_end(); ){
+		llvm::GlobalVariable &gv=*it++;
+		if( gv.use_empty() ) gv.eraseFromParent();
+	}
+
+	func->setName( name+"$1" );
+
+	{
+		llvm::LoopAnalysisManager LAM;
+		llvm::FunctionAnalysisManager FAM;
+		llvm::CGSCCAnalysisManager CGAM;
+		llvm::ModuleAnalysisManager MAM;
+
+		llvm::PassBuilder PB( tm );
+
+		PB.registerModuleAnalyses( MAM );
+		PB.registerCGSCCAnalyses( CGAM );
+		PB.registerFunctionAnalyses( FAM );
+		PB.registerLoopAnalyses( LAM );
+		PB.crossRegisterProxies( LAM,FAM,CGAM,MAM );
+
+		llvm::ModulePassManager MPM=PB.buildPerModuleDefaultPipeline( llvm::OptimizationLevel::O3 );
+		MPM.run( *mod,MAM );
+	}
+
+	llvm::SmallVector<char,0> obj;
+	{
+		llvm::raw_svector_ostream os( obj );
+		llvm::legacy::PassManager pass;
+		if( tm->addPassesToEmitFile( pass,os,nullptr,llvm::CodeGenFileType::ObjectFile ) ) return false;
+		pass.run( *mod );
+	}
+
+	auto objBuf=llvm::MemoryBuffer::getMemBufferCopy( llvm::StringRef( obj.data(),obj.size() ),name+"$1" );
+	if( auto err=jit.addObjectFile( std::move( objBuf ) ) ){
+		llvm::consumeError( std::move( err ) );
+		return false;
+	}
+
+	auto addr=jit.lookup( name+"$1" );
+	if( !addr ){
+		llvm::consumeError( addr.takeError() );
+		return false;
+	}
+
+	// pairs with the acquire load in the stub
+	code[id].store( addr->toPtr<void*>(),std::memory_order_release );
+	return true;
+}
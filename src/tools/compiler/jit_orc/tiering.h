@@ -0,0 +1,64 @@
+#ifndef TIERING_H
+#define TIERING_H
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ADT/SmallVector.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tiered compilation for the lazy JIT.
+//
+// prepare() puts a stub in front of every function, which counts its calls
+// and jumps through a pointer to the unoptimized body. Once a function gets
+// hot, its stub asks for it to be rebuilt at -O3 from a copy of the original
+// program, with its callees available for inlining. That happens on a
+// background thread, and the new code is swapped in by updating the pointer;
+// calls already in progress carry on in the old code.
+class Tiering{
+public:
+	Tiering( llvm::orc::LLJIT &jit,const llvm::orc::JITTargetMachineBuilder &jtmb );
+	~Tiering();
+
+	// call before handing mod to the JIT
+	void prepare( llvm::Module &mod );
+
+	// waits for the compile in progress, and drops the rest
+	void stop();
+
+	int tieredUp()const{ return n_tiered; }
+
+private:
+	llvm::orc::LLJIT &jit;
+	llvm::orc::JITTargetMachineBuilder jtmb;
+
+	// the program as it was before prepare()
+	llvm::SmallVector<char,0> original;
+	std::vector<std::string> names;
+
+	// per function: code of the current tier, or 0 for tier 0, and calls so far
+	std::unique_ptr<std::atomic<void*>[]> code;
+	std::unique_ptr<int32_t[]> calls;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<int> queue;
+	std::vector<char> requested;
+	bool quit;
+	int n_tiered;
+
+	static void hook( int64_t id );
+	void request( int id );
+	void work();
+	bool tierUp( int id,llvm::TargetMachine *tm );
+};
+
+#endif
@@ -14,6 +14,7 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
@@ -33,6 +34,7 @@
 
 #ifdef USE_LLVM
 #include "codegen_llvm/codegen_llvm.h"
+#include "cache.h"
 #include "linker_lld/linker_lld.h"
 #include "jit_orc/jit_orc.h"
 #endif
@@ -118,6 +120,7 @@ static void showUsage(){
 static void showHelp(){
 	showUsage();
 	std::cout<<"-a         : dump asm"<<std::endl;
+	std::cout<<"-cpu name  : llvm target cpu: generic (default), native, or a cpu name"<<std::endl;
 	std::cout<<"-h         : show this help"<<std::endl;
 	std::cout<<"-q         : quiet mode"<<std::endl;
 	std::cout<<"+q         : very quiet mode"<<std::endl;
@@ -126,7 +129,10 @@ static void showHelp(){
 	std::cout<<"-j         : dump json ast"<<std::endl;
 	std::cout<<"-k         : dump keywords"<<std::endl;
 	std::cout<<"+k         : dump keywords and syntax"<<std::endl;
+	std::cout<<"-lazy      : run with a lazy, tiered llvm jit, for quicker startup"<<std::endl;
 	std::cout<<"-llvm      : use llvm"<<std::endl;
+	std::cout<<"-multiversion : also build loops for AVX2 cpus, picked at startup"<<std::endl;
+	std::cout<<"-nocache   : always recompile, ignoring the compile cache"<<std::endl;
 	std::cout<<"-r         : list available runtimes"<<std::endl;
 	std::cout<<"-v         : version info"<<std::endl;
 	std::cout<<"-o exefile : generate executable"<<std::endl;
@@ -346,7 +352,8 @@ int main( int argc,char *argv[] ){
 	bool usellvm=false;
 	bool usegcc=false;
 #endif
-	bool versinfo=false,rtinfo=false;
+	bool versinfo=false,rtinfo=false,nocache=false,lazy=false,multiversion=false;
+	std::string cpu="generic";
 
 	for( int k=1;k<argc;++k ){
 
@@ -380,6 +387,15 @@ int main( int argc,char *argv[] ){
 		}else if( t=="-gcc" ){
 			usegcc=true;
 			usellvm=false;
+		}else if( t=="-lazy" ){
+			lazy=true;
+		}else if( t=="-cpu" ){
+			if( k==argc-1 ) usageErr();
+			cpu=tolower( argv[++k] );
+		}else if( t=="-multiversion" ){
+			multiversion=true;
+		}else if( t=="-nocache" ){
+			nocache=true;
 		}else if( t=="-v" ){
 			versinfo=true;
 		}else if( t=="-e" ){
@@ -489,6 +505,7 @@ int main( int argc,char *argv[] ){
 
 	std::ifstream in( in_file.c_str() );
 	if( !in ) err( "Unable to open input file" );
+	std::string main_path=fullfilename( in_file );
 	if( !quiet ){
 		showInfo();
 		std::cout<<"Compiling \""<<in_file<<"\""<<std::endl;
@@ -520,95 +537,140 @@ int main( int argc,char *argv[] ){
 
 #ifdef USE_LLVM
 	std::string obj_code;
+
+	//the object also depends on the compiler, and how and what for it's built.
+	//native goes in as the cpu and features it resolves to on this host, so a
+	//shared cache never hands back code built for another machine's cpu
+	std::string cache_cpu=cpu;
+	if( cpu=="native" && target.host ){
+		std::string features;
+		Codegen_LLVM::hostCPU( cache_cpu,features );
+		cache_cpu+=' '+features;
+	}
+	std::ostringstream cache_config;
+	cache_config<<VERSION<<' '<<__DATE__<<' '<<__TIME__<<'\n';
+	cache_config<<target.triple<<' '<<target.type<<' '<<rt<<'\n';
+	cache_config<<debug<<' '<<out_file.size()<<' '<<cache_cpu<<' '<<multiversion<<'\n';
+	cache_config<<CompileCache::stamp( home+"/bin/"+target.triple+"/lib/blitz.bc" );
+	CompileCache cache( cache_config.str() );
+
+	//the lazy jit starts from unoptimized IR rather than an object
+	bool lazyjit=usellvm && lazy && !out_file.size() && !debug;
+	std::unique_ptr<llvm::LLVMContext> jit_context;
+	std::unique_ptr<llvm::Module> jit_module;
+
+	bool usecache=usellvm && !nocache && !dumptree && !dumpasm && !lazyjit && cache.enabled();
 #endif
 
 	try{
-		//parse
-		if( !veryquiet ) std::cout<<"Parsing..."<<std::endl;
-		Toker toker( in );
-		Parser parser( toker );
-		prog=parser.parse( in_file );
+		bool cached=false;
+#ifdef USE_LLVM
+		if( usecache ){
+			cached=cache.lookup( main_path,obj_code,bundle );
+			if( !quiet ) std::cout<<"Cache "<<(cached ? "hit" : "miss")<<" ("<<cache.hits()<<" hits, "<<cache.misses()<<" misses)"<<std::endl;
+		}
+#endif
 
-		bundle=parser.bundle;
-		bundle.signerId = signerId;
-		bundle.teamId = teamId;
-		bundle.sourceDir = srcDirPath;
+		if( !cached ){
+			//parse
+			if( !veryquiet ) std::cout<<"Parsing..."<<std::endl;
+			Toker toker( in );
+			Parser parser( toker );
+			prog=parser.parse( in_file );
 
-		//semant
-		if( !veryquiet ) std::cout<<"Generating..."<<std::endl;
-		env=prog->semant( runtimeEnviron );
+			bundle=parser.bundle;
 
-		if( dumptree ){
-			std::cout<<prog->toJSON( debug ).dump(2)<<std::endl;
-			return 0;
-		}
+			//semant
+			if( !veryquiet ) std::cout<<"Generating..."<<std::endl;
+			env=prog->semant( runtimeEnviron );
+
+			if( dumptree ){
+				std::cout<<prog->toJSON( debug ).dump(2)<<std::endl;
+				return 0;
+			}
 
-		//translate
-		if( !veryquiet ) std::cout<<"Translating..."<<std::endl;
+			//translate
+			if( !veryquiet ) std::cout<<"Translating..."<<std::endl;
 
-		qstreambuf qbuf;
-		std::iostream asmcode( &qbuf );
-		Codegen_x86 codegen( asmcode,debug );
+			qstreambuf qbuf;
+			std::iostream asmcode( &qbuf );
+			Codegen_x86 codegen( asmcode,debug );
 #ifdef USE_LLVM
-		Codegen_LLVM codegen2( debug );
-		codegen2.SetTarget( target );
+			Codegen_LLVM codegen2( debug );
+			codegen2.cpu=cpu;
+			codegen2.SetTarget( target );
+			codegen2.intrinsicsPath=home+"/bin/"+target.triple+"/lib/blitz.bc";
 #endif
 #ifdef USE_GCC_BACKEND
-		Codegen_C codegen3( debug );
-		codegen3.SetTarget( target );
+			Codegen_C codegen3( debug );
+			codegen3.SetTarget( target );
 #endif
 
-		if ( usellvm ) {
+			if ( usellvm ) {
 #ifdef USE_LLVM
-			prog->translate2( &codegen2,userFuncs );
+				prog->translate2( &codegen2,userFuncs );
 
-			if( out_file.size() ){
-				codegen2.injectMain();
-			}
-			codegen2.optimize();
+				if( out_file.size() ){
+					codegen2.injectMain();
+				}
+				if( !lazyjit ){
+					if( multiversion ) codegen2.multiversion();
+					codegen2.optimize();
+				}
 
-			if( dumpasm ){
-				codegen2.dumpToStderr();
-			}
+				if( dumpasm ){
+					codegen2.dumpToStderr();
+				}
 #endif
-		} else if ( usegcc ) {
+			} else if ( usegcc ) {
 #ifdef USE_GCC_BACKEND
-			prog->translate3( &codegen3,userFuncs );
-			c_code = codegen3.generateOutput();
+				prog->translate3( &codegen3,userFuncs );
+				c_code = codegen3.generateOutput();
 
-			if( dumpasm ){
-				std::cout<<std::endl<<c_code<<std::endl;
-			}
+				if( dumpasm ){
+					std::cout<<std::endl<<c_code<<std::endl;
+				}
 #endif
-		} else {
-			prog->translate( &codegen,userFuncs );
+			} else {
+				prog->translate( &codegen,userFuncs );
 
-			if( dumpasm ){
-				std::cout<<std::endl<<std::string( qbuf.data(),qbuf.size() )<<std::endl;
+				if( dumpasm ){
+					std::cout<<std::endl<<std::string( qbuf.data(),qbuf.size() )<<std::endl;
+				}
 			}
-		}
 
-		if( bundle.enabled && out_file.size() && target.host ){
-#ifdef BB_MACOS
-			out_file+=".app";
-#endif
-		}
-
-		//assemble
-		if( !veryquiet ) std::cout<<"Assembling..."<<std::endl;
+			//assemble
+			if( !veryquiet ) std::cout<<"Assembling..."<<std::endl;
 
-		if ( usellvm ) {
+			if ( usellvm ) {
 #ifdef USE_LLVM
-			codegen2.dumpToObj( obj_code );
+				if( lazyjit ){
+					jit_context=std::move( codegen2.context );
+					jit_module=std::move( codegen2.module );
+				}else if( codegen2.dumpToObj( obj_code ) ){
+					exit( 1 );
+				}
+				if( usecache ) cache.store( main_path,parser.includedFiles(),obj_code,bundle );
 #endif
-		} else if ( usegcc ) {
+			} else if ( usegcc ) {
 #ifdef USE_GCC_BACKEND
-			// C code is already in c_code string, will be written during linking
+				// C code is already in c_code string, will be written during linking
+#endif
+			} else {
+				module=linkerLib->createModule();
+				Assem_x86 assem( asmcode,module );
+				assem.assemble();
+			}
+		}
+
+		bundle.signerId = signerId;
+		bundle.teamId = teamId;
+		bundle.sourceDir = srcDirPath;
+
+		if( bundle.enabled && out_file.size() && target.host ){
+#ifdef BB_MACOS
+			out_file+=".app";
 #endif
-		} else {
-			module=linkerLib->createModule();
-			Assem_x86 assem( asmcode,module );
-			assem.assemble();
 		}
 	}catch( Ex &x ){
 		std::string file='\"'+x.file+'\"';
@@ -682,7 +744,11 @@ int main( int argc,char *argv[] ){
 #ifdef USE_LLVM
 			if( !veryquiet ) std::cout<<"Executing..."<<std::endl;
 
-			ret=JIT_ORC::run( runtimeLib,obj_code,home,rt,args );
+			if( lazyjit ){
+				ret=JIT_ORC::runLazy( runtimeLib,std::move( jit_context ),std::move( jit_module ),home,rt,args );
+			}else{
+				ret=JIT_ORC::run( runtimeLib,obj_code,home,rt,args );
+			}
 #else
 			std::cerr<<"llvm support was not compiled in"<<std::endl;
 			abort();
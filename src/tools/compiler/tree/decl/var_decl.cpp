@@ -1,5 +1,6 @@
 #include "var_decl.h"
 #include "../expr/const.h"
+#include "../stmt/for.h"
 
 ////////////////////////////
 // Simple var declaration //
@@ -29,6 +30,7 @@ void VarDeclNode::proto( DeclSeq *d,Environ *e ){
 
 	Decl *decl=d->insertDecl( ident,ty,kind,defType );
 	if( !decl ) ex( "Duplicate variable name" );
+	ForNode::assigned( e,decl );
 	if( expr ) sem_var=d_new DeclVarNode( decl );
 }
 
@@ -1,5 +1,6 @@
 #include "call.h"
 #include "const.h"
+#include "../stmt/for.h"
 #include <fstream>
 #include <iostream>
 #include <cctype>
@@ -89,6 +90,9 @@ ExprNode *CallNode::semant( Environ *e ){
 	exprs->castTo( f->params,e,f->cfunc );
 	sem_type=f->returnType;
 
+	//user functions may Dim, or assign to globals
+	if( f->symbol.empty() ) ForNode::opaque( e );
+
 	// Check for file-loading functions with string constant arguments
 	int fileArgPos = getFileArgPosition( ident );
 	if( fileArgPos >= 0 && fileArgPos < exprs->size() ){
@@ -111,7 +115,7 @@ TNode *CallNode::translate( Codegen *g ){
 
 	TNode *t;
 	TNode *l=global( "_f"+ident );
-	TNode *r=exprs->translate( g,f->cfunc );
+	TNode *r=exprs->translate( g,f->cfunc,!f->symbol.empty() );
 
 	if( f->userlib ){
 		l=d_new TNode( IR_MEM,l );
@@ -141,7 +145,12 @@ llvm::Value *CallNode::translate2( Codegen_LLVM *g ){
 
 	std::vector<llvm::Value*> args;
 	for( int i=0;i<exprs->size();i++ ){
-		args.push_back( exprs->exprs[i]->translate2( g ) );
+		llvm::Value *v=exprs->exprs[i]->translate2( g );
+		if( !f->symbol.empty() && !f->cfunc && exprs->exprs[i]->sem_type->stringType() ){
+			//runtime commands are free to modify their string args
+			v=g->CallIntrinsic( "_bbStrUnique",v->getType(),1,v );
+		}
+		args.push_back( v );
 	}
 
 	return g->builder->CreateCall( func,args );
@@ -171,7 +180,12 @@ std::string CallNode::translate3( Codegen_C *g ){
 
 	for( int i=0; i<exprs->size(); i++ ){
 		if( i > 0 ) result += ", ";
-		result += exprs->exprs[i]->translate3( g );
+		std::string arg = exprs->exprs[i]->translate3( g );
+		// Runtime commands are free to modify their string args
+		if( !f->symbol.empty() && !f->cfunc && exprs->exprs[i]->sem_type->stringType() ){
+			arg = "_bbStrUnique(" + arg + ")";
+		}
+		result += arg;
 	}
 	result += ")";
 
@@ -11,7 +11,7 @@ void ExprSeqNode::semant( Environ *e ){
 	}
 }
 
-TNode *ExprSeqNode::translate( Codegen *g,bool cfunc ){
+TNode *ExprSeqNode::translate( Codegen *g,bool cfunc,bool runtime ){
 	TNode *t=0,*l=0;
 	for( int k=0;k<exprs.size();++k ){
 
@@ -26,6 +26,9 @@ TNode *ExprSeqNode::translate( Codegen *g,bool cfunc ){
 			}else if( ty==Type::void_type ){
 				q=d_new TNode( IR_MEM,add(q,iconst(4)) );
 			}
+		}else if( runtime && exprs[k]->sem_type->stringType() ){
+			//runtime commands are free to modify their string args
+			q=call( "__bbStrUnique",q );
 		}
 
 		TNode *p;
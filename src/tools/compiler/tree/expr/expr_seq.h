@@ -9,7 +9,7 @@ struct ExprSeqNode : public Node{
 	void push_back( ExprNode *e ){ exprs.push_back( e ); }
 	int  size(){ return exprs.size(); }
 	void semant( Environ *e );
-	TNode *translate( Codegen *g,bool userlib );
+	TNode *translate( Codegen *g,bool userlib,bool runtime=false );
 	void castTo( DeclSeq *ds,Environ *e,bool userlib );
 	void castTo( Type *t,Environ *e );
 
@@ -1,5 +1,6 @@
 #include "method_call.h"
 #include "../type.h"
+#include "../stmt/for.h"
 
 ////////////////////
 // Method call    //
@@ -7,6 +8,7 @@
 ExprNode *MethodCallNode::semant( Environ *e ){
 	// First, get the type of the object
 	obj = obj->semant( e );
+	ForNode::opaque( e );
 	Type *obj_type = obj->sem_type;
 
 	// Object must be a struct/class type
@@ -2,6 +2,7 @@
 #include "../../ex.h"
 #include "../type.h"
 #include "../var/decl_var.h"
+#include "../stmt/for.h"
 
 ////////////////////
 // New expression //
@@ -16,6 +17,7 @@ ExprNode *NewNode::semant( Environ *e ){
 		StructType *st = sem_type->structType();
 		std::string ctor_name = st->ident + "_constructor";
 		ctor_decl = e->findFunc( ctor_name );
+		if( ctor_decl ) ForNode::opaque( e );
 
 		// If arguments provided, constructor is required
 		if( ctor_args->size() > 0 ){
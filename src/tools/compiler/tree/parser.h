@@ -25,6 +25,9 @@ public:
 
 	ProgNode *parse( const std::string &main );
 	BundleInfo bundle;
+
+	//full paths of every Included file
+	const std::set<std::string> &includedFiles()const{ return included; }
 private:
 	std::string incfile;
 	std::set<std::string> included;
@@ -1,4 +1,28 @@
 #include "ass.h"
+#include "../expr/arith_expr.h"
+#include "../expr/var_expr.h"
+#include "../expr/cast.h"
+#include "../expr/call.h"
+#include "../var/decl_var.h"
+#include "for.h"
+
+//can be evaluated before the append without changing the result, ie. can't
+//assign to variables
+static bool pureStrExpr( ExprNode *e ){
+	if( e->constNode() ) return true;
+	if( VarExprNode *v=dynamic_cast<VarExprNode*>( e ) ) return dynamic_cast<DeclVarNode*>( v->var )!=0;
+	if( CastNode *c=dynamic_cast<CastNode*>( e ) ) return pureStrExpr( c->expr );
+	if( ArithExprNode *a=dynamic_cast<ArithExprNode*>( e ) ) return pureStrExpr( a->lhs ) && pureStrExpr( a->rhs );
+	if( CallNode *c=dynamic_cast<CallNode*>( e ) ){
+		//runtime commands only; user functions may assign to globals
+		if( c->sem_decl->type->funcType()->symbol.empty() ) return false;
+		for( int k=0;k<c->exprs->size();++k ){
+			if( !pureStrExpr( c->exprs->exprs[k] ) ) return false;
+		}
+		return true;
+	}
+	return false;
+}
 
 ////////////////
 // Assignment //
@@ -7,16 +31,67 @@ void AssNode::semant( Environ *e ){
 	var->semant( e );
 	if( var->sem_type->constType() ) ex( "Constants can not be assigned to" );
 	if( var->sem_type->vectorType() ) ex( "Blitz arrays can not be assigned to" );
+	if( DeclVarNode *d=dynamic_cast<DeclVarNode*>( var ) ) ForNode::assigned( e,d->sem_decl );
 	expr=expr->semant( e );
 	expr=expr->castTo( var->sem_type,e );
+	append=selfAppend();
+}
+
+//rewrites var$=var$+a+b... as an append of a+b..., so building a string up in a
+//loop doesn't copy it every time round
+bool AssNode::selfAppend(){
+	if( var->sem_type!=Type::string_type ) return false;
+	DeclVarNode *dst=dynamic_cast<DeclVarNode*>( var );
+	if( !dst ) return false;
+
+	//find the leftmost operand of the + chain
+	std::vector<ArithExprNode*> chain;
+	ExprNode *t=expr;
+	while( ArithExprNode *a=dynamic_cast<ArithExprNode*>( t ) ){
+		if( a->sem_type!=Type::string_type ) return false;
+		chain.push_back( a );
+		t=a->lhs;
+	}
+	if( !chain.size() ) return false;
+
+	VarExprNode *src=dynamic_cast<VarExprNode*>( t );
+	DeclVarNode *src_var=src ? dynamic_cast<DeclVarNode*>( src->var ) : 0;
+	if( !src_var || src_var->sem_decl!=dst->sem_decl ) return false;
+
+	for( int k=0;k<chain.size();++k ){
+		if( !pureStrExpr( chain[k]->rhs ) ) return false;
+	}
+
+	//rebuild the chain without its leftmost operand
+	ArithExprNode *inner=chain.back();
+	ExprNode *tail=inner->rhs;
+	inner->lhs=inner->rhs=0;
+	delete inner;
+	for( int k=chain.size()-2;k>=0;--k ){
+		chain[k]->lhs=tail;
+		tail=chain[k];
+	}
+	delete src;
+	expr=tail;
+	return true;
 }
 
 void AssNode::translate( Codegen *g ){
+	if( append ){
+		TNode *t=expr->translate( g );
+		g->code( call( "__bbStrAppend",var->translate( g ),t ) );
+		return;
+	}
 	g->code( var->store( g,expr->translate( g ) ) );
 }
 
 #ifdef USE_LLVM
 void AssNode::translate2( Codegen_LLVM *g ){
+	if( append ){
+		auto v=expr->translate2( g );
+		g->CallIntrinsic( "_bbStrAppend",g->voidTy,2,var->translate2( g ),v );
+		return;
+	}
 	var->store2( g,expr->translate2( g ) );
 }
 #endif
@@ -26,6 +101,7 @@ json AssNode::toJSON( Environ *e ){
 	tree["pos"]=pos;
 	tree["var"]=var->toJSON( e );
 	tree["expr"]=expr->toJSON( e );
+	tree["append"]=append;
 	return tree;
 }
 
@@ -34,6 +110,10 @@ json AssNode::toJSON( Environ *e ){
 
 void AssNode::translate3( Codegen_C *g ){
 	std::string value = expr->translate3( g );
+	if( append ){
+		g->emitLine( "_bbStrAppend(&" + var->translate3( g ) + ", " + value + ");" );
+		return;
+	}
 	var->store3( g, value );
 }
 #endif
@@ -8,11 +8,14 @@
 struct AssNode : public StmtNode{
 	VarNode *var;
 	ExprNode *expr;
-	AssNode( VarNode *var,ExprNode *expr ):var(var),expr(expr){}
+	//var$=var$+expr, appended in place
+	bool append;
+	AssNode( VarNode *var,ExprNode *expr ):var(var),expr(expr),append(false){}
 	~AssNode(){ delete var;delete expr; }
 	void semant( Environ *e );
 	void translate( Codegen *g );
 	json toJSON( Environ *e );
+	bool selfAppend();
 #ifdef USE_LLVM
 	virtual void translate2( Codegen_LLVM *g );
 #endif
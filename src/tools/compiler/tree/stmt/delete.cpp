@@ -1,5 +1,6 @@
 #include "delete.h"
 #include "../type.h"
+#include "for.h"
 
 //////////////////////
 // Delete statement //
@@ -12,6 +13,7 @@ void DeleteNode::semant( Environ *e ){
 	// Look for destructor: classname_destructor
 	std::string dtor_name = st->ident + "_destructor";
 	dtor_decl = e->findFunc( dtor_name );
+	if( dtor_decl ) ForNode::opaque( e );
 	// Destructor is optional, so don't error if not found
 }
 
@@ -1,4 +1,5 @@
 #include "dim.h"
+#include "for.h"
 
 //////////////////////////////
 // Dim AND declare an Array //
@@ -20,6 +21,7 @@ void DimNode::semant( Environ *e ){
 	}
 	exprs->semant( e );
 	exprs->castTo( Type::int_type,e );
+	ForNode::opaque( e );
 }
 
 void DimNode::translate( Codegen *g ){
@@ -1,12 +1,15 @@
 #include "for.h"
 #include "../expr/const.h"
-#include "../var/node.h"
+#include "../expr/arith_expr.h"
+#include "../expr/var_expr.h"
+#include "../var/array_var.h"
+#include "../var/decl_var.h"
 
 ///////////////////
 // For/Next loop //
 ///////////////////
 ForNode::ForNode( VarNode *var,ExprNode *from,ExprNode *to,ExprNode *step,StmtSeqNode *ss,int np )
-:var(var),fromExpr(from),toExpr(to),stepExpr(step),stmts(ss),nextPos(np){
+:var(var),fromExpr(from),toExpr(to),stepExpr(step),stmts(ss),nextPos(np),sem_opaque(false){
 }
 
 ForNode::~ForNode(){
@@ -33,11 +36,23 @@ void ForNode::semant( Environ *e ){
 
 	if( !stepExpr->constNode() ) ex( "Step value must be constant" );
 
+	if( DeclVarNode *d=dynamic_cast<DeclVarNode*>( var ) ) assigned( e,d->sem_decl );
+
 	std::string brk=e->setBreak( sem_brk=genLabel() );
+	e->loops.push_back( this );
 	stmts->semant( e );
+	e->loops.pop_back();
 	e->setBreak( brk );
 }
 
+void ForNode::assigned( Environ *e,Decl *d ){
+	for( ForNode *f:e->loops ) f->sem_assigned.insert( d );
+}
+
+void ForNode::opaque( Environ *e ){
+	for( ForNode *f:e->loops ) f->sem_opaque=true;
+}
+
 void ForNode::translate( Codegen *g ){
 
 	TNode *t;Type *ty=var->sem_type;
@@ -78,6 +93,7 @@ void ForNode::translate2( Codegen_LLVM *g ){
 
 	//initial assignment
 	var->store2( g,fromExpr->translate2( g ) );
+	if( g->debug ) hoistBoundsChecks( g );
 	g->builder->CreateBr( cond );
 
 	//the loop
@@ -87,6 +103,7 @@ void ForNode::translate2( Codegen_LLVM *g ){
 	g->breakBlock=cont;
 	stmts->translate2( g );
 	g->breakBlock=oldBreakBlock;
+	for( ArrayVarNode *a:sem_arrays ) a->inBounds=0;
 
 	//execute the step part
 	auto bop=ty==Type::int_type ? llvm::Instruction::BinaryOps::Add : llvm::Instruction::BinaryOps::FAdd;
@@ -102,6 +119,104 @@ void ForNode::translate2( Codegen_LLVM *g ){
 
 	g->builder->SetInsertPoint( cont );
 }
+
+//the lowest and highest values an int expression can take anywhere in a loop
+//body, computed on the way in; only for sums of constants and variables the
+//body leaves alone, times constants, so the 128 bit arithmetic can't overflow
+struct IndexRange{
+	ForNode *loop;
+	Codegen_LLVM *g;
+	Decl *index;
+	llvm::Value *indexLo,*indexHi;
+
+	bool eval( ExprNode *e,llvm::Value *&lo,llvm::Value *&hi,int depth=0 ){
+		if( e->sem_type!=Type::int_type || depth>8 ) return false;
+
+		auto wide=llvm::Type::getInt128Ty( *g->context );
+
+		if( ConstNode *c=e->constNode() ){
+			lo=hi=llvm::ConstantInt::getSigned( wide,c->intValue() );
+			return true;
+		}
+
+		if( VarExprNode *v=dynamic_cast<VarExprNode*>( e ) ){
+			DeclVarNode *d=dynamic_cast<DeclVarNode*>( v->var );
+			if( !d ) return false;
+			if( d->sem_decl==index ){
+				lo=indexLo;hi=indexHi;
+				return lo!=0;
+			}
+			if( loop->sem_assigned.count( d->sem_decl ) ) return false;
+			lo=hi=g->builder->CreateSExt( d->load2( g ),wide );
+			return true;
+		}
+
+		ArithExprNode *a=dynamic_cast<ArithExprNode*>( e );
+		if( !a ) return false;
+
+		llvm::Value *llo,*lhi,*rlo,*rhi;
+		switch( a->op ){
+		case '+':
+			if( !eval( a->lhs,llo,lhi,depth+1 ) || !eval( a->rhs,rlo,rhi,depth+1 ) ) return false;
+			lo=g->builder->CreateAdd( llo,rlo );
+			hi=g->builder->CreateAdd( lhi,rhi );
+			return true;
+		case '-':
+			if( !eval( a->lhs,llo,lhi,depth+1 ) || !eval( a->rhs,rlo,rhi,depth+1 ) ) return false;
+			lo=g->builder->CreateSub( llo,rhi );
+			hi=g->builder->CreateSub( lhi,rlo );
+			return true;
+		case '*':{
+			ConstNode *c=a->rhs->constNode();
+			ExprNode *x=a->lhs;
+			if( !c ){ c=a->lhs->constNode();x=a->rhs; }
+			if( !c || dynamic_cast<ArithExprNode*>( x ) ) return false;
+			if( !eval( x,llo,lhi,depth+1 ) ) return false;
+			auto n=llvm::ConstantInt::getSigned( wide,c->intValue() );
+			lo=g->builder->CreateMul( c->intValue()<0 ? lhi : llo,n );
+			hi=g->builder->CreateMul( c->intValue()<0 ? llo : lhi,n );
+			return true;
+		}
+		}
+		return false;
+	}
+};
+
+//with nothing in the body able to Dim an array or change the variables an
+//index is made from, the indices can be bounded once here; accesses that are
+//in range all the way round skip their checks, the rest still check each time
+void ForNode::hoistBoundsChecks( Codegen_LLVM *g ){
+	if( sem_opaque || !sem_arrays.size() ) return;
+
+	IndexRange r={ this,g,0,0,0 };
+
+	//the index runs from its current value towards toExpr, unless the body
+	//assigns to it
+	DeclVarNode *d=dynamic_cast<DeclVarNode*>( var );
+	if( d && var->sem_type==Type::int_type && !sem_assigned.count( d->sem_decl ) ){
+		r.index=d->sem_decl;
+		llvm::Value *lo,*hi;
+		if( r.eval( toExpr,lo,hi ) ){
+			auto now=g->builder->CreateSExt( d->load2( g ),llvm::Type::getInt128Ty( *g->context ) );
+			if( stepExpr->constNode()->floatValue()>0 ){
+				r.indexLo=now;r.indexHi=hi;
+			}else{
+				r.indexLo=lo;r.indexHi=now;
+			}
+		}
+	}
+
+	for( ArrayVarNode *a:sem_arrays ){
+		std::vector<llvm::Value*> lo,hi;
+		for( ExprNode *e:a->exprs->exprs ){
+			llvm::Value *l,*h;
+			if( !r.eval( e,l,h ) ) break;
+			lo.push_back( l );
+			hi.push_back( h );
+		}
+		if( lo.size()==a->exprs->size() ) a->inBounds=a->inRange( g,lo,hi );
+	}
+}
 #endif
 
 json ForNode::toJSON( Environ *e ){
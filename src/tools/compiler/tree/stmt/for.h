@@ -5,18 +5,34 @@
 #include "../expr/node.h"
 #include "../stmt/stmt_seq.h"
 
+#include <set>
+
+struct ArrayVarNode;
+
 struct ForNode : public StmtNode{
 	int nextPos;
 	VarNode *var;
 	ExprNode *fromExpr,*toExpr,*stepExpr;
 	StmtSeqNode *stmts;
 	std::string sem_brk;
+
+	//what the body does, so debug builds can check array indices once on the
+	//way into the loop rather than on every access: the variables it assigns,
+	//and whether it could run user code, Dim, or be jumped into
+	std::set<Decl*> sem_assigned;
+	bool sem_opaque;
+	std::vector<ArrayVarNode*> sem_arrays;
+
+	static void assigned( Environ *e,Decl *d );
+	static void opaque( Environ *e );
+
 	ForNode( VarNode *v,ExprNode *f,ExprNode *t,ExprNode *s,StmtSeqNode *ss,int np );
 	~ForNode();
 	void semant( Environ *e );
 	void translate( Codegen *g );
 #ifdef USE_LLVM
 	virtual void translate2( Codegen_LLVM *g );
+	void hoistBoundsChecks( Codegen_LLVM *g );
 #endif
 #ifdef USE_GCC_BACKEND
 	virtual void translate3( Codegen_C *g );
@@ -1,4 +1,5 @@
 #include "gosub.h"
+#include "for.h"
 
 /////////////////////
 // Gosub statement //
@@ -6,6 +7,7 @@
 void GosubNode::semant( Environ *e ){
 	if( e->level>0 ) ex( "'Gosub' may not be used inside a function" );
 	if( !e->findLabel( ident ) ) e->insertLabel( ident,-1,pos,-1 );
+	ForNode::opaque( e );
 	ident=e->funcLabel+ident;
 }
 
@@ -27,15 +29,18 @@ void GosubNode::translate3( Codegen_C *g ){
 
 #ifdef USE_LLVM
 void GosubNode::translate2( Codegen_LLVM *g ){
-	g->gosubUsed=true;
-
 	auto func=g->builder->GetInsertBlock()->getParent();
 
 	std::string label_cont=ident+"_"+std::string(itoa((bb_int_t)this))+"_cont";
 	auto cont=g->getLabel( label_cont );
 	func->insert( func->end(),cont );
 
-	g->CallIntrinsic( "_bbPushGosub",g->voidTy,1,llvm::BlockAddress::get( cont ) );
+	// the return site is identified by its case number in the return switch
+	g->getGosubReturn();
+	int site=g->gosubSwitch->getNumCases();
+	g->gosubSwitch->addCase( llvm::cast<llvm::ConstantInt>( g->constantInt( site ) ),cont );
+
+	g->CallIntrinsic( "_bbPushGosub",g->voidTy,1,g->builder->CreateIntToPtr( g->constantInt( site ),g->voidPtr ) );
 	g->builder->CreateBr( g->getLabel( ident ) );
 
 	g->builder->SetInsertPoint( cont );
@@ -1,4 +1,5 @@
 #include "label.h"
+#include "for.h"
 
 ////////////////
 // user label //
@@ -8,6 +9,7 @@ void LabelNode::semant( Environ *e ){
 		if( l->def>=0 ) ex( "duplicate label" );
 		l->def=pos;l->data_sz=data_sz;
 	}else e->insertLabel( ident,pos,-1,data_sz );
+	ForNode::opaque( e );
 	ident=e->funcLabel+ident;
 }
 
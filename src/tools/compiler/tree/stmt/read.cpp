@@ -1,4 +1,6 @@
 #include "read.h"
+#include "for.h"
+#include "../var/decl_var.h"
 
 ///////////////
 // Read data //
@@ -7,6 +9,7 @@ void ReadNode::semant( Environ *e ){
 	var->semant( e );
 	if( var->sem_type->constType() ) ex( "Constants can not be modified" );
 	if( var->sem_type->structType() ) ex( "Data can not be read into an object" );
+	if( DeclVarNode *d=dynamic_cast<DeclVarNode*>( var ) ) ForNode::assigned( e,d->sem_decl );
 }
 
 void ReadNode::translate( Codegen *g ){
@@ -62,14 +62,7 @@ void ReturnNode::translate2( Codegen_LLVM *g ){
 
 		g->builder->CreateRet( v );
 	}else{
-		auto br=g->builder->CreateIndirectBr( g->CallIntrinsic( "_bbPopGosub",llvm::PointerType::get( *g->context,0 ),0 ) );
-		// TODO: a bit imprecise...should try to determine the only possible labels
-		for( auto value:g->labels ){
-			auto label=value.second;
-			if( label->getParent()==func ){
-				br->addDestination( label );
-			}
-		}
+		g->builder->CreateBr( g->getGosubReturn() );
 	}
 
 	auto cont=llvm::BasicBlock::Create( *g->context,"ret_cont",func );
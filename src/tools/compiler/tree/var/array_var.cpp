@@ -1,4 +1,7 @@
 #include "array_var.h"
+#include "../stmt/for.h"
+
+#include <algorithm>
 
 /////////////////
 // Indexed Var //
@@ -13,6 +16,11 @@ void ArrayVarNode::semant( Environ *e ){
 	if( t && t!=a->elementType ) ex( "array type mismtach" );
 	if( a->dims!=exprs->size() ) ex( "incorrect number of dimensions" );
 	sem_type=a->elementType;
+
+	if( e->loops.size() ){
+		std::vector<ArrayVarNode*> &arrays=e->loops.back()->sem_arrays;
+		if( std::find( arrays.begin(),arrays.end(),this )==arrays.end() ) arrays.push_back( this );
+	}
 }
 
 TNode *ArrayVarNode::translate( Codegen *g ){
@@ -51,7 +59,31 @@ llvm::Value *ArrayVarNode::translate2( Codegen_LLVM *g ){
 
 	auto elty=g->arrayTypes[ident];
 
+	//index k is checked against the size kept after the scale factors
+	auto check=[&]( llvm::Value *e,int k ){
+		std::vector<llvm::Value*> idx;
+		idx.push_back( zero );
+		idx.push_back( llvm::ConstantInt::get( *g->context,llvm::APInt( 32,1+k ) ) );
+		auto s=g->builder->CreateLoad( int_ty,g->builder->CreateGEP( elty,glob,idx ) );
+
+		auto ex=llvm::BasicBlock::Create( *g->context,"bounds_ex",func );
+		auto cont=llvm::BasicBlock::Create( *g->context,"bounds_cont",func );
+
+		g->builder->CreateCondBr( g->builder->CreateICmpSGE( e,s ),ex,cont );
+
+		g->builder->SetInsertPoint( ex );
+		g->CallIntrinsic( "_bbArrayBoundsEx",void_ty,0 );
+		g->builder->CreateUnreachable();
+
+		g->builder->SetInsertPoint( cont );
+	};
+
+	//indices bounded by the loop have no side effects, so can all be worked
+	//out before checking any of them
+	bool hoisted=g->debug && inBounds;
+
 	llvm::Value *t=0;
+	std::vector<llvm::Value*> linear;
 	for( int k=0;k<exprs->size();++k ){
 		auto e=exprs->exprs[k]->translate2( g );
 		if( k ){
@@ -62,24 +94,24 @@ llvm::Value *ArrayVarNode::translate2( Codegen_LLVM *g ){
 			auto s=g->builder->CreateLoad( int_ty,g->builder->CreateGEP( elty,glob,idx ) );
 			e=g->builder->CreateAdd( t,g->builder->CreateMul( e,s ) );
 		}
-		if( g->debug ){
-			std::vector<llvm::Value*> idx;
-			idx.push_back( zero );
-			idx.push_back( llvm::ConstantInt::get( *g->context,llvm::APInt( 32,1+k ) ) );
-			auto s=g->builder->CreateLoad( int_ty,g->builder->CreateGEP( elty,glob,idx ) );
-
-			auto ex=llvm::BasicBlock::Create( *g->context,"bounds_ex",func );
-			auto cont=llvm::BasicBlock::Create( *g->context,"bounds_cont",func );
+		if( hoisted ){
+			linear.push_back( e );
+		}else if( g->debug ){
+			check( e,k );
+		}
+		t=e;
+	}
 
-			g->builder->CreateCondBr( g->builder->CreateICmpSGE( e,s ),ex,cont );
+	if( hoisted ){
+		auto checks=llvm::BasicBlock::Create( *g->context,"bounds_check",func );
+		auto done=llvm::BasicBlock::Create( *g->context,"bounds_done",func );
+		g->builder->CreateCondBr( inBounds,done,checks );
 
-			g->builder->SetInsertPoint( ex );
-			g->CallIntrinsic( "_bbArrayBoundsEx",void_ty,0 );
-			g->builder->CreateUnreachable();
+		g->builder->SetInsertPoint( checks );
+		for( int k=0;k<linear.size();++k ) check( linear[k],k );
+		g->builder->CreateBr( done );
 
-			g->builder->SetInsertPoint( cont );
-		}
-		t=e;
+		g->builder->SetInsertPoint( done );
 	}
 
 	std::vector<llvm::Value*> idx;
@@ -87,6 +119,34 @@ llvm::Value *ArrayVarNode::translate2( Codegen_LLVM *g ){
 	auto el=g->builder->CreateGEP( ty,data,idx );
 	return el;
 }
+
+llvm::Value *ArrayVarNode::inRange( Codegen_LLVM *g,const std::vector<llvm::Value*> &lo,const std::vector<llvm::Value*> &hi ){
+	auto zero=llvm::ConstantInt::get( *g->context,llvm::APInt( 32,0 ) );
+	auto int_ty=Type::int_type->llvmType( g->context.get() );
+	auto wide=llvm::Type::getInt128Ty( *g->context );
+
+	auto glob=g->getArray( ident,sem_decl->type->arrayType()->dims );
+	auto elty=g->arrayTypes[ident];
+
+	auto slot=[&]( int n ){
+		std::vector<llvm::Value*> idx;
+		idx.push_back( zero );
+		idx.push_back( llvm::ConstantInt::get( *g->context,llvm::APInt( 32,n ) ) );
+		return g->builder->CreateSExt( g->builder->CreateLoad( int_ty,g->builder->CreateGEP( elty,glob,idx ) ),wide );
+	};
+
+	//no index below zero or past 32 bits keeps every partial sum of the
+	//linear index positive, and exact, so each only has to fit its size
+	llvm::Value *ok=g->builder->getTrue();
+	llvm::Value *max=0;
+	for( int k=0;k<lo.size();++k ){
+		ok=g->builder->CreateAnd( ok,g->builder->CreateICmpSGE( lo[k],llvm::ConstantInt::get( wide,0 ) ) );
+		ok=g->builder->CreateAnd( ok,g->builder->CreateICmpSLT( hi[k],llvm::ConstantInt::get( wide,1ull<<32 ) ) );
+		max=k ? g->builder->CreateAdd( max,g->builder->CreateMul( hi[k],slot( k ) ) ) : hi[k];
+		ok=g->builder->CreateAnd( ok,g->builder->CreateICmpSLT( max,slot( 1+k ) ) );
+	}
+	return ok;
+}
 #endif
 
 json ArrayVarNode::toJSON( Environ *e ){
@@ -13,6 +13,11 @@ struct ArrayVarNode : public VarNode{
 	void semant( Environ *e );
 	TNode *translate( Codegen *g );
 #ifdef USE_LLVM
+	//set by the enclosing For loop in debug builds: true when the indices are
+	//known to be in range, and the checks can be skipped
+	llvm::Value *inBounds=0;
+	llvm::Value *inRange( Codegen_LLVM *g,const std::vector<llvm::Value*> &lo,const std::vector<llvm::Value*> &hi );
+
 	virtual llvm::Value *translate2( Codegen_LLVM *g );
 #endif
 #ifdef USE_GCC_BACKEND
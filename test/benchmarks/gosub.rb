@@ -0,0 +1,47 @@
+# Writes gosub.bb, the Gosub build-time benchmark:
+#
+#   ruby test/benchmarks/gosub.rb
+
+SUBS = 120
+
+File.open(File.expand_path('gosub.bb', __dir__), 'w') do |f|
+  f.write <<~BB
+    ; Gosub build-time benchmark
+    ; A legacy-style main program with #{SUBS} Gosub subroutines, nested two deep,
+    ; around a hot arithmetic loop. Gosub used to turn optimization off for the
+    ; whole program, since every Return could branch to any label; time the
+    ; build as well as the run:
+    ;
+    ;   time blitzcc test/benchmarks/gosub.bb
+
+    Const LOOPS = 20000000
+
+    start = MilliSecs()
+    acc = 0
+    For i = 1 To LOOPS
+    \tacc = ( acc * 31 + i ) Xor ( acc Shr 7 )
+    Next
+    Print "hot loop: " + ( MilliSecs() - start ) + " ms (" + acc + ")"
+
+    sum = 0
+    start = MilliSecs()
+    For i = 1 To 1000
+  BB
+
+  SUBS.times { |k| f.write "\tGosub sub#{k}\n" }
+
+  f.write <<~BB
+    Next
+    Print "gosubs: " + ( MilliSecs() - start ) + " ms (" + sum + ")"
+
+    End
+  BB
+
+  # odd subroutines call the one before, so returns nest
+  SUBS.times do |k|
+    f.write "\n.sub#{k}\n"
+    f.write "sum = sum + #{k + 1}\n"
+    f.write "Gosub sub#{k - 1}\n" if k.odd?
+    f.write "Return\n"
+  end
+end
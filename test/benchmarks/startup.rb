@@ -0,0 +1,70 @@
+# Writes startup.bb, the JIT startup benchmark:
+#
+#   ruby test/benchmarks/startup.rb
+
+COLD = 100
+
+File.open(File.expand_path('startup.bb', __dir__), 'w') do |f|
+  f.write <<~BB
+    ; JIT startup benchmark
+    ; A program with a lot of code, most of it run once: the eager JIT optimizes
+    ; all of it before the first line runs, the lazy one compiles each function
+    ; as it's first called and only optimizes the hot ones. Time up to the first
+    ; line, then the whole run, both ways:
+    ;
+    ;   time blitzcc test/benchmarks/startup.bb first
+    ;   time blitzcc -lazy test/benchmarks/startup.bb first
+    ;   time blitzcc test/benchmarks/startup.bb
+    ;   time blitzcc -lazy test/benchmarks/startup.bb
+
+    Print "first line"
+    If CommandLine$()="first" Then End
+
+    ; hot: tiered up after its first calls
+    start = MilliSecs()
+    acc# = 0
+    For i = 1 To 2000000
+    \tacc = acc + Hot( i )
+    Next
+    Print "hot: " + ( MilliSecs() - start ) + " ms (" + acc + ")"
+
+    ; cold: every function runs once
+    start = MilliSecs()
+    total# = 0
+  BB
+
+  COLD.times { |k| f.write "total = total + Cold#{k}( #{k + 1} )\n" }
+
+  f.write <<~BB
+    Print "cold: " + ( MilliSecs() - start ) + " ms (" + total + ")"
+
+    Function Hot#( i )
+    \tLocal x# = ( i Mod 1000 ) * 0.001
+    \tReturn x * x - x * 0.5
+    End Function
+  BB
+
+  # each cold function is a little different, so none fold into another
+  COLD.times do |k|
+    f.write <<~BB
+
+      Function Cold#{k}#( n )
+      \tLocal sum# = 0, s$ = ""
+      \tFor i = 1 To n + #{3 + k % 7}
+      \t\tSelect ( i + #{k} ) Mod 4
+      \t\tCase 0
+      \t\t\tsum = sum + Sin( i * #{k + 1} ) * #{1 + k % 5}
+      \t\tCase 1
+      \t\t\tsum = sum - Sqr( i + #{k} ) / #{2 + k % 3}
+      \t\tCase 2
+      \t\t\ts = s + Chr( 65 + ( i Mod 26 ) )
+      \t\tDefault
+      \t\t\tsum = sum * 0.5 + Len( s )
+      \t\tEnd Select
+      \tNext
+      \tIf Len( s ) > #{4 + k % 9} Then s = Mid( s, 2 )
+      \tReturn sum + Len( s )
+      End Function
+    BB
+  end
+end